@@ -0,0 +1,1616 @@
+/*
+    Kousaten Mixer - Benchmark Entry Point
+    Micro benchmarks of the mixer hot path and macro sweeps of the full engine
+*/
+
+#include <JuceHeader.h>
+#include "BenchRunner.h"
+#include "../Core/AudioEngine.h"
+#include "../Core/AdaptiveResampler.h"
+#include "../Core/DeviceEnumerator.h"
+#include "../Core/InterleaveKernels.h"
+#include "../Core/VirtualOutputBackend.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <thread>
+
+// Counts heap allocations from every thread so the real-time paths can be checked for them
+static std::atomic<juce::int64> heapAllocationCount { 0 };
+
+void* operator new(std::size_t size)
+{
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+using Kousaten::BenchRunner;
+
+constexpr double benchSampleRate = 48000.0;
+
+struct BenchOptions
+{
+    juce::String filter;
+    juce::File outputFile;
+    double minTime = 0.1;
+    bool quick = false;
+};
+
+struct Sweep
+{
+    std::vector<int> blockSizes;
+    std::vector<int> channelCounts;
+    std::vector<int> auxCounts;
+    std::vector<int> workerCounts;
+};
+
+Sweep makeSweep(bool quick)
+{
+    if (quick)
+        return { { 64, 512 }, { 1, 8, 32 }, { 0, 4, 16 }, { 0, 3 } };
+
+    return { { 32, 64, 128, 256, 512, 1024, 2048 },
+             { 1, 2, 4, 8, 16, 32 },
+             { 0, 1, 2, 4, 8, 16 },
+             { 0, 1, 2, 3, 5, 7 } };
+}
+
+void fillNoise(juce::AudioBuffer<float>& buffer, juce::Random& random)
+{
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        auto* data = buffer.getWritePointer(ch);
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            data[i] = (random.nextFloat() * 2.0f - 1.0f) * 0.5f;
+    }
+}
+
+// Keeps per-sample processor results observable so the loops are not optimised away
+volatile float benchSink = 0.0f;
+
+// =============================================================================
+// Micro benchmarks
+// =============================================================================
+
+void benchChannel(BenchRunner& runner, const Sweep& sweep)
+{
+    juce::Random random(1);
+
+    for (int blockSize : sweep.blockSizes)
+    {
+        // ramp:0 measures the steady-gain fast path, ramp:1 keeps volume and pan smoothing
+        for (int ramp = 0; ramp <= 1; ++ramp)
+        {
+            Kousaten::Channel channel(0);
+            channel.prepare(benchSampleRate, blockSize);
+            channel.setPan(0.3f);
+            channel.setDelaySend(0.5f);
+            channel.setGrainSend(0.5f);
+            channel.setReverbSend(0.5f);
+
+            juce::AudioBuffer<float> input(2, blockSize);
+            juce::AudioBuffer<float> output(2, blockSize);
+            juce::AudioBuffer<float> sendBuses(6, blockSize);
+            fillNoise(input, random);
+
+            bool flip = false;
+            runner.run("Channel::processAndAccumulate", { { "block", blockSize }, { "ramp", ramp } }, blockSize, [&] {
+                if (ramp != 0)
+                {
+                    flip = !flip;
+                    channel.setVolume(flip ? 0.6f : 0.8f);
+                    channel.setPan(flip ? -0.3f : 0.3f);
+                }
+
+                // The engine clears the bus sums once per block before the channel loop
+                sendBuses.clear();
+                channel.processAndAccumulate(input.getReadPointer(0), input.getReadPointer(1),
+                                             output.getWritePointer(0), output.getWritePointer(1),
+                                             sendBuses.getWritePointer(0), sendBuses.getWritePointer(1),
+                                             sendBuses.getWritePointer(2), sendBuses.getWritePointer(3),
+                                             sendBuses.getWritePointer(4), sendBuses.getWritePointer(5),
+                                             blockSize);
+            });
+        }
+    }
+}
+
+void benchMixBus(BenchRunner& runner, const Sweep& sweep)
+{
+    juce::Random random(2);
+
+    const std::pair<Kousaten::BusType, const char*> busTypes[] = {
+        { Kousaten::BusType::Delay, "Delay" },
+        { Kousaten::BusType::Grain, "Grain" },
+        { Kousaten::BusType::Reverb, "Reverb" }
+    };
+
+    for (const auto& [busType, typeName] : busTypes)
+    {
+        for (int blockSize : sweep.blockSizes)
+        {
+            std::vector<BenchRunner::Param> params { { "type", typeName }, { "block", blockSize } };
+            if (!runner.wouldRun("MixBus::process", params))
+                continue;
+
+            auto bus = std::make_unique<Kousaten::MixBus>(busType);
+            bus->prepare(benchSampleRate, blockSize);
+
+            juce::AudioBuffer<float> input(2, blockSize);
+            juce::AudioBuffer<float> output(2, blockSize);
+            fillNoise(input, random);
+
+            runner.run("MixBus::process", params, blockSize, [&] {
+                bus->process(input.getReadPointer(0), input.getReadPointer(1),
+                             output.getWritePointer(0), output.getWritePointer(1),
+                             blockSize);
+            });
+        }
+    }
+}
+
+void benchAuxBus(BenchRunner& runner, const Sweep& sweep)
+{
+    juce::Random random(3);
+
+    for (int blockSize : sweep.blockSizes)
+    {
+        Kousaten::AuxBus auxBus(0);
+        auxBus.prepareToPlay(blockSize, benchSampleRate);
+
+        juce::AudioBuffer<float> input(2, blockSize);
+        fillNoise(input, random);
+
+        runner.run("AuxBus::addToBuffer", { { "block", blockSize } }, blockSize, [&] {
+            auxBus.addToBuffer(input.getReadPointer(0), input.getReadPointer(1), blockSize, 0.7f);
+        });
+    }
+}
+
+// A typical monitor-wedge chain: four EQ bands, moderate compression, limiter at -1 dB
+void configureInserts(Kousaten::InsertChain& inserts, bool eq, bool compressor, bool limiter)
+{
+    using BandType = Kousaten::EqProcessor::BandType;
+
+    auto& equaliser = inserts.getEq();
+    equaliser.setBand(0, BandType::HighPass, 80.0f, 0.0f, 0.707f);
+    equaliser.setBand(1, BandType::Peak, 350.0f, -4.0f, 1.2f);
+    equaliser.setBand(2, BandType::Peak, 2500.0f, 2.0f, 0.8f);
+    equaliser.setBand(3, BandType::HighShelf, 9000.0f, -3.0f, 0.707f);
+    for (int band = 0; band < Kousaten::EqProcessor::MAX_BANDS; ++band)
+        equaliser.setBandEnabled(band, true);
+
+    inserts.getCompressor().setThreshold(-20.0f);
+    inserts.getCompressor().setRatio(4.0f);
+    inserts.getLimiter().setCeiling(-1.0f);
+
+    inserts.setSlotEnabled(Kousaten::InsertChain::EqSlot, eq);
+    inserts.setSlotEnabled(Kousaten::InsertChain::CompressorSlot, compressor);
+    inserts.setSlotEnabled(Kousaten::InsertChain::LimiterSlot, limiter);
+}
+
+// Aux insert slots at 16 buses, one slot at a time and all together (slots:none is the
+// bus without inserts). Hot input, so the compressor and limiter are working; the bench
+// exits with an error if a limited bus peaks above the ceiling in any block, including the
+// one the limiter switches on in.
+bool benchInserts(BenchRunner& runner, const Sweep& sweep)
+{
+    constexpr int numAux = 16;
+    juce::Random random(6);
+
+    struct Config { const char* name; bool eq, compressor, limiter; };
+    const Config configs[] = { { "none", false, false, false },
+                               { "eq", true, false, false },
+                               { "compressor", false, true, false },
+                               { "limiter", false, false, true },
+                               { "all", true, true, true } };
+
+    for (int blockSize : sweep.blockSizes)
+    {
+        juce::AudioBuffer<float> input(2, blockSize);
+        juce::AudioBuffer<float> output(2, blockSize);
+        fillNoise(input, random);
+
+        for (const auto& config : configs)
+        {
+            const std::vector<BenchRunner::Param> params { { "aux", numAux }, { "block", blockSize },
+                                                           { "slots", juce::String(config.name) } };
+            if (!runner.wouldRun("AuxBus::inserts", params))
+                continue;
+
+            std::vector<std::unique_ptr<Kousaten::AuxBus>> auxBuses;
+            for (int a = 0; a < numAux; ++a)
+            {
+                auxBuses.push_back(std::make_unique<Kousaten::AuxBus>(a));
+                auxBuses.back()->prepareToPlay(blockSize, benchSampleRate);
+                configureInserts(auxBuses.back()->getInserts(), config.eq, config.compressor, config.limiter);
+            }
+
+            // Peak of every bus over every block since the last check
+            float peak = 0.0f;
+            auto processBuses = [&] {
+                for (auto& auxBus : auxBuses)
+                {
+                    auxBus->clearBuffer();
+                    auxBus->addToBuffer(input.getReadPointer(0), input.getReadPointer(1), blockSize, 4.0f);
+                    auxBus->process(output.getWritePointer(0), output.getWritePointer(1), blockSize);
+                    peak = std::max(peak, output.getMagnitude(0, blockSize));
+                }
+            };
+
+            const float ceiling = juce::Decibels::decibelsToGain(-1.0f);
+            auto checkCeiling = [&](const char* when) {
+                if (!config.limiter || peak <= ceiling * 1.0001f)
+                    return true;
+
+                std::cerr << "Limited aux peaked at " << juce::Decibels::gainToDecibels(peak) << " dB "
+                          << when << "\n";
+                return false;
+            };
+
+            // The slots switch on in the first block, so it is checked with the rest
+            runner.run("AuxBus::inserts", params, blockSize, [&] { processBuses(); });
+
+            if (!checkCeiling("while limited"))
+                return false;
+
+            if (config.limiter)
+            {
+                // Off for a block (unchecked, it fades out), then back on
+                for (auto& auxBus : auxBuses)
+                    auxBus->getInserts().setSlotEnabled(Kousaten::InsertChain::LimiterSlot, false);
+                processBuses();
+
+                for (auto& auxBus : auxBuses)
+                    auxBus->getInserts().setSlotEnabled(Kousaten::InsertChain::LimiterSlot, true);
+                peak = 0.0f;
+                processBuses();
+                processBuses();
+
+                if (!checkCeiling("after switching the limiter back on"))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void benchEffects(BenchRunner& runner, const Sweep& sweep)
+{
+    juce::Random random(4);
+    const auto rate = static_cast<float>(benchSampleRate);
+
+    for (int blockSize : sweep.blockSizes)
+    {
+        juce::AudioBuffer<float> input(2, blockSize);
+        juce::AudioBuffer<float> output(2, blockSize);
+        fillNoise(input, random);
+
+        const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+        float* const outputs[] = { output.getWritePointer(0), output.getWritePointer(1) };
+
+        {
+            auto grain = std::make_unique<Kousaten::GrainProcessor>();
+            grain->setParameters(0.3f, 0.4f, 0.5f, 0.0f, rate);
+            runner.run("GrainProcessor::processBlock", { { "block", blockSize } }, blockSize, [&] {
+                grain->processBlock(inputs, outputs, blockSize);
+                benchSink = outputs[0][blockSize - 1];
+            });
+        }
+
+        {
+            auto reverb = std::make_unique<Kousaten::ReverbProcessor>();
+            reverb->setParameters(0.5f, 0.4f, 0.6f, 0.0f);
+            runner.run("ReverbProcessor::processBlock", { { "block", blockSize } }, blockSize, [&] {
+                reverb->processBlock(inputs, outputs, blockSize);
+                benchSink = outputs[0][blockSize - 1];
+            });
+        }
+
+        {
+            auto delay = std::make_unique<Kousaten::DelayProcessor>();
+            delay->setParameters(0.25f, 0.3f, 0.3f, 0.0f);
+            runner.run("DelayProcessor::processBlock", { { "block", blockSize } }, blockSize, [&] {
+                delay->processBlock(inputs, outputs, blockSize);
+                benchSink = outputs[0][blockSize - 1];
+            });
+        }
+    }
+}
+
+// RT60 of the reverb's impulse response below about 2 kHz, from the Schroeder
+// (backward-integrated) energy curve's fall from -5 to -25 dB. The band keeps to where a
+// one-pole damping filter can match across rates; near Nyquist no rescaled coefficient
+// can.
+double measureReverbRt60Ms(double sampleRate)
+{
+    constexpr int blockSize = 512;
+    const int numSamples = static_cast<int>(3.0 * sampleRate);
+
+    auto reverb = std::make_unique<Kousaten::ReverbProcessor>();
+    reverb->prepare(sampleRate);
+    reverb->setParameters(0.5f, 0.4f, 0.6f, 0.0f);
+
+    juce::AudioBuffer<float> input(2, blockSize);
+    juce::AudioBuffer<float> output(2, blockSize);
+    const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+    float* const outputs[] = { output.getWritePointer(0), output.getWritePointer(1) };
+
+    std::vector<double> energy;
+    energy.reserve(static_cast<size_t>(numSamples));
+
+    // Two one-pole lowpasses at 2 kHz
+    const double band = 1.0 - std::exp(-juce::MathConstants<double>::twoPi * 2000.0 / sampleRate);
+    double lowpass[2][2] = {};
+
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        input.clear();
+        if (start == 0)
+        {
+            input.setSample(0, 0, 1.0f);
+            input.setSample(1, 0, 1.0f);
+        }
+
+        reverb->processBlock(inputs, outputs, blockSize);
+
+        for (int i = 0; i < blockSize; ++i)
+        {
+            double power = 0.0;
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                lowpass[ch][0] += (outputs[ch][i] - lowpass[ch][0]) * band;
+                lowpass[ch][1] += (lowpass[ch][0] - lowpass[ch][1]) * band;
+                power += lowpass[ch][1] * lowpass[ch][1];
+            }
+
+            energy.push_back(power);
+        }
+    }
+
+    const double total = std::accumulate(energy.begin(), energy.end(), 0.0);
+    double remaining = total;
+    double start5 = -1.0;
+
+    for (size_t i = 0; i < energy.size(); ++i)
+    {
+        remaining -= energy[i];
+        const double seconds = static_cast<double>(i) / sampleRate;
+
+        if (start5 < 0.0 && remaining < total * std::pow(10.0, -0.5))
+            start5 = seconds;
+
+        if (remaining < total * std::pow(10.0, -2.5))
+            return 3000.0 * (seconds - start5);
+    }
+
+    return 0.0;
+}
+
+// Runs one noise signal with chaos through processBlock() and processBlockScalar() in blocks
+// of uneven sizes, long enough for every ring to wrap several times; true if every output
+// sample is equal
+bool reverbMatchesScalar(double rate, bool swept)
+{
+    constexpr int blockSizes[] = { 1, 37, 256, 511, 64, 3 };
+    constexpr int maxBlockSize = 511;
+    constexpr int numBlocks = 96;
+
+    juce::Random random(9);
+    juce::AudioBuffer<float> input(2, maxBlockSize);
+    juce::AudioBuffer<float> chaos(1, maxBlockSize);
+    juce::AudioBuffer<float> vectorOutput(2, maxBlockSize);
+    juce::AudioBuffer<float> scalarOutput(2, maxBlockSize);
+    Kousaten::ChaosGenerator chaosGenerator;
+
+    std::unique_ptr<Kousaten::ReverbProcessor> reverbs[2];
+    for (auto& reverb : reverbs)
+    {
+        reverb = std::make_unique<Kousaten::ReverbProcessor>();
+        reverb->prepare(rate);
+        reverb->setParameters(0.7f, 0.3f, 0.9f, 0.5f);
+        reverb->setModulation(swept ? 1.0f : 0.0f, 0.5f);
+    }
+
+    const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+    float* const vectorOutputs[] = { vectorOutput.getWritePointer(0), vectorOutput.getWritePointer(1) };
+    float* const scalarOutputs[] = { scalarOutput.getWritePointer(0), scalarOutput.getWritePointer(1) };
+
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        const int numSamples = blockSizes[static_cast<size_t>(block) % std::size(blockSizes)];
+        fillNoise(input, random);
+        for (int i = 0; i < numSamples; ++i)
+            chaos.setSample(0, i, chaosGenerator.process(1.0f));
+
+        reverbs[0]->processBlock(inputs, vectorOutputs, numSamples, chaos.getReadPointer(0));
+        reverbs[1]->processBlockScalar(inputs, scalarOutputs, numSamples, chaos.getReadPointer(0));
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                if (vectorOutputs[ch][i] != scalarOutputs[ch][i])
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// The reverb at each engine rate, with fixed and swept comb taps: ns/sample, the memory
+// its lines take and its RT60. The lines scale with the rate, so the RT60 must stay
+// within 5% of the reference rate's, and the SIMD lanes must give exactly the scalar
+// reference's output, or the bench fails.
+bool benchReverbRates(BenchRunner& runner)
+{
+    constexpr int blockSize = 512;
+    const double rates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+    const double referenceRt60Ms = measureReverbRt60Ms(Kousaten::ReverbProcessor::REFERENCE_SAMPLE_RATE);
+
+    juce::Random random(6);
+    juce::AudioBuffer<float> input(2, blockSize);
+    juce::AudioBuffer<float> output(2, blockSize);
+    fillNoise(input, random);
+
+    const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+    float* const outputs[] = { output.getWritePointer(0), output.getWritePointer(1) };
+
+    for (double rate : rates)
+    {
+        for (bool swept : { false, true })
+        {
+            std::vector<BenchRunner::Param> params { { "rate", static_cast<int>(rate) },
+                                                     { "taps", swept ? "swept" : "fixed" } };
+            if (!runner.wouldRun("ReverbProcessor::rates", params))
+                continue;
+
+            auto reverb = std::make_unique<Kousaten::ReverbProcessor>();
+            reverb->prepare(rate);
+            reverb->setParameters(0.5f, 0.4f, 0.6f, 0.0f);
+            reverb->setModulation(swept ? 1.0f : 0.0f, 0.5f);
+
+            runner.run("ReverbProcessor::rates", params, blockSize, [&] {
+                reverb->processBlock(inputs, outputs, blockSize);
+                benchSink = outputs[0][blockSize - 1];
+            });
+
+            const auto footprint = reverb->getFootprint();
+            runner.addCounter("comb_kb", static_cast<double>(footprint.combBytes) / 1024.0);
+            runner.addCounter("allpass_kb", static_cast<double>(footprint.allpassBytes) / 1024.0);
+            runner.addCounter("arena_kb", static_cast<double>(footprint.arenaBytes) / 1024.0);
+
+            if (!reverbMatchesScalar(rate, swept))
+            {
+                std::cerr << "Reverb at " << rate << " Hz with " << (swept ? "swept" : "fixed")
+                          << " taps differs from its scalar reference\n";
+                return false;
+            }
+
+            if (swept)
+                continue;
+
+            const double rt60Ms = measureReverbRt60Ms(rate);
+            runner.addCounter("rt60_ms", rt60Ms);
+
+            if (std::abs(rt60Ms - referenceRt60Ms) > 0.05 * referenceRt60Ms)
+            {
+                std::cerr << "Reverb RT60 at " << rate << " Hz is " << rt60Ms << " ms, "
+                          << referenceRt60Ms << " ms at the reference rate\n";
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// The delay at each engine rate: ns/sample and the memory its lines take. The lines are
+// sized from the rate, so an impulse must come back after the full MAX_DELAY_SECONDS at
+// every rate or the bench fails.
+bool benchDelayRates(BenchRunner& runner)
+{
+    constexpr int blockSize = 512;
+    const double rates[] = { 44100.0, 48000.0, 96000.0, 192000.0 };
+    constexpr float longest = Kousaten::DelayProcessor::MAX_DELAY_SECONDS;
+
+    juce::Random random(8);
+    juce::AudioBuffer<float> input(2, blockSize);
+    juce::AudioBuffer<float> output(2, blockSize);
+    const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+    float* const outputs[] = { output.getWritePointer(0), output.getWritePointer(1) };
+
+    for (double rate : rates)
+    {
+        std::vector<BenchRunner::Param> params { { "rate", static_cast<int>(rate) } };
+        if (!runner.wouldRun("DelayProcessor::rates", params))
+            continue;
+
+        auto delay = std::make_unique<Kousaten::DelayProcessor>();
+        delay->prepare(rate);
+        delay->setParameters(longest, longest, 0.0f, 0.0f);
+
+        // The impulse must reach the output exactly MAX_DELAY_SECONDS later
+        const int expected = static_cast<int>(longest * rate);
+        int arrival = -1;
+
+        for (int start = 0; start <= expected && arrival < 0; start += blockSize)
+        {
+            input.clear();
+            if (start == 0)
+            {
+                input.setSample(0, 0, 1.0f);
+                input.setSample(1, 0, 1.0f);
+            }
+
+            delay->processBlock(inputs, outputs, blockSize);
+
+            for (int i = 0; i < blockSize && arrival < 0; ++i)
+                if (outputs[0][i] != 0.0f && outputs[1][i] != 0.0f)
+                    arrival = start + i;
+        }
+
+        if (arrival != expected)
+        {
+            std::cerr << "Delay at " << rate << " Hz returned an impulse after " << arrival
+                      << " samples, not " << expected << "\n";
+            return false;
+        }
+
+        fillNoise(input, random);
+        runner.run("DelayProcessor::rates", params, blockSize, [&] {
+            delay->processBlock(inputs, outputs, blockSize);
+            benchSink = outputs[0][blockSize - 1];
+        });
+
+        runner.addCounter("buffer_kb", static_cast<double>(delay->getBufferBytes()) / 1024.0);
+    }
+
+    return true;
+}
+
+// Error of the delay at a fractional time against the exactly delayed 1 kHz sine, in dB
+// below the signal, once the interpolator has settled
+// How far a delayed 1 kHz sine is from the exactly delayed one, in dB. With glide the time
+// then ramps down to a fifth, through the per-sample tap path with chunks cut short by the
+// shrinking delay, and the reference follows the same ramp: sample k of it is read
+// start + (k + 1) * step back.
+double measureDelayErrorDb(Kousaten::DelayProcessor::Interpolation interpolation, bool glide)
+{
+    constexpr int blockSize = 300;  // Not a multiple of the delay's chunks
+    constexpr int numBlocks = 32;
+    constexpr int settleSamples = 1024;
+    constexpr int glideBlock = 8;
+    const double frequency = 1000.0 / benchSampleRate;
+
+    auto delay = std::make_unique<Kousaten::DelayProcessor>();
+    delay->prepare(benchSampleRate);
+    delay->setInterpolation(interpolation);
+
+    const auto startTime = static_cast<float>(300.37 / benchSampleRate);
+    const auto endTime = static_cast<float>(60.61 / benchSampleRate);
+    delay->setParameters(startTime, startTime, 0.0f, 0.0f);
+
+    const double startDelay = static_cast<double>(startTime) * benchSampleRate;
+    const double endDelay = static_cast<double>(endTime) * benchSampleRate;
+    const int rampLength = static_cast<int>(Kousaten::DelayProcessor::TIME_RAMP_SECONDS * benchSampleRate);
+    const double rampStep = (endDelay - startDelay) / rampLength;
+
+    auto delayAt = [&](int n) {
+        const int k = n - glideBlock * blockSize;
+        if (!glide || k < 0)
+            return startDelay;
+        return k + 1 < rampLength ? startDelay + rampStep * (k + 1) : endDelay;
+    };
+
+    juce::AudioBuffer<float> input(2, blockSize);
+    juce::AudioBuffer<float> output(2, blockSize);
+    const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+    float* const outputs[] = { output.getWritePointer(0), output.getWritePointer(1) };
+
+    double signal = 0.0;
+    double error = 0.0;
+
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        if (glide && block == glideBlock)
+            delay->setParameters(endTime, endTime, 0.0f, 0.0f);
+
+        for (int i = 0; i < blockSize; ++i)
+        {
+            const double n = block * blockSize + i;
+            const auto value = static_cast<float>(0.5 * std::sin(juce::MathConstants<double>::twoPi * frequency * n));
+            input.setSample(0, i, value);
+            input.setSample(1, i, value);
+        }
+
+        delay->processBlock(inputs, outputs, blockSize);
+
+        for (int i = 0; i < blockSize; ++i)
+        {
+            const int n = block * blockSize + i;
+            if (n < settleSamples)
+                continue;
+
+            const double expected = 0.5 * std::sin(juce::MathConstants<double>::twoPi * frequency * (n - delayAt(n)));
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                const double difference = outputs[ch][i] - expected;
+                signal += expected * expected;
+                error += difference * difference;
+            }
+        }
+    }
+
+    return 10.0 * std::log10(error / signal);
+}
+
+// The delay with each interpolator, at a fixed fractional time and with its taps swept by
+// the LFO and chaos. Every interpolator must match the exactly delayed sine to 40 dB, and
+// the sine delayed along a time glide to 50 dB, or the bench fails.
+bool benchDelayInterpolation(BenchRunner& runner)
+{
+    using Interpolation = Kousaten::DelayProcessor::Interpolation;
+    constexpr int blockSize = 512;
+
+    const std::pair<Interpolation, const char*> modes[] = { { Interpolation::Linear, "linear" },
+                                                            { Interpolation::Allpass, "allpass" },
+                                                            { Interpolation::Hermite, "hermite" },
+                                                            { Interpolation::Lagrange, "lagrange" } };
+
+    juce::Random random(7);
+    juce::AudioBuffer<float> input(2, blockSize);
+    juce::AudioBuffer<float> output(2, blockSize);
+    juce::AudioBuffer<float> chaos(1, blockSize);
+    fillNoise(input, random);
+
+    Kousaten::ChaosGenerator chaosGenerator;
+    for (int i = 0; i < blockSize; ++i)
+        chaos.setSample(0, i, chaosGenerator.process(1.0f));
+
+    const float* const inputs[] = { input.getReadPointer(0), input.getReadPointer(1) };
+    float* const outputs[] = { output.getWritePointer(0), output.getWritePointer(1) };
+
+    for (const auto& [interpolation, name] : modes)
+    {
+        for (bool swept : { false, true })
+        {
+            std::vector<BenchRunner::Param> params { { "mode", name }, { "time", swept ? "swept" : "fixed" } };
+            if (!runner.wouldRun("DelayProcessor::interpolation", params))
+                continue;
+
+            auto delay = std::make_unique<Kousaten::DelayProcessor>();
+            delay->prepare(benchSampleRate);
+            delay->setInterpolation(interpolation);
+            delay->setParameters(0.25037f, 0.30011f, 0.3f, swept ? 0.5f : 0.0f);
+            delay->setModulation(swept ? 3.0f : 0.0f, 0.5f);
+            const float* chaosData = swept ? chaos.getReadPointer(0) : nullptr;
+
+            runner.run("DelayProcessor::interpolation", params, blockSize, [&] {
+                delay->processBlock(inputs, outputs, blockSize, chaosData);
+                benchSink = outputs[0][blockSize - 1];
+            });
+
+            if (swept)
+                continue;
+
+            // A glide read one ramp step out of place is about -46 dB off
+            for (bool glide : { false, true })
+            {
+                const double errorDb = measureDelayErrorDb(interpolation, glide);
+                runner.addCounter(glide ? "glide_error_db" : "error_db", errorDb);
+
+                if (!(errorDb < (glide ? -50.0 : -40.0)))
+                {
+                    std::cerr << "Delay with " << name << " interpolation is " << errorDb << " dB off the exactly "
+                              << (glide ? "delayed signal while the time glides\n" : "delayed signal\n");
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Device I/O kernels for a mono device, a stereo device and a stereo bus on an 8-channel
+// device. The dispatched kernels are first checked against the scalar ones on every
+// length up to a few vectors, aligned and misaligned; any difference fails the bench.
+bool benchInterleave(BenchRunner& runner, const Sweep& sweep)
+{
+    namespace Interleave = Kousaten::Interleave;
+
+    const auto& best = Interleave::getKernels();
+    const auto& scalar = Interleave::getScalarKernels();
+    juce::Random random(5);
+
+    auto differs = [](const float* a, const float* b, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (std::abs(a[i] - b[i]) > 1.0e-6f)
+                return true;
+        }
+        return false;
+    };
+
+    for (int numChannels : { 1, 2, 8 })
+    {
+        constexpr int maxFrames = 67;
+        const int numSources = std::min(numChannels, 2);
+        const auto interleavedSize = static_cast<size_t>((maxFrames + 1) * numChannels);
+
+        juce::AudioBuffer<float> planar(numChannels, maxFrames + 1);
+        fillNoise(planar, random);
+
+        std::vector<float> interleaved(interleavedSize);
+        for (auto& sample : interleaved)
+            sample = random.nextFloat() - 0.5f;
+
+        std::vector<float> expected(interleavedSize), actual(interleavedSize);
+        juce::AudioBuffer<float> expectedPlanar(numChannels, maxFrames), actualPlanar(numChannels, maxFrames);
+
+        for (int offset = 0; offset <= 1; ++offset)
+        {
+            std::vector<const float*> sources;
+            for (int ch = 0; ch < numChannels; ++ch)
+                sources.push_back(planar.getReadPointer(ch, offset));
+
+            for (int frames = 0; frames <= maxFrames; ++frames)
+            {
+                bool mismatch = false;
+                const auto numSamples = static_cast<size_t>(frames * numChannels);
+
+                scalar.interleave(sources.data(), numChannels, expected.data(), frames);
+                best.interleave(sources.data(), numChannels, actual.data(), frames);
+                mismatch = mismatch || differs(expected.data(), actual.data(), numSamples);
+
+                scalar.deinterleave(interleaved.data() + offset, numChannels, expectedPlanar.getArrayOfWritePointers(), frames);
+                best.deinterleave(interleaved.data() + offset, numChannels, actualPlanar.getArrayOfWritePointers(), frames);
+                for (int ch = 0; ch < numChannels; ++ch)
+                    mismatch = mismatch || differs(expectedPlanar.getReadPointer(ch), actualPlanar.getReadPointer(ch),
+                                                   static_cast<size_t>(frames));
+
+                for (float startGain : { 1.0f, 0.25f })
+                {
+                    expected = interleaved;
+                    actual = interleaved;
+                    scalar.addWithRamp(sources.data(), numSources, expected.data() + offset, numChannels, frames, startGain, 0.75f + startGain / 4.0f);
+                    best.addWithRamp(sources.data(), numSources, actual.data() + offset, numChannels, frames, startGain, 0.75f + startGain / 4.0f);
+                    mismatch = mismatch || differs(expected.data(), actual.data(), interleavedSize);
+                }
+
+                if (mismatch)
+                {
+                    std::cerr << best.name << " interleave kernels differ from scalar: " << numChannels
+                              << " channels, " << frames << " frames, offset " << offset << "\n";
+                    return false;
+                }
+            }
+        }
+    }
+
+    std::vector<const Interleave::Kernels*> kernelSets { &best };
+    if (&best != &scalar)
+        kernelSets.push_back(&scalar);
+
+    for (int blockSize : sweep.blockSizes)
+    {
+        for (int numChannels : { 1, 2, 8 })
+        {
+            const int numSources = std::min(numChannels, 2);
+
+            juce::AudioBuffer<float> planar(numChannels, blockSize);
+            fillNoise(planar, random);
+            std::vector<float> interleaved(static_cast<size_t>(blockSize * numChannels), 0.0f);
+
+            for (const auto* kernels : kernelSets)
+            {
+                const std::vector<BenchRunner::Param> params { { "channels", numChannels }, { "block", blockSize },
+                                                               { "kernels", juce::String(kernels->name) } };
+
+                runner.run("Interleave::interleave", params, blockSize, [&] {
+                    kernels->interleave(planar.getArrayOfReadPointers(), numChannels, interleaved.data(), blockSize);
+                    benchSink = interleaved.back();
+                });
+
+                runner.run("Interleave::deinterleave", params, blockSize, [&] {
+                    kernels->deinterleave(interleaved.data(), numChannels, planar.getArrayOfWritePointers(), blockSize);
+                    benchSink = planar.getSample(numChannels - 1, blockSize - 1);
+                });
+
+                // What every aux bus does per block: its one or two channels mixed into the
+                // device's staging block (steady gain, the usual case)
+                std::fill(interleaved.begin(), interleaved.end(), 0.0f);
+                runner.run("Interleave::addWithRamp", params, blockSize, [&] {
+                    kernels->addWithRamp(planar.getArrayOfReadPointers(), numSources, interleaved.data(), numChannels,
+                                         blockSize, 1.0f, 1.0f);
+                    benchSink = interleaved.back();
+                });
+            }
+        }
+    }
+
+    return true;
+}
+
+// =============================================================================
+// Macro benchmark: full engine sweep
+// =============================================================================
+
+// Stereo channels on consecutive input pairs, spread across the panorama, each sending
+// to every effect bus and every aux bus (aux outputs follow the master pair)
+std::unique_ptr<Kousaten::AudioEngine> createEngine(int numChannels, int numAux, int blockSize)
+{
+    auto engine = std::make_unique<Kousaten::AudioEngine>();
+    engine->prepareToPlay(blockSize, benchSampleRate);
+
+    std::vector<int> auxIds;
+    for (int a = 0; a < numAux; ++a)
+    {
+        int auxId = engine->addAuxBus();
+        engine->getAuxBus(auxId)->setOutputChannelStart(2 + 2 * a);
+        auxIds.push_back(auxId);
+    }
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto* channel = engine->getChannel(engine->addChannel());
+        channel->setInputChannelStart(2 * c);
+        channel->setStereo(true);
+        channel->setPan(-1.0f + 2.0f * static_cast<float>(c) / static_cast<float>(std::max(1, numChannels - 1)));
+        channel->setDelaySend(0.3f);
+        channel->setGrainSend(0.3f);
+        channel->setReverbSend(0.3f);
+
+        for (int auxId : auxIds)
+            channel->setAuxSend(auxId, 0.5f);
+    }
+
+    return engine;
+}
+
+void benchEngine(BenchRunner& runner, const Sweep& sweep)
+{
+    juce::Random random(5);
+
+    for (int numChannels : sweep.channelCounts)
+    {
+        for (int numAux : sweep.auxCounts)
+        {
+            bool anySelected = false;
+            for (int blockSize : sweep.blockSizes)
+                anySelected = anySelected || runner.wouldRun("AudioEngine::getNextAudioBlock",
+                    { { "channels", numChannels }, { "aux", numAux }, { "block", blockSize } });
+
+            if (!anySelected)
+                continue;
+
+            auto engine = createEngine(numChannels, numAux, sweep.blockSizes.front());
+
+            for (int blockSize : sweep.blockSizes)
+            {
+                std::vector<BenchRunner::Param> params { { "channels", numChannels },
+                                                         { "aux", numAux },
+                                                         { "block", blockSize } };
+                if (!runner.wouldRun("AudioEngine::getNextAudioBlock", params))
+                    continue;
+
+                engine->prepareToPlay(blockSize, benchSampleRate);
+
+                juce::AudioBuffer<float> input(2 * numChannels, blockSize);
+                juce::AudioBuffer<float> output(2 + 2 * numAux, blockSize);
+                fillNoise(input, random);
+                engine->setInputChannels(input.getArrayOfReadPointers(), input.getNumChannels());
+
+                juce::AudioSourceChannelInfo info(&output, 0, blockSize);
+                runner.run("AudioEngine::getNextAudioBlock", params, blockSize, [&] {
+                    engine->getNextAudioBlock(info);
+                });
+
+                engine->setInputChannels(nullptr, 0);
+            }
+        }
+    }
+}
+
+// Render the same session serially and with render workers, comparing every output sample.
+// Parameter changes mid-run keep the gain ramps active in both.
+bool verifyParallelRender(int numWorkers)
+{
+    constexpr int numChannels = 32;
+    constexpr int numAux = 8;
+    constexpr int blockSize = 64;
+    constexpr int numBlocks = 400;
+
+    auto serial = createEngine(numChannels, numAux, blockSize);
+    auto parallel = createEngine(numChannels, numAux, blockSize);
+    parallel->setRenderWorkerCount(numWorkers);
+
+    juce::Random random(6);
+    juce::AudioBuffer<float> input(2 * numChannels, blockSize);
+    juce::AudioBuffer<float> serialOutput(2 + 2 * numAux, blockSize);
+    juce::AudioBuffer<float> parallelOutput(2 + 2 * numAux, blockSize);
+
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        if (block % 50 == 25)
+        {
+            for (auto* engine : { serial.get(), parallel.get() })
+            {
+                auto* channel = engine->getChannel(block % numChannels);
+                channel->setVolume(block % 100 == 25 ? 0.3f : 0.9f);
+                channel->setPan(block % 100 == 25 ? 0.8f : -0.4f);
+            }
+        }
+
+        fillNoise(input, random);
+        serial->setInputChannels(input.getArrayOfReadPointers(), input.getNumChannels());
+        parallel->setInputChannels(input.getArrayOfReadPointers(), input.getNumChannels());
+
+        serial->getNextAudioBlock(juce::AudioSourceChannelInfo(&serialOutput, 0, blockSize));
+        parallel->getNextAudioBlock(juce::AudioSourceChannelInfo(&parallelOutput, 0, blockSize));
+
+        for (int ch = 0; ch < serialOutput.getNumChannels(); ++ch)
+        {
+            if (std::memcmp(serialOutput.getReadPointer(ch), parallelOutput.getReadPointer(ch),
+                            sizeof(float) * static_cast<size_t>(blockSize)) != 0)
+            {
+                std::cerr << "Parallel render (" << numWorkers << " workers) differs from serial at block "
+                          << block << ", output " << ch << "\n";
+                return false;
+            }
+        }
+    }
+
+    serial->setInputChannels(nullptr, 0);
+    parallel->setInputChannels(nullptr, 0);
+    return true;
+}
+
+// Returns false if a parallel render is not bit-identical to the serial one
+bool benchParallelEngine(BenchRunner& runner, const Sweep& sweep)
+{
+    juce::Random random(7);
+
+    // The case the worker pool exists for: a full desk at small buffers
+    const int numChannels = Kousaten::AudioEngine::MAX_CHANNELS;
+    const int numAux = sweep.auxCounts.back();
+    const int blockSizes[] = { 64, 256 };
+
+    auto makeParams = [&](int blockSize, int numWorkers) {
+        return std::vector<BenchRunner::Param> { { "channels", numChannels },
+                                                 { "aux", numAux },
+                                                 { "block", blockSize },
+                                                 { "workers", numWorkers } };
+    };
+
+    // Timings are only meaningful if the parallel output is right
+    for (int numWorkers : sweep.workerCounts)
+    {
+        bool selected = false;
+        for (int blockSize : blockSizes)
+            selected = selected || runner.wouldRun("AudioEngine::parallel", makeParams(blockSize, numWorkers));
+
+        if (numWorkers > 0 && selected)
+        {
+            if (!verifyParallelRender(numWorkers))
+                return false;
+
+            std::cerr << "Parallel render with " << numWorkers << " workers matches serial render\n";
+        }
+    }
+
+    for (int blockSize : blockSizes)
+    {
+        for (int numWorkers : sweep.workerCounts)
+        {
+            auto params = makeParams(blockSize, numWorkers);
+            if (!runner.wouldRun("AudioEngine::parallel", params))
+                continue;
+
+            auto engine = createEngine(numChannels, numAux, blockSize);
+            engine->setRenderWorkerCount(numWorkers);
+
+            juce::AudioBuffer<float> input(2 * numChannels, blockSize);
+            juce::AudioBuffer<float> output(2 + 2 * numAux, blockSize);
+            fillNoise(input, random);
+            engine->setInputChannels(input.getArrayOfReadPointers(), input.getNumChannels());
+
+            juce::AudioSourceChannelInfo info(&output, 0, blockSize);
+            runner.run("AudioEngine::parallel", params, blockSize, [&] {
+                engine->getNextAudioBlock(info);
+            });
+
+            engine->setInputChannels(nullptr, 0);
+        }
+    }
+
+    return true;
+}
+
+// Heap allocations per engine block with a full send matrix and every send panner animating.
+// Returns false if the audio path allocates.
+bool benchAllocations(BenchRunner& runner)
+{
+    constexpr int numChannels = Kousaten::AudioEngine::MAX_CHANNELS;
+    constexpr int numAux = 16;
+    constexpr int blockSize = 64;
+    constexpr int numBlocks = 1000;
+
+    std::vector<BenchRunner::Param> params { { "channels", numChannels },
+                                             { "aux", numAux },
+                                             { "block", blockSize } };
+    if (!runner.wouldRun("AudioEngine::allocations", params))
+        return true;
+
+    auto engine = createEngine(numChannels, numAux, blockSize);
+
+    std::vector<int> auxIds;
+    for (int a = 0; a < numAux; ++a)
+        auxIds.push_back(engine->getAllAuxBuses()[static_cast<size_t>(a)]->getId());
+
+    const Kousaten::SendPannerMode modes[] = { Kousaten::SendPannerMode::XYPad,
+                                               Kousaten::SendPannerMode::Sequencer,
+                                               Kousaten::SendPannerMode::Random,
+                                               Kousaten::SendPannerMode::Rotate };
+    // Every insert slot runs on every aux
+    for (const auto& auxBus : engine->getAllAuxBuses())
+        configureInserts(auxBus->getInserts(), true, true, true);
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto* panner = engine->getChannel(c)->getSendPanner();
+        panner->arrangeAuxPositionsCircle(auxIds);
+        panner->setMode(modes[c % 4]);
+        panner->setSpeed(20.0f);
+        panner->setEnabled(true);
+    }
+
+    juce::Random random(8);
+    juce::AudioBuffer<float> input(2 * numChannels, blockSize);
+    juce::AudioBuffer<float> output(2 + 2 * numAux, blockSize);
+    fillNoise(input, random);
+    engine->setInputChannels(input.getArrayOfReadPointers(), input.getNumChannels());
+
+    // The profiled path must not allocate either (a full FIFO just drops records)
+    engine->getProfiler().setEnabled(true);
+
+    juce::AudioSourceChannelInfo info(&output, 0, blockSize);
+    runner.run("AudioEngine::allocations", params, blockSize, [&] {
+        engine->getNextAudioBlock(info);
+    });
+
+    auto allocationsBefore = heapAllocationCount.load();
+    for (int block = 0; block < numBlocks; ++block)
+        engine->getNextAudioBlock(info);
+    auto allocations = heapAllocationCount.load() - allocationsBefore;
+
+    engine->setInputChannels(nullptr, 0);
+
+    runner.addCounter("allocations_per_block", static_cast<double>(allocations) / numBlocks);
+
+    if (allocations != 0)
+    {
+        std::cerr << "Audio path allocated " << allocations << " times in " << numBlocks << " blocks\n";
+        return false;
+    }
+
+    return true;
+}
+
+// =============================================================================
+// Clock drift: an aux device on its own clock, simulated offline
+// =============================================================================
+
+// The engine writes blocks into the ring on its clock, the "device" pulls them through the
+// resampler on a clock offset by a known ppm. After the controller settles, the measured
+// drift must match the simulated one and the ring must not xrun.
+bool benchDriftCompensation(BenchRunner& runner, bool quick)
+{
+    constexpr int blockSize = 256;
+    constexpr int ringBlocks = 8;       // As RtOutputStream
+    constexpr int fadeInCallbacks = 4;  // Device callbacks before it starts reading
+    constexpr double maxPpmError = 1.0;
+    const double simulatedSeconds = quick ? 240.0 : 600.0;
+
+    bool passed = true;
+
+    for (double ppm : { -200.0, -50.0, 0.0, 50.0, 200.0 })
+    {
+        std::vector<BenchRunner::Param> params { { "ppm", ppm }, { "block", blockSize } };
+        if (!runner.wouldRun("AdaptiveResampler::drift", params))
+            continue;
+
+        Kousaten::AudioRingBuffer ring;
+        ring.setSize(static_cast<size_t>(blockSize * 2 * ringBlocks));
+
+        Kousaten::AdaptiveResampler resampler;
+        resampler.prepare(2, blockSize, benchSampleRate, ring.getCapacity() / 4.0);
+
+        std::vector<float> input(static_cast<size_t>(blockSize * 2));
+        std::vector<float> output(static_cast<size_t>(blockSize * 2));
+        double inputPhase = 0.0;
+
+        auto writeEngineBlock = [&] {
+            for (int i = 0; i < blockSize; ++i)
+            {
+                float sample = static_cast<float>(0.5 * std::sin(inputPhase));
+                inputPhase += juce::MathConstants<double>::twoPi * 1000.0 / benchSampleRate;
+                input[static_cast<size_t>(2 * i)] = sample;
+                input[static_cast<size_t>(2 * i + 1)] = sample;
+            }
+            ring.write(input.data(), input.size());
+        };
+
+        // Event-driven simulation of the two callback clocks
+        const double engineInterval = blockSize / benchSampleRate;
+        const double deviceInterval = engineInterval / (1.0 + ppm * 1.0e-6);
+        double engineTime = 0.0;
+        double deviceTime = fadeInCallbacks * deviceInterval;
+
+        // What RtOutputStream measures with the high-resolution clock
+        auto producerLead = [&] {
+            const double sinceLastWrite = deviceTime - (engineTime - engineInterval);
+            return std::min(static_cast<double>(blockSize), sinceLastWrite * benchSampleRate);
+        };
+
+        int xrunsAtSettle = 0;
+        bool settled = false;
+
+        while (engineTime < simulatedSeconds)
+        {
+            if (!settled && engineTime >= simulatedSeconds / 2.0)
+            {
+                xrunsAtSettle = ring.getNumOverruns() + ring.getNumUnderruns();
+                settled = true;
+            }
+
+            if (engineTime <= deviceTime)
+            {
+                writeEngineBlock();
+                engineTime += engineInterval;
+            }
+            else
+            {
+                resampler.process(ring, output.data(), blockSize, producerLead());
+                deviceTime += deviceInterval;
+            }
+        }
+
+        const double measuredPpm = resampler.getDriftPpm();
+        const int xruns = ring.getNumOverruns() + ring.getNumUnderruns() - xrunsAtSettle;
+
+        // Cost of one device callback with the ring fed on the same clock
+        runner.run("AdaptiveResampler::drift", params, blockSize, [&] {
+            writeEngineBlock();
+            resampler.process(ring, output.data(), blockSize);
+        });
+
+        runner.addCounter("measured_ppm", measuredPpm);
+        runner.addCounter("xruns_after_settling", xruns);
+
+        if (std::abs(measuredPpm - ppm) > maxPpmError || xruns != 0)
+        {
+            std::cerr << "Drift compensation failed at " << ppm << " ppm: measured " << measuredPpm
+                      << " ppm, " << xruns << " xruns after settling\n";
+            passed = false;
+        }
+    }
+
+    return passed;
+}
+
+// =============================================================================
+// Multi-device load: aux buses on virtual devices, each on its own drifting clock
+// =============================================================================
+
+// Runs the engine in real time with one aux bus per virtual device, so the whole device
+// path (staging, rings, resamplers, device threads) runs as it would on real interfaces.
+// Fails if any device plays nothing; xruns are reported (they depend on the machine).
+bool benchVirtualDevices(BenchRunner& runner, bool quick)
+{
+    constexpr int numDevices = Kousaten::RtAudioManager::MAX_DEVICE_STREAMS;
+    constexpr int numChannels = 8;
+    constexpr int blockSize = 256;
+    constexpr double warmupSeconds = 1.0;
+    const double measuredSeconds = quick ? 5.0 : 30.0;
+
+    std::vector<BenchRunner::Param> params { { "devices", numDevices }, { "block", blockSize } };
+    if (!runner.wouldRun("RtAudioManager::virtualDevices", params))
+        return true;
+
+    auto engine = createEngine(numChannels, numDevices, blockSize);
+    auto* manager = engine->getRtAudioManager();
+
+    auto backend = std::make_unique<Kousaten::VirtualOutputBackend>();
+    auto* virtualDevices = backend.get();
+
+    juce::StringArray deviceNames;
+    for (int d = 0; d < numDevices; ++d)
+    {
+        Kousaten::VirtualOutputBackend::DeviceConfig config;
+        config.name = "Virtual " + juce::String(d + 1);
+        config.driftPpm = -150.0 + 20.0 * d;
+        config.captureFrames = static_cast<int>(benchSampleRate);
+        virtualDevices->addDevice(config);
+        deviceNames.add(config.name);
+    }
+
+    manager->setBackend(std::move(backend));
+    manager->initialize();
+
+    for (int d = 0; d < numDevices; ++d)
+    {
+        auto* auxBus = engine->getAllAuxBuses()[static_cast<size_t>(d)].get();
+        auxBus->setOutputChannelStart(0);
+        auxBus->setOutputDevice(deviceNames[d]);
+    }
+
+    // Wait for the control thread to open every device
+    const double openDeadline = juce::Time::getMillisecondCounterHiRes() + 5000.0;
+    auto allOpen = [&] {
+        for (const auto& name : deviceNames)
+        {
+            if (!manager->isDeviceOpen(name))
+                return false;
+        }
+        return true;
+    };
+
+    while (!allOpen() && juce::Time::getMillisecondCounterHiRes() < openDeadline)
+        juce::Thread::sleep(10);
+
+    if (!allOpen())
+    {
+        std::cerr << "Virtual devices did not open\n";
+        return false;
+    }
+
+    juce::Random random(9);
+    juce::AudioBuffer<float> input(2 * numChannels, blockSize);
+    juce::AudioBuffer<float> output(2, blockSize);
+    fillNoise(input, random);
+    engine->setInputChannels(input.getArrayOfReadPointers(), input.getNumChannels());
+    juce::AudioSourceChannelInfo info(&output, 0, blockSize);
+
+    // The engine plays the main device: one block per period of the nominal clock
+    const double blockMs = 1000.0 * blockSize / benchSampleRate;
+    double deadlineMs = juce::Time::getMillisecondCounterHiRes();
+
+    auto runRealtime = [&](double seconds) {
+        const auto numBlocks = static_cast<int>(seconds * benchSampleRate / blockSize);
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            deadlineMs += blockMs;
+            for (double remaining = deadlineMs - juce::Time::getMillisecondCounterHiRes(); remaining > 0.0;
+                 remaining = deadlineMs - juce::Time::getMillisecondCounterHiRes())
+            {
+                if (remaining > 2.0)
+                    juce::Thread::sleep(static_cast<int>(remaining) - 1);
+                else
+                    std::this_thread::yield();
+            }
+
+            engine->getNextAudioBlock(info);
+        }
+    };
+
+    auto countXruns = [&] {
+        int xruns = 0;
+        for (int d = 0; d < numDevices; ++d)
+        {
+            auto* auxBus = engine->getAllAuxBuses()[static_cast<size_t>(d)].get();
+            xruns += auxBus->getDeviceOverruns() + auxBus->getDeviceUnderruns();
+        }
+        return xruns;
+    };
+
+    // Rings start empty and fill once the buses write; only count xruns after that
+    runRealtime(warmupSeconds);
+    const int xrunsAfterWarmup = countXruns();
+    for (const auto& name : deviceNames)
+        virtualDevices->clearCapture(name);
+
+    runRealtime(measuredSeconds);
+    const int xruns = countXruns() - xrunsAfterWarmup;
+
+    int silentDevices = 0;
+    juce::int64 deviceCallbacks = 0;
+
+    for (int d = 0; d < numDevices; ++d)
+    {
+        const auto capture = virtualDevices->getCapture(deviceNames[d]);
+        if (capture.getNumSamples() == 0 || capture.getMagnitude(0, capture.getNumSamples()) < 1.0e-4f)
+            ++silentDevices;
+
+        deviceCallbacks += virtualDevices->getNumCallbacks(deviceNames[d]);
+    }
+
+    // Cost of one engine block feeding every device (the rings overflow from here on,
+    // which no longer matters)
+    runner.run("RtAudioManager::virtualDevices", params, blockSize, [&] {
+        engine->getNextAudioBlock(info);
+    });
+
+    engine->setInputChannels(nullptr, 0);
+
+    runner.addCounter("xruns_after_warmup", xruns);
+    runner.addCounter("silent_devices", silentDevices);
+    runner.addCounter("device_callbacks", static_cast<double>(deviceCallbacks));
+
+    if (silentDevices > 0)
+    {
+        std::cerr << silentDevices << " of " << numDevices << " virtual devices played nothing\n";
+        return false;
+    }
+
+    return true;
+}
+
+// Device list for the mocked enumeration backend; edited between scans to plug and
+// unplug devices
+struct MockDeviceList
+{
+    std::mutex lock;
+    juce::StringArray names;
+};
+
+class MockDeviceBackend : public Kousaten::DeviceEnumerationBackend
+{
+public:
+    MockDeviceBackend(MockDeviceList& deviceList, int probeCostMs)
+        : list(deviceList), probeMs(probeCostMs)
+    {
+    }
+
+    std::vector<Kousaten::EnumeratedDevice> listDevices() override
+    {
+        std::lock_guard<std::mutex> guard(list.lock);
+
+        std::vector<Kousaten::EnumeratedDevice> listed;
+        for (int i = 0; i < list.names.size(); ++i)
+        {
+            Kousaten::EnumeratedDevice device;
+            device.typeName = "Mock";
+            device.name = list.names[i];
+            device.runtimeId = static_cast<unsigned int>(i + 1);
+            listed.push_back(device);
+        }
+        return listed;
+    }
+
+    bool probeDevice(Kousaten::EnumeratedDevice& device) override
+    {
+        // Stands in for opening the device to read its channels
+        juce::Thread::sleep(probeMs);
+
+        for (int ch = 0; ch < 8; ++ch)
+            device.outputChannelNames.add("Output " + juce::String(ch + 1));
+        device.sampleRates = { 44100.0, 48000.0, 96000.0 };
+        return true;
+    }
+
+private:
+    MockDeviceList& list;
+    int probeMs;
+};
+
+// Startup and hot-plug behaviour of DeviceEnumerator against a mocked backend whose
+// probes cost probeCostMs each. Fails if a rescan probes known devices again or a
+// hot-plug isn't reported as exactly one change.
+bool benchDeviceEnumeration(BenchRunner& runner)
+{
+    constexpr int probeCostMs = 5;
+    bool passed = true;
+
+    for (int numDevices : { 8, 32 })
+    {
+        std::vector<BenchRunner::Param> params { { "devices", numDevices }, { "probe_ms", probeCostMs } };
+        if (!runner.wouldRun("DeviceEnumerator::scan", params))
+            continue;
+
+        MockDeviceList list;
+        for (int i = 0; i < numDevices; ++i)
+            list.names.add("Mock Interface " + juce::String(i + 1));
+
+        auto cacheFile = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                             .getChildFile("KousatenBenchDevices_" + juce::String(numDevices) + ".json");
+        cacheFile.deleteFile();
+
+        auto makeEnumerator = [&] {
+            return std::make_unique<Kousaten::DeviceEnumerator>(
+                std::make_unique<MockDeviceBackend>(list, probeCostMs), cacheFile);
+        };
+
+        // Cold start: no cache, every device is probed before the list is complete
+        double coldScanMs = 0.0;
+        {
+            auto enumerator = makeEnumerator();
+            const double start = juce::Time::getMillisecondCounterHiRes();
+            enumerator->scanNow();
+            coldScanMs = juce::Time::getMillisecondCounterHiRes() - start;
+        }
+
+        // Warm start: the list comes from the cache while the scan thread verifies it
+        double cachedListMs = 0.0;
+        size_t cachedDevices = 0;
+        {
+            auto enumerator = makeEnumerator();
+            const double start = juce::Time::getMillisecondCounterHiRes();
+            enumerator->start(0);
+            cachedDevices = enumerator->getDevices().size();
+            cachedListMs = juce::Time::getMillisecondCounterHiRes() - start;
+        }
+
+        auto enumerator = makeEnumerator();
+        enumerator->scanNow();
+
+        // Steady state: a rescan with nothing plugged in only lists
+        const int probesBeforeRescan = enumerator->getNumProbes();
+        const bool unchanged = enumerator->scanNow().isEmpty();
+        const int rescanProbes = enumerator->getNumProbes() - probesBeforeRescan;
+
+        // Hot-plug: one device in, then out again
+        {
+            std::lock_guard<std::mutex> guard(list.lock);
+            list.names.add("Hot-plugged Interface");
+        }
+        const int probesBeforePlug = enumerator->getNumProbes();
+        const auto plugged = enumerator->scanNow();
+        const int hotplugProbes = enumerator->getNumProbes() - probesBeforePlug;
+
+        {
+            std::lock_guard<std::mutex> guard(list.lock);
+            list.names.removeString("Hot-plugged Interface");
+        }
+        const auto unplugged = enumerator->scanNow();
+
+        runner.run("DeviceEnumerator::scan", params, 1, [&] { enumerator->scanNow(); });
+
+        runner.addCounter("cold_scan_ms", coldScanMs);
+        runner.addCounter("cached_list_ms", cachedListMs);
+        runner.addCounter("rescan_probes", rescanProbes);
+        runner.addCounter("hotplug_probes", hotplugProbes);
+
+        const bool hotplugReported = plugged.added.size() == 1 && plugged.removed.isEmpty()
+                                  && unplugged.added.empty() && unplugged.removed.size() == 1;
+
+        if (cachedDevices != static_cast<size_t>(numDevices) || !unchanged || rescanProbes != 0
+            || hotplugProbes != 1 || !hotplugReported)
+        {
+            std::cerr << "Device enumeration failed with " << numDevices << " devices: "
+                      << cachedDevices << " listed from the cache, " << rescanProbes << " probes on rescan, "
+                      << hotplugProbes << " probes on hot-plug\n";
+            passed = false;
+        }
+
+        cacheFile.deleteFile();
+    }
+
+    return passed;
+}
+
+void printUsage()
+{
+    std::cout
+        << "Usage: KousatenBench [options]\n"
+        << "\n"
+        << "Options:\n"
+        << "  --filter <text>     Only run benchmarks whose name contains <text>\n"
+        << "  --min-time <sec>    Minimum measured time per benchmark (default: 0.1)\n"
+        << "  --quick             Reduced sweep (blocks 64/512, channels 1/8/32, aux 0/4/16, workers 0/3)\n"
+        << "  --output <file>     Write the JSON report to <file> instead of stdout\n";
+}
+
+bool parseArguments(int argc, char* argv[], BenchOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        juce::String arg(argv[i]);
+
+        if (arg == "--quick")
+        {
+            options.quick = true;
+            continue;
+        }
+
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+
+        juce::String value(argv[++i]);
+
+        if (arg == "--filter")          options.filter = value;
+        else if (arg == "--min-time")   options.minTime = value.getDoubleValue();
+        else if (arg == "--output")     options.outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        else
+            return false;
+    }
+
+    return options.minTime > 0.0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!parseArguments(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    BenchRunner runner;
+    runner.setFilter(options.filter);
+    runner.setMinTime(options.minTime);
+    runner.setReferenceSampleRate(benchSampleRate);
+
+    auto sweep = makeSweep(options.quick);
+
+    benchChannel(runner, sweep);
+    benchMixBus(runner, sweep);
+    benchAuxBus(runner, sweep);
+    benchEffects(runner, sweep);
+    benchEngine(runner, sweep);
+
+    if (!benchReverbRates(runner))
+        return 1;
+
+    if (!benchDelayRates(runner))
+        return 1;
+
+    if (!benchDelayInterpolation(runner))
+        return 1;
+
+    if (!benchInterleave(runner, sweep))
+        return 1;
+
+    if (!benchInserts(runner, sweep))
+        return 1;
+
+    if (!benchParallelEngine(runner, sweep))
+        return 1;
+
+    if (!benchAllocations(runner))
+        return 1;
+
+    if (!benchDriftCompensation(runner, options.quick))
+        return 1;
+
+    if (!benchDeviceEnumeration(runner))
+        return 1;
+
+    if (!benchVirtualDevices(runner, options.quick))
+        return 1;
+
+    auto json = runner.toJson();
+
+    if (options.outputFile == juce::File())
+    {
+        std::cout << json << "\n";
+    }
+    else if (!options.outputFile.replaceWithText(json))
+    {
+        std::cerr << "Cannot write " << options.outputFile.getFullPathName() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+    Kousaten Mixer - Bench Runner
+    Implementation
+*/
+
+#include "BenchRunner.h"
+#include <iostream>
+
+namespace Kousaten {
+
+double BenchRunner::Result::getNanosPerIteration() const
+{
+    return iterations > 0 ? totalSeconds * 1.0e9 / static_cast<double>(iterations) : 0.0;
+}
+
+double BenchRunner::Result::getNanosPerSample() const
+{
+    return samplesPerIteration > 0 ? getNanosPerIteration() / samplesPerIteration : 0.0;
+}
+
+juce::String BenchRunner::makeName(const juce::String& family, const std::vector<Param>& params)
+{
+    juce::String name = family;
+    for (const auto& param : params)
+        name += "/" + param.name + ":" + param.value.toString();
+    return name;
+}
+
+bool BenchRunner::wouldRun(const juce::String& family, const std::vector<Param>& params) const
+{
+    return filter.isEmpty() || makeName(family, params).contains(filter);
+}
+
+bool BenchRunner::run(const juce::String& family, const std::vector<Param>& params,
+                      int samplesPerIteration, const std::function<void()>& body)
+{
+    if (!wouldRun(family, params))
+        return false;
+
+    const auto ticksPerSecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+    auto timeIterations = [&](juce::int64 count) {
+        const auto start = juce::Time::getHighResolutionTicks();
+        for (juce::int64 i = 0; i < count; ++i)
+            body();
+        return static_cast<double>(juce::Time::getHighResolutionTicks() - start) / ticksPerSecond;
+    };
+
+    // Warm up caches, smoothers and delay lines before measuring
+    timeIterations(1);
+    for (juce::int64 count = 1; timeIterations(count) < minTimeSeconds * 0.1; count *= 2) {}
+
+    // Double the iteration count until one run covers the minimum time
+    juce::int64 iterations = 1;
+    double elapsed = timeIterations(iterations);
+    while (elapsed < minTimeSeconds && iterations < (static_cast<juce::int64>(1) << 40))
+    {
+        // Jump straight to the estimated count, with a little headroom
+        double scale = elapsed > 0.0 ? (minTimeSeconds * 1.2) / elapsed : 10.0;
+        iterations = std::max(iterations * 2, static_cast<juce::int64>(static_cast<double>(iterations) * std::min(scale, 10.0)));
+        elapsed = timeIterations(iterations);
+    }
+
+    Result result;
+    result.name = makeName(family, params);
+    result.family = family;
+    result.params = params;
+    result.iterations = iterations;
+    result.samplesPerIteration = samplesPerIteration;
+    result.totalSeconds = elapsed;
+    results.push_back(result);
+
+    std::cerr << result.name << "  " << juce::String(result.getNanosPerSample(), 3) << " ns/sample\n";
+    return true;
+}
+
+void BenchRunner::addCounter(const juce::String& name, double value)
+{
+    if (results.empty())
+        return;
+
+    results.back().counters.emplace_back(name, value);
+    std::cerr << results.back().name << "  " << name << " = " << juce::String(value, 3) << "\n";
+}
+
+juce::String BenchRunner::toJson() const
+{
+    auto* context = new juce::DynamicObject();
+    context->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+    context->setProperty("host_os", juce::SystemStats::getOperatingSystemName());
+    context->setProperty("cpu_model", juce::SystemStats::getCpuModel());
+    context->setProperty("num_cpus", juce::SystemStats::getNumCpus());
+    context->setProperty("reference_sample_rate", referenceSampleRate);
+    context->setProperty("min_time_seconds", minTimeSeconds);
+   #if JUCE_DEBUG
+    context->setProperty("build_type", "debug");
+   #else
+    context->setProperty("build_type", "release");
+   #endif
+
+    juce::Array<juce::var> benchmarks;
+    for (const auto& result : results)
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty("name", result.name);
+        entry->setProperty("family", result.family);
+
+        auto* params = new juce::DynamicObject();
+        for (const auto& param : result.params)
+            params->setProperty(param.name, param.value);
+        entry->setProperty("params", juce::var(params));
+
+        entry->setProperty("iterations", result.iterations);
+        entry->setProperty("samples_per_iteration", result.samplesPerIteration);
+        entry->setProperty("real_time_ns", result.getNanosPerIteration());
+        entry->setProperty("ns_per_sample", result.getNanosPerSample());
+
+        // Fraction of one core needed to keep up at the reference rate
+        entry->setProperty("cpu_load_percent", result.getNanosPerSample() * referenceSampleRate * 1.0e-7);
+
+        for (const auto& [name, value] : result.counters)
+            entry->setProperty(name, value);
+
+        benchmarks.add(juce::var(entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("context", juce::var(context));
+    root->setProperty("benchmarks", benchmarks);
+
+    return juce::JSON::toString(juce::var(root));
+}
+
+} // namespace Kousaten
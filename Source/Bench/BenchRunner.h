@@ -0,0 +1,74 @@
+/*
+    Kousaten Mixer - Bench Runner
+    Minimal benchmark harness reporting ns/sample as JSON
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+
+namespace Kousaten {
+
+class BenchRunner
+{
+public:
+    struct Param
+    {
+        juce::String name;
+        juce::var value;
+    };
+
+    struct Result
+    {
+        juce::String name;
+        juce::String family;
+        std::vector<Param> params;
+        juce::int64 iterations = 0;
+        int samplesPerIteration = 0;
+        double totalSeconds = 0.0;
+        std::vector<std::pair<juce::String, double>> counters;
+
+        double getNanosPerIteration() const;
+        double getNanosPerSample() const;
+    };
+
+    BenchRunner() = default;
+
+    // Only run benchmarks whose full name contains this text (empty = all)
+    void setFilter(const juce::String& text) { filter = text; }
+
+    // Minimum measured time per benchmark; iterations are doubled until reached
+    void setMinTime(double seconds) { minTimeSeconds = seconds; }
+
+    // Sample rate used for the "CPU load at realtime" column
+    void setReferenceSampleRate(double rate) { referenceSampleRate = rate; }
+
+    // Time `body`, which processes samplesPerIteration samples per call.
+    // Returns false if the benchmark was filtered out.
+    bool run(const juce::String& family, const std::vector<Param>& params,
+             int samplesPerIteration, const std::function<void()>& body);
+
+    bool wouldRun(const juce::String& family, const std::vector<Param>& params) const;
+
+    // Attach a user counter to the most recent result (reported next to ns_per_sample)
+    void addCounter(const juce::String& name, double value);
+
+    const std::vector<Result>& getResults() const { return results; }
+
+    // Google-Benchmark-style JSON report ({ "context": ..., "benchmarks": [...] })
+    juce::String toJson() const;
+
+    static juce::String makeName(const juce::String& family, const std::vector<Param>& params);
+
+private:
+    juce::String filter;
+    double minTimeSeconds = 0.1;
+    double referenceSampleRate = 48000.0;
+    std::vector<Result> results;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BenchRunner)
+};
+
+} // namespace Kousaten
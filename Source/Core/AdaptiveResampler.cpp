@@ -0,0 +1,198 @@
+/*
+    Kousaten Mixer - Adaptive Resampler
+    Implementation
+*/
+
+#include "AdaptiveResampler.h"
+#include "InterleaveKernels.h"
+#include <cmath>
+
+namespace Kousaten {
+
+namespace {
+
+constexpr int centreTap = AdaptiveResampler::TAPS / 2 - 1;  // Tap aligned with the integer read position
+constexpr double kernelCutoff = 0.9;                         // Fraction of Nyquist
+
+// Controller time constants (seconds): fill smoothing, proportional correction, integral
+constexpr double fillSmoothingTime = 0.5;
+constexpr double proportionalTime = 4.0;
+constexpr double integralTime = 16.0;
+
+double sinc(double x)
+{
+    if (std::abs(x) < 1.0e-9)
+        return 1.0;
+    const double px = juce::MathConstants<double>::pi * x;
+    return std::sin(px) / px;
+}
+
+} // namespace
+
+AdaptiveResampler::AdaptiveResampler()
+    : kernel(static_cast<size_t>(PHASES + 1))
+{
+    const double halfSpan = TAPS / 2.0;
+
+    for (int p = 0; p <= PHASES; ++p)
+    {
+        const double frac = static_cast<double>(p) / PHASES;
+        auto& row = kernel[static_cast<size_t>(p)];
+        double sum = 0.0;
+
+        for (int k = 0; k < TAPS; ++k)
+        {
+            const double x = (k - centreTap) - frac;
+            const double w = 0.42 + 0.5 * std::cos(juce::MathConstants<double>::pi * x / halfSpan)
+                                  + 0.08 * std::cos(juce::MathConstants<double>::twoPi * x / halfSpan);
+            const double h = kernelCutoff * sinc(kernelCutoff * x) * w;
+            row[static_cast<size_t>(k)] = static_cast<float>(h);
+            sum += h;
+        }
+
+        // Unity gain at DC for every phase
+        for (auto& h : row)
+            h = static_cast<float>(h / sum);
+    }
+}
+
+void AdaptiveResampler::prepare(int channels, int maxFramesPerBlock, double rate, double targetFillFrames)
+{
+    numChannels = std::max(1, channels);
+    sampleRate = rate;
+    targetFill = targetFillFrames;
+
+    // Worst case input for one block: every frame at the maximum ratio, plus rounding
+    maxInputFrames = static_cast<int>(std::ceil(maxFramesPerBlock * (1.0 + MAX_CORRECTION_PPM * 1.0e-6))) + 2;
+
+    history.assign(static_cast<size_t>(numChannels), std::vector<float>(static_cast<size_t>(TAPS + maxInputFrames + 1), 0.0f));
+    inputScratch.assign(static_cast<size_t>(maxInputFrames * numChannels), 0.0f);
+    historyWritePointers.assign(static_cast<size_t>(numChannels), nullptr);
+
+    reset();
+}
+
+void AdaptiveResampler::reset()
+{
+    for (auto& channel : history)
+        std::fill(channel.begin(), channel.end(), 0.0f);
+
+    // Start with TAPS - 1 frames of silence so the first output frame has full support
+    historyFrames = TAPS - 1;
+    position = centreTap;
+
+    smoothedFill = 0.0;
+    integral = 0.0;
+    ratio = 1.0;
+    controllerPrimed = false;
+    publishedRatio.store(1.0, std::memory_order_relaxed);
+    publishedDriftPpm.store(0.0, std::memory_order_relaxed);
+    publishedLatency.store(0.0, std::memory_order_relaxed);
+}
+
+void AdaptiveResampler::updateController(double fillFrames, int numFrames)
+{
+    const double dt = numFrames / sampleRate;
+
+    if (!controllerPrimed)
+    {
+        smoothedFill = fillFrames;
+        controllerPrimed = true;
+    }
+
+    smoothedFill += (dt / (fillSmoothingTime + dt)) * (fillFrames - smoothedFill);
+
+    // Excess queue in seconds: drained over proportionalTime, integrated into the drift estimate
+    const double error = (smoothedFill - targetFill) / sampleRate;
+    const double maxCorrection = MAX_CORRECTION_PPM * 1.0e-6;
+
+    integral = juce::jlimit(-maxCorrection, maxCorrection,
+                            integral + error * dt / (proportionalTime * integralTime));
+    ratio = 1.0 + juce::jlimit(-maxCorrection, maxCorrection, error / proportionalTime + integral);
+
+    publishedRatio.store(ratio, std::memory_order_relaxed);
+    publishedDriftPpm.store((1.0 / (1.0 + integral) - 1.0) * 1.0e6, std::memory_order_relaxed);
+    publishedLatency.store(smoothedFill + TAPS / 2, std::memory_order_relaxed);
+}
+
+void AdaptiveResampler::process(AudioRingBuffer& ring, float* output, int numFrames, double producerLeadFrames)
+{
+    const int maxOutputFrames = maxInputFrames - 2;
+
+    while (numFrames > maxOutputFrames)
+    {
+        process(ring, output, maxOutputFrames, producerLeadFrames);
+        output += maxOutputFrames * numChannels;
+        numFrames -= maxOutputFrames;
+    }
+
+    if (numFrames <= 0)
+        return;
+
+    // Frames the block needs beyond the history: the last output's read position plus the
+    // kernel's right half
+    auto framesNeeded = [this, numFrames] {
+        const double lastPosition = position + (numFrames - 1) * ratio;
+        return static_cast<int>(lastPosition) + TAPS / 2 + 1 - historyFrames;
+    };
+
+    const double fill = static_cast<double>(ring.getNumReady() / static_cast<size_t>(numChannels));
+
+    // Only steer while the ring is actually being fed, so a silent producer can't wind up the integral
+    if (fill >= framesNeeded())
+        updateController(fill + producerLeadFrames, numFrames);
+
+    const int framesToRead = juce::jlimit(0, maxInputFrames, framesNeeded());
+    if (framesToRead > 0)
+    {
+        ring.read(inputScratch.data(), static_cast<size_t>(framesToRead * numChannels));
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            historyWritePointers[static_cast<size_t>(ch)] = history[static_cast<size_t>(ch)].data() + historyFrames;
+
+        Interleave::deinterleave(inputScratch.data(), numChannels, historyWritePointers.data(), framesToRead);
+
+        historyFrames += framesToRead;
+    }
+
+    // Windowed-sinc interpolation; the fixed-length tap loops are written to auto-vectorise
+    double readPosition = position;
+    for (int n = 0; n < numFrames; ++n, readPosition += ratio)
+    {
+        const int index = static_cast<int>(readPosition);
+        const double phase = (readPosition - index) * PHASES;
+        const int row = std::min(PHASES - 1, static_cast<int>(phase));  // Row PHASES + 1 doesn't exist
+        const float blend = static_cast<float>(phase - row);
+
+        const auto& k0 = kernel[static_cast<size_t>(row)];
+        const auto& k1 = kernel[static_cast<size_t>(row + 1)];
+
+        alignas(32) float taps[TAPS];
+        for (int k = 0; k < TAPS; ++k)
+            taps[k] = k0[static_cast<size_t>(k)] + blend * (k1[static_cast<size_t>(k)] - k0[static_cast<size_t>(k)]);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const float* x = history[static_cast<size_t>(ch)].data() + index - centreTap;
+            float sum = 0.0f;
+            for (int k = 0; k < TAPS; ++k)
+                sum += taps[k] * x[k];
+            output[n * numChannels + ch] = sum;
+        }
+    }
+
+    // Drop the frames no later output can reach
+    position = readPosition;
+    const int consumed = juce::jlimit(0, historyFrames, static_cast<int>(position) - centreTap);
+    if (consumed > 0)
+    {
+        for (auto& channel : history)
+            std::memmove(channel.data(), channel.data() + consumed,
+                         static_cast<size_t>(historyFrames - consumed) * sizeof(float));
+
+        historyFrames -= consumed;
+        position -= consumed;
+    }
+}
+
+} // namespace Kousaten
@@ -0,0 +1,85 @@
+/*
+    Kousaten Mixer - Adaptive Resampler
+    Drift-compensating reader for an AudioRingBuffer fed from another clock domain.
+    A PI controller on the ring fill level steers the resampling ratio; samples are
+    interpolated with a windowed-sinc polyphase kernel.
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioRingBuffer.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace Kousaten {
+
+class AdaptiveResampler
+{
+public:
+    static constexpr int TAPS = 16;
+    static constexpr int PHASES = 256;
+
+    // Largest correction the controller applies, either way
+    static constexpr double MAX_CORRECTION_PPM = 2000.0;
+
+    AdaptiveResampler();
+
+    // Control thread: size for blocks of up to maxFramesPerBlock and aim to keep
+    // targetFillFrames frames queued in the ring
+    void prepare(int numChannels, int maxFramesPerBlock, double sampleRate, double targetFillFrames);
+
+    // Clear history and controller state (not while process() can run)
+    void reset();
+
+    // Consumer thread: produce numFrames interleaved frames from the ring, consuming
+    // (numFrames x ratio) frames. Short reads are padded by the ring and counted there.
+    // producerLeadFrames is how far the producer has got, in real time, into the block it
+    // will write next; adding it to the ring fill removes the one-block sawtooth the
+    // callback phase would otherwise feed into the controller.
+    void process(AudioRingBuffer& ring, float* output, int numFrames, double producerLeadFrames = 0.0);
+
+    // Input frames consumed per output frame (1 = same clock)
+    double getRatio() const { return publishedRatio.load(std::memory_order_relaxed); }
+
+    // Measured clock offset of the consumer (device) against the producer (engine), in ppm:
+    // positive when the device runs fast. Taken from the controller's integral term.
+    double getDriftPpm() const { return publishedDriftPpm.load(std::memory_order_relaxed); }
+
+    // Frames between entering the ring and leaving process(): the smoothed fill plus the
+    // kernel's look-ahead. 0 until the controller has had a measurement.
+    double getLatencyFrames() const { return publishedLatency.load(std::memory_order_relaxed); }
+
+private:
+    // Polyphase windowed sinc, PHASES + 1 rows so row p + 1 exists for interpolation
+    std::vector<std::array<float, TAPS>> kernel;
+
+    int numChannels = 2;
+    int maxInputFrames = 0;
+    double sampleRate = 48000.0;
+    double targetFill = 0.0;
+
+    // Deinterleaved input history per channel; position is relative to its first frame
+    std::vector<std::vector<float>> history;
+    std::vector<float> inputScratch;
+    std::vector<float*> historyWritePointers;  // Where the next ring read lands, per channel
+    int historyFrames = 0;
+    double position = 0.0;
+
+    // PI controller on the (smoothed) fill level
+    double smoothedFill = 0.0;
+    double integral = 0.0;
+    double ratio = 1.0;
+    bool controllerPrimed = false;
+
+    std::atomic<double> publishedRatio { 1.0 };
+    std::atomic<double> publishedDriftPpm { 0.0 };
+    std::atomic<double> publishedLatency { 0.0 };
+
+    void updateController(double fillFrames, int numFrames);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AdaptiveResampler)
+};
+
+} // namespace Kousaten
@@ -4,15 +4,166 @@
 */
 
 #include "AudioDeviceHandler.h"
+#include <functional>
+#include <mutex>
 
 namespace Kousaten {
 
+namespace {
+
+// Runs function on the message thread and waits for it. Gives up, returning false, once
+// the calling thread is asked to exit, so stopping a scan never waits on the message
+// thread (which is usually the one stopping it).
+bool callOnMessageThread(std::function<void()> function)
+{
+    auto* messageManager = juce::MessageManager::getInstanceWithoutCreating();
+    if (messageManager == nullptr || messageManager->isThisTheMessageThread())
+    {
+        function();
+        return true;
+    }
+
+    struct Call
+    {
+        std::function<void()> function;
+        std::mutex mutex;
+        bool finished = false;
+        bool abandoned = false;
+        juce::WaitableEvent done;
+    };
+
+    auto call = std::make_shared<Call>();
+    call->function = std::move(function);
+
+    const bool posted = juce::MessageManager::callAsync([call] {
+        std::lock_guard<std::mutex> lock(call->mutex);
+        if (!call->abandoned)
+            call->function();
+        call->finished = true;
+        call->done.signal();
+    });
+
+    if (!posted)
+        return false;
+
+    while (!call->done.wait(50.0))
+    {
+        if (juce::Thread::currentThreadShouldExit())
+            break;
+    }
+
+    // The call may be running right now; the lock waits it out, so nothing it writes
+    // outlives the caller's stack
+    std::lock_guard<std::mutex> lock(call->mutex);
+    call->abandoned = !call->finished;
+    return call->finished;
+}
+
+// Enumerates the devices of every JUCE device type. The device types belong to the
+// handler's device manager and are only touched on the message thread, like everything
+// else the manager owns; the scan thread waits for each call. The types keep their own
+// lists current (the manager scans them when it starts, and a type that reports a
+// change has rescanned itself), so listing only reads names; only devices the
+// enumerator hasn't seen are created.
+class JuceDeviceEnumerationBackend : public DeviceEnumerationBackend
+{
+public:
+    explicit JuceDeviceEnumerationBackend(juce::AudioDeviceManager& manager)
+        : deviceManager(manager)
+    {
+    }
+
+    std::vector<EnumeratedDevice> listDevices() override
+    {
+        std::vector<EnumeratedDevice> listed;
+
+        callOnMessageThread([this, &listed] {
+            for (auto* deviceType : deviceManager.getAvailableDeviceTypes())
+            {
+                for (bool isInput : { true, false })
+                {
+                    for (const auto& name : deviceType->getDeviceNames(isInput))
+                    {
+                        EnumeratedDevice device;
+                        device.typeName = deviceType->getTypeName();
+                        device.name = name;
+                        device.isInput = isInput;
+                        listed.push_back(device);
+                    }
+                }
+            }
+        });
+
+        return listed;
+    }
+
+    bool probeDevice(EnumeratedDevice& device) override
+    {
+        bool probed = false;
+
+        callOnMessageThread([this, &device, &probed] { probed = probeOnMessageThread(device); });
+
+        return probed;
+    }
+
+private:
+    juce::AudioDeviceManager& deviceManager;
+
+    bool probeOnMessageThread(EnumeratedDevice& device)
+    {
+        // The open device answers for itself rather than being opened a second time
+        auto* current = deviceManager.getCurrentAudioDevice();
+        if (current != nullptr && current->getName() == device.name
+            && deviceManager.getCurrentAudioDeviceType() == device.typeName)
+        {
+            readCapabilities(*current, device);
+            return true;
+        }
+
+        for (auto* deviceType : deviceManager.getAvailableDeviceTypes())
+        {
+            if (deviceType->getTypeName() != device.typeName)
+                continue;
+
+            // Creating the device is what makes a scan slow; it's only done for devices
+            // the enumerator hasn't seen
+            std::unique_ptr<juce::AudioIODevice> created(
+                device.isInput ? deviceType->createDevice(juce::String(), device.name)
+                               : deviceType->createDevice(device.name, juce::String()));
+
+            if (created == nullptr)
+                return false;
+
+            readCapabilities(*created, device);
+            return true;
+        }
+
+        return false;
+    }
+
+    static void readCapabilities(juce::AudioIODevice& audioDevice, EnumeratedDevice& device)
+    {
+        if (device.isInput)
+            device.inputChannelNames = audioDevice.getInputChannelNames();
+        else
+            device.outputChannelNames = audioDevice.getOutputChannelNames();
+
+        device.sampleRates = audioDevice.getAvailableSampleRates();
+    }
+};
+
+} // namespace
+
 AudioDeviceHandler::AudioDeviceHandler()
 {
 }
 
 AudioDeviceHandler::~AudioDeviceHandler()
 {
+    for (auto* deviceType : deviceManager.getAvailableDeviceTypes())
+        deviceType->removeListener(this);
+
+    deviceEnumerator.reset();
     deviceManager.closeAudioDevice();
 }
 
@@ -25,65 +176,60 @@ void AudioDeviceHandler::initialize()
         DBG("Audio device init error: " + result);
     }
 
-    scanDevices();
+    deviceEnumerator = std::make_unique<DeviceEnumerator>(
+        std::make_unique<JuceDeviceEnumerationBackend>(deviceManager),
+        DeviceEnumerator::getDefaultCacheDirectory().getChildFile("AudioDevices.json"));
+
+    deviceEnumerator->onDevicesChanged = [this](const DeviceEnumerator::Changes& changes) {
+        for (const auto& key : changes.removed)
+            DBG("Audio device removed: " + key);
+        for (const auto& device : changes.added)
+            DBG("Audio device found: " + device.getKey());
+
+        updateDevices();
+    };
+
+    // No polling: a scan lists every type's devices on the message thread, so it only
+    // runs at startup and when a type reports that its devices changed
+    deviceEnumerator->start(0);
+    updateDevices();
+
+    for (auto* deviceType : deviceManager.getAvailableDeviceTypes())
+        deviceType->addListener(this);
 }
 
-void AudioDeviceHandler::scanDevices()
+void AudioDeviceHandler::updateDevices()
 {
     inputDevices.clear();
     outputDevices.clear();
 
-    auto& deviceTypes = deviceManager.getAvailableDeviceTypes();
-
-    for (auto* deviceType : deviceTypes)
+    for (const auto& device : deviceEnumerator->getDevices())
     {
-        deviceType->scanForDevices();
+        DeviceInfo info;
+        info.name = device.name;
+        info.sampleRates = device.sampleRates;
 
-        // Scan input devices
-        auto inputNames = deviceType->getDeviceNames(true);
-        for (const auto& name : inputNames)
+        if (device.isInput)
         {
-            DeviceInfo info;
-            info.name = name;
-
-            // Get channel info by temporarily creating device
-            if (auto* device = deviceType->createDevice(name, juce::String()))
-            {
-                auto inputChannels = device->getInputChannelNames();
-                info.inputChannelNames = inputChannels;
-                info.numInputChannels = inputChannels.size();
-                info.sampleRates = device->getAvailableSampleRates();
-                delete device;
-            }
-
-            inputDevices[name] = info;
+            info.inputChannelNames = device.inputChannelNames;
+            info.numInputChannels = device.inputChannelNames.size();
+            inputDevices[device.name] = info;
         }
-
-        // Scan output devices
-        auto outputNames = deviceType->getDeviceNames(false);
-        for (const auto& name : outputNames)
+        else
         {
-            DeviceInfo info;
-            info.name = name;
-
-            // Get channel info
-            if (auto* device = deviceType->createDevice(juce::String(), name))
-            {
-                auto outputChannels = device->getOutputChannelNames();
-                info.outputChannelNames = outputChannels;
-                info.numOutputChannels = outputChannels.size();
-                info.sampleRates = device->getAvailableSampleRates();
-                delete device;
-            }
-
-            outputDevices[name] = info;
+            info.outputChannelNames = device.outputChannelNames;
+            info.numOutputChannels = device.outputChannelNames.size();
+            outputDevices[device.name] = info;
         }
     }
+
+    ++deviceListVersion;
 }
 
-void AudioDeviceHandler::rescanDevices()
+void AudioDeviceHandler::audioDeviceListChanged()
 {
-    scanDevices();
+    if (deviceEnumerator != nullptr)
+        deviceEnumerator->requestScan();
 }
 
 juce::StringArray AudioDeviceHandler::getInputDeviceNames() const
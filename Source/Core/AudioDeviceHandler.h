@@ -6,6 +6,7 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "DeviceEnumerator.h"
 #include <map>
 #include <memory>
 
@@ -23,15 +24,19 @@ struct DeviceInfo
 };
 
 // Manages audio device enumeration and I/O
-class AudioDeviceHandler
+class AudioDeviceHandler : private juce::AudioIODeviceType::Listener
 {
 public:
     AudioDeviceHandler();
-    ~AudioDeviceHandler();
+    ~AudioDeviceHandler() override;
 
-    // Initialize and scan for devices
+    // Open the default device and list the others from the cache; a background scan
+    // checks them once and again whenever a driver reports that its devices changed
     void initialize();
 
+    // Counter that moves whenever the device lists change, for UIs to poll
+    int getDeviceListVersion() const { return deviceListVersion; }
+
     // Get available devices
     juce::StringArray getInputDeviceNames() const;
     juce::StringArray getOutputDeviceNames() const;
@@ -58,16 +63,20 @@ public:
     // Get current device names
     juce::String getCurrentOutputDeviceName() const;
 
-    // Rescan devices
-    void rescanDevices();
-
 private:
     juce::AudioDeviceManager deviceManager;
 
     std::map<juce::String, DeviceInfo> inputDevices;
     std::map<juce::String, DeviceInfo> outputDevices;
+    int deviceListVersion = 0;
+
+    std::unique_ptr<DeviceEnumerator> deviceEnumerator;
+
+    // Rebuild the device maps from the enumerator's list (message thread)
+    void updateDevices();
 
-    void scanDevices();
+    // A device type's list changed (message thread): the scan thread lists it again
+    void audioDeviceListChanged() override;
     juce::StringArray buildChannelOptions(int numChannels) const;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioDeviceHandler)
@@ -8,16 +8,24 @@
 namespace Kousaten {
 
 AudioEngine::AudioEngine()
+    : workerPool([this](int partition) { renderPartition(partition); })
 {
     smoothedMasterVolume.setCurrentAndTargetValue(masterVolume);
 
-    // Initialize RtAudio manager
-    rtAudioManager.initialize();
+    // The audio thread always has a snapshot to read, even before the first edit
+    publishTopology();
+
+    // RtAudio devices are enumerated by the app (rtAudioManager.initialize()), not by
+    // headless tools that never open one
 }
 
 AudioEngine::~AudioEngine()
 {
     releaseResources();
+    delete activeTopology.exchange(nullptr);
+
+    // Aux buses close their RtAudio streams, so they go before rtAudioManager
+    auxBuses.clear();
 }
 
 void AudioEngine::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
@@ -27,6 +35,13 @@ void AudioEngine::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 
     smoothedMasterVolume.reset(sampleRate, 0.02);
 
+    // Prepare channels (the audio callback is not running here)
+    for (auto& channel : channels)
+        channel->prepare(sampleRate, samplesPerBlockExpected);
+
+    // Partition sums are sized to the block, so republish with the new size
+    publishTopology();
+
     // Prepare send buses
     delayBus.prepare(sampleRate, samplesPerBlockExpected);
     grainBus.prepare(sampleRate, samplesPerBlockExpected);
@@ -39,7 +54,9 @@ void AudioEngine::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
     }
 
     // Allocate temporary buffers
-    tempBuffer.setSize(2, samplesPerBlockExpected);
+    masterScratchBuffer.setSize(2, samplesPerBlockExpected);
+    silentInputBuffer.setSize(1, samplesPerBlockExpected);
+    silentInputBuffer.clear();
     delaySendBuffer.setSize(2, samplesPerBlockExpected);
     grainSendBuffer.setSize(2, samplesPerBlockExpected);
     reverbSendBuffer.setSize(2, samplesPerBlockExpected);
@@ -47,159 +64,183 @@ void AudioEngine::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
     grainReturnBuffer.setSize(2, samplesPerBlockExpected);
     reverbReturnBuffer.setSize(2, samplesPerBlockExpected);
 
-    // Per-channel send buffers (pre-allocated to avoid allocation in audio callback)
-    channelDelaySendBuffer.setSize(2, samplesPerBlockExpected);
-    channelGrainSendBuffer.setSize(2, samplesPerBlockExpected);
-    channelReverbSendBuffer.setSize(2, samplesPerBlockExpected);
-
     // Aux bus output buffer (pre-allocated)
     auxOutputBuffer.setSize(2, samplesPerBlockExpected);
+
+    latencyCompensator.prepare(sampleRate, samplesPerBlockExpected, mainOutputChannels);
+    masterAlignment.prepare(2, InsertChain::getMaxLatencySamples(sampleRate), samplesPerBlockExpected);
 }
 
 void AudioEngine::releaseResources()
 {
-    tempBuffer.setSize(0, 0);
+    masterScratchBuffer.setSize(0, 0);
+    silentInputBuffer.setSize(0, 0);
     delaySendBuffer.setSize(0, 0);
     grainSendBuffer.setSize(0, 0);
     reverbSendBuffer.setSize(0, 0);
     delayReturnBuffer.setSize(0, 0);
     grainReturnBuffer.setSize(0, 0);
     reverbReturnBuffer.setSize(0, 0);
-    channelDelaySendBuffer.setSize(0, 0);
-    channelGrainSendBuffer.setSize(0, 0);
-    channelReverbSendBuffer.setSize(0, 0);
     auxOutputBuffer.setSize(0, 0);
+
+    // The audio callback has stopped, so nothing can still be reading retired snapshots
+    retiredTopologies.clear();
 }
 
 void AudioEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
-    auto* outputBuffer = bufferToFill.buffer;
-    auto numSamples = bufferToFill.numSamples;
-    auto startSample = bufferToFill.startSample;
+    auto* buffer = bufferToFill.buffer;
+    int numOutputs = std::min(buffer->getNumChannels(), MAX_IO_CHANNELS);
+
+    float* outputs[MAX_IO_CHANNELS];
+    for (int ch = 0; ch < numOutputs; ++ch)
+        outputs[ch] = buffer->getWritePointer(ch, bufferToFill.startSample);
+
+    processBlock(inputChannels, numInputChannels, outputs, numOutputs, bufferToFill.numSamples);
+}
+
+void AudioEngine::processBlock(const float* const* inputs, int numInputs,
+                               float* const* outputs, int numOutputs,
+                               int numSamples)
+{
+    RealtimeGuard::ScopedRealtimeSection realtimeSection;
+
+    if (currentBlockSize <= 0)
+    {
+        // Not prepared yet: output silence
+        for (int ch = 0; ch < numOutputs; ++ch)
+        {
+            if (outputs[ch] != nullptr)
+                juce::FloatVectorOperations::clear(outputs[ch], numSamples);
+        }
+        return;
+    }
+
+    profiler.beginBlock(numSamples, currentSampleRate);
+
+    if (numSamples <= currentBlockSize)
+    {
+        renderBlock(inputs, numInputs, outputs, numOutputs, numSamples);
+    }
+    else
+    {
+        // Device delivered more than the prepared block size: render in prepared-size chunks
+        numInputs = std::min(numInputs, MAX_IO_CHANNELS);
+        numOutputs = std::min(numOutputs, MAX_IO_CHANNELS);
+
+        const float* inputChunk[MAX_IO_CHANNELS];
+        float* outputChunk[MAX_IO_CHANNELS];
+
+        for (int offset = 0; offset < numSamples; offset += currentBlockSize)
+        {
+            for (int ch = 0; ch < numInputs; ++ch)
+                inputChunk[ch] = inputs[ch] != nullptr ? inputs[ch] + offset : nullptr;
+            for (int ch = 0; ch < numOutputs; ++ch)
+                outputChunk[ch] = outputs[ch] != nullptr ? outputs[ch] + offset : nullptr;
+
+            renderBlock(inputChunk, numInputs, outputChunk, numOutputs,
+                        std::min(currentBlockSize, numSamples - offset));
+        }
+    }
+
+    profiler.endBlock();
+}
+
+void AudioEngine::renderBlock(const float* const* inputs, int numInputs,
+                              float* const* outputs, int numOutputs,
+                              int numSamples)
+{
+    using Stage = DspLoadProfiler::Stage;
+    auto stageStart = profiler.getStartTicks();
 
     // Clear output and send buffers
-    outputBuffer->clear(startSample, numSamples);
+    for (int ch = 0; ch < numOutputs; ++ch)
+    {
+        if (outputs[ch] != nullptr)
+            juce::FloatVectorOperations::clear(outputs[ch], numSamples);
+    }
+
+    // Master renders straight into the device outputs (scratch if the device has fewer than 2)
+    float* masterLeft = (numOutputs > 0 && outputs[0] != nullptr) ? outputs[0] : masterScratchBuffer.getWritePointer(0);
+    float* masterRight = (numOutputs > 1 && outputs[1] != nullptr) ? outputs[1] : masterScratchBuffer.getWritePointer(1);
+    if (masterLeft == masterScratchBuffer.getWritePointer(0) || masterRight == masterScratchBuffer.getWritePointer(1))
+        masterScratchBuffer.clear(0, numSamples);
+
     delaySendBuffer.clear();
     grainSendBuffer.clear();
     reverbSendBuffer.clear();
 
+    // Pick up the latest routing snapshot without locking; reporting its epoch lets the
+    // message thread free the snapshots (and removed objects) this block can no longer see
+    auto* topology = activeTopology.load(std::memory_order_acquire);
+    audioThreadEpoch.store(topology->epoch, std::memory_order_release);
+
     // Clear aux bus buffers
-    for (auto& auxBus : auxBuses)
+    for (auto* auxBus : topology->auxBuses)
     {
         auxBus->clearBuffer();
     }
 
-    // Process each channel (lock to prevent modification during iteration)
-    const juce::SpinLock::ScopedLockType lock(channelLock);
-    for (auto& channel : channels)
-    {
-        // Skip muted channels (unless solo is active and this channel is soloed)
-        if (soloActive && !channel->isSoloed())
-            continue;
+    profiler.addStageTime(Stage::Prepare, stageStart);
 
-        // Copy input audio to temp buffer based on channel's input settings
-        int inputStart = channel->getInputChannelStart();
-        bool stereo = channel->isStereo();
+    // Render the channel partitions, on this thread alone or shared with the render workers
+    stageStart = profiler.getStartTicks();
+    blockContext.topology = topology;
+    blockContext.inputs = inputs;
+    blockContext.numInputs = numInputs;
+    blockContext.numSamples = numSamples;
+    blockContext.anySoloed = soloActive.load(std::memory_order_relaxed);
 
-        tempBuffer.clear();
+    const int numPartitions = static_cast<int>(topology->partitionSums.size());
+    workerPool.run(numPartitions);
 
-        // Only process if input is selected (inputStart >= 0)
-        if (inputStart >= 0 && inputBuffer != nullptr && inputBuffer->getNumChannels() > 0)
-        {
-            // Copy from input buffer to temp buffer
-            if (inputStart < inputBuffer->getNumChannels())
-            {
-                // Left channel (or mono)
-                for (int i = 0; i < numSamples; ++i)
-                {
-                    tempBuffer.getWritePointer(0)[i] = inputBuffer->getReadPointer(inputStart)[i];
-                }
-
-                // Right channel (if stereo and available)
-                if (stereo && inputStart + 1 < inputBuffer->getNumChannels())
-                {
-                    for (int i = 0; i < numSamples; ++i)
-                    {
-                        tempBuffer.getWritePointer(1)[i] = inputBuffer->getReadPointer(inputStart + 1)[i];
-                    }
-                }
-                else
-                {
-                    // Mono: copy left to right
-                    for (int i = 0; i < numSamples; ++i)
-                    {
-                        tempBuffer.getWritePointer(1)[i] = tempBuffer.getReadPointer(0)[i];
-                    }
-                }
-            }
-        }
-        // If inputStart < 0, tempBuffer remains silent (cleared above)
-
-        // Process channel
-        float* channelOutL = tempBuffer.getWritePointer(0);
-        float* channelOutR = tempBuffer.getWritePointer(1);
-        float* delaySendL = delaySendBuffer.getWritePointer(0);
-        float* delaySendR = delaySendBuffer.getWritePointer(1);
-        float* grainSendL = grainSendBuffer.getWritePointer(0);
-        float* grainSendR = grainSendBuffer.getWritePointer(1);
-        float* reverbSendL = reverbSendBuffer.getWritePointer(0);
-        float* reverbSendR = reverbSendBuffer.getWritePointer(1);
-
-        // Clear pre-allocated per-channel send buffers (no allocation!)
-        channelDelaySendBuffer.clear(0, numSamples);
-        channelGrainSendBuffer.clear(0, numSamples);
-        channelReverbSendBuffer.clear(0, numSamples);
-
-        channel->process(tempBuffer.getReadPointer(0), tempBuffer.getReadPointer(1),
-                        channelOutL, channelOutR,
-                        channelDelaySendBuffer.getWritePointer(0), channelDelaySendBuffer.getWritePointer(1),
-                        channelGrainSendBuffer.getWritePointer(0), channelGrainSendBuffer.getWritePointer(1),
-                        channelReverbSendBuffer.getWritePointer(0), channelReverbSendBuffer.getWritePointer(1),
-                        numSamples);
+    profiler.addStageTime(Stage::ChannelRender, stageStart);
+    stageStart = profiler.getStartTicks();
 
-        // Sum to output
-        for (int i = 0; i < numSamples; ++i)
-        {
-            outputBuffer->getWritePointer(0)[startSample + i] += channelOutL[i];
-            outputBuffer->getWritePointer(1)[startSample + i] += channelOutR[i];
-        }
+    // Deterministic reduction: partials are summed in partition (= channel) order whichever
+    // thread rendered them, so serial and parallel rendering are bit-identical
+    for (const auto& sums : topology->partitionSums)
+    {
+        juce::FloatVectorOperations::add(masterLeft, sums.getReadPointer(partitionMasterLane), numSamples);
+        juce::FloatVectorOperations::add(masterRight, sums.getReadPointer(partitionMasterLane + 1), numSamples);
 
-        // Sum to send buffers (using pre-allocated buffers)
-        for (int i = 0; i < numSamples; ++i)
-        {
-            delaySendL[i] += channelDelaySendBuffer.getReadPointer(0)[i];
-            delaySendR[i] += channelDelaySendBuffer.getReadPointer(1)[i];
-            grainSendL[i] += channelGrainSendBuffer.getReadPointer(0)[i];
-            grainSendR[i] += channelGrainSendBuffer.getReadPointer(1)[i];
-            reverbSendL[i] += channelReverbSendBuffer.getReadPointer(0)[i];
-            reverbSendR[i] += channelReverbSendBuffer.getReadPointer(1)[i];
-        }
+        juce::FloatVectorOperations::add(delaySendBuffer.getWritePointer(0), sums.getReadPointer(partitionDelayLane), numSamples);
+        juce::FloatVectorOperations::add(delaySendBuffer.getWritePointer(1), sums.getReadPointer(partitionDelayLane + 1), numSamples);
+        juce::FloatVectorOperations::add(grainSendBuffer.getWritePointer(0), sums.getReadPointer(partitionGrainLane), numSamples);
+        juce::FloatVectorOperations::add(grainSendBuffer.getWritePointer(1), sums.getReadPointer(partitionGrainLane + 1), numSamples);
+        juce::FloatVectorOperations::add(reverbSendBuffer.getWritePointer(0), sums.getReadPointer(partitionReverbLane), numSamples);
+        juce::FloatVectorOperations::add(reverbSendBuffer.getWritePointer(1), sums.getReadPointer(partitionReverbLane + 1), numSamples);
 
-        // Send to aux buses (with panner modulation)
-        auto pannedLevels = channel->getPannedAuxSendLevels();
-        for (auto& auxBus : auxBuses)
+        for (size_t a = 0; a < topology->auxBuses.size(); ++a)
         {
-            int auxId = auxBus->getId();
-            auto it = pannedLevels.find(auxId);
-            if (it != pannedLevels.end() && it->second > 0.0f)
-            {
-                auxBus->addToBuffer(channelOutL, channelOutR, numSamples, it->second);
-            }
+            int lane = partitionAuxLane + 2 * static_cast<int>(a);
+            topology->auxBuses[a]->addToBuffer(sums.getReadPointer(lane), sums.getReadPointer(lane + 1), numSamples, 1.0f);
         }
     }
 
-    // Process send buses
-    delayBus.process(delaySendBuffer.getReadPointer(0), delaySendBuffer.getReadPointer(1),
-                     delayReturnBuffer.getWritePointer(0), delayReturnBuffer.getWritePointer(1),
-                     numSamples);
+    profiler.addStageTime(Stage::Reduce, stageStart);
 
-    grainBus.process(grainSendBuffer.getReadPointer(0), grainSendBuffer.getReadPointer(1),
-                     grainReturnBuffer.getWritePointer(0), grainReturnBuffer.getWritePointer(1),
-                     numSamples);
+    // Process send buses
+    {
+        DspLoadProfiler::ScopedStage stage(profiler, Stage::DelayBus);
+        delayBus.process(delaySendBuffer.getReadPointer(0), delaySendBuffer.getReadPointer(1),
+                         delayReturnBuffer.getWritePointer(0), delayReturnBuffer.getWritePointer(1),
+                         numSamples);
+    }
+    {
+        DspLoadProfiler::ScopedStage stage(profiler, Stage::GrainBus);
+        grainBus.process(grainSendBuffer.getReadPointer(0), grainSendBuffer.getReadPointer(1),
+                         grainReturnBuffer.getWritePointer(0), grainReturnBuffer.getWritePointer(1),
+                         numSamples);
+    }
+    {
+        DspLoadProfiler::ScopedStage stage(profiler, Stage::ReverbBus);
+        reverbBus.process(reverbSendBuffer.getReadPointer(0), reverbSendBuffer.getReadPointer(1),
+                          reverbReturnBuffer.getWritePointer(0), reverbReturnBuffer.getWritePointer(1),
+                          numSamples);
+    }
 
-    reverbBus.process(reverbSendBuffer.getReadPointer(0), reverbSendBuffer.getReadPointer(1),
-                      reverbReturnBuffer.getWritePointer(0), reverbReturnBuffer.getWritePointer(1),
-                      numSamples);
+    stageStart = profiler.getStartTicks();
 
     // Sum returns to output
     float maxLeft = 0.0f;
@@ -207,8 +248,8 @@ void AudioEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferTo
 
     for (int i = 0; i < numSamples; ++i)
     {
-        float left = outputBuffer->getReadPointer(0)[startSample + i];
-        float right = outputBuffer->getReadPointer(1)[startSample + i];
+        float left = masterLeft[i];
+        float right = masterRight[i];
 
         // Add effect returns
         left += delayReturnBuffer.getReadPointer(0)[i];
@@ -228,8 +269,8 @@ void AudioEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferTo
         left = std::tanh(left);
         right = std::tanh(right);
 
-        outputBuffer->getWritePointer(0)[startSample + i] = left;
-        outputBuffer->getWritePointer(1)[startSample + i] = right;
+        masterLeft[i] = left;
+        masterRight[i] = right;
 
         maxLeft = std::max(maxLeft, std::abs(left));
         maxRight = std::max(maxRight, std::abs(right));
@@ -238,43 +279,146 @@ void AudioEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferTo
     masterLevelLeft = maxLeft;
     masterLevelRight = maxRight;
 
+    // Aux buses on the main device come out their inserts' latency late (the limiter's
+    // lookahead); the master and buses with less latency are held back to the latest
+    int mainInsertLatency = 0;
+    for (auto* auxBus : topology->auxBuses)
+    {
+        const int outCh = auxBus->getOutputChannelStart();
+        if (outCh >= 0 && outCh < numOutputs && outputs[outCh] != nullptr)
+            mainInsertLatency = std::max(mainInsertLatency, auxBus->getInserts().getLatencySamples());
+    }
+
+    float* const master[] = { masterLeft, masterRight };
+    masterAlignment.process(master, 2, numSamples, mainInsertLatency);
+
+    profiler.addStageTime(Stage::Master, stageStart);
+    stageStart = profiler.getStartTicks();
+
     // Process aux buses and route to their output channels
-    for (auto& auxBus : auxBuses)
+    for (auto* auxBus : topology->auxBuses)
     {
         int outCh = auxBus->getOutputChannelStart();
         if (outCh < 0) continue;  // No output assigned
 
-        // Check if output channels are within buffer range
-        if (outCh >= outputBuffer->getNumChannels()) continue;
+        // Check if output channels are within the device's range
+        if (outCh >= numOutputs || outputs[outCh] == nullptr) continue;
 
         // Process aux bus to get output
         auxOutputBuffer.clear(0, numSamples);
         auxBus->process(auxOutputBuffer.getWritePointer(0),
                         auxOutputBuffer.getWritePointer(1),
                         numSamples);
+        auxBus->alignToMainOutputs(auxOutputBuffer.getWritePointer(0),
+                                   auxOutputBuffer.getWritePointer(1),
+                                   numSamples, mainInsertLatency);
+
+        // Route to output channels (for same-device output), mixing with existing content
+        juce::FloatVectorOperations::add(outputs[outCh], auxOutputBuffer.getReadPointer(0), numSamples);
+
+        if (auxBus->isStereo() && outCh + 1 < numOutputs && outputs[outCh + 1] != nullptr)
+            juce::FloatVectorOperations::add(outputs[outCh + 1], auxOutputBuffer.getReadPointer(1), numSamples);
+
+        // Send to RtAudio device (for multi-device output)
+        profiler.addStageTime(Stage::AuxBuses, stageStart);
+        stageStart = profiler.getStartTicks();
+
+        auxBus->sendToDevice(numSamples);
+
+        profiler.addStageTime(Stage::AuxDeviceWrites, stageStart);
+        stageStart = profiler.getStartTicks();
+    }
 
-        // Route to output channels (for same-device output)
-        bool stereo = auxBus->isStereo();
-        for (int i = 0; i < numSamples; ++i)
+    profiler.addStageTime(Stage::AuxBuses, stageStart);
+    stageStart = profiler.getStartTicks();
+
+    // Every bus on a device has mixed into that device's block: hand each block over once
+    rtAudioManager.commitBlocks();
+
+    profiler.addStageTime(Stage::AuxDeviceWrites, stageStart);
+    stageStart = profiler.getStartTicks();
+
+    // Hold the main outputs back until the aux devices catch up
+    latencyCompensator.process(outputs, numOutputs, numSamples);
+
+    profiler.addStageTime(Stage::Master, stageStart);
+}
+
+void AudioEngine::renderPartition(int partition)
+{
+    const auto& block = blockContext;
+    auto& topology = *block.topology;
+    auto& sums = topology.partitionSums[static_cast<size_t>(partition)];
+    const int numSamples = block.numSamples;
+
+    sums.clear(0, numSamples);
+
+    // Contiguous channel range, so each partial sums its channels in engine order
+    const int numChannels = static_cast<int>(topology.channels.size());
+    const int numPartitions = static_cast<int>(topology.partitionSums.size());
+    const int first = partition * numChannels / numPartitions;
+    const int last = (partition + 1) * numChannels / numPartitions;
+
+    const float* silence = silentInputBuffer.getReadPointer(0);
+    float* channelOutL = sums.getWritePointer(partitionChannelLane);
+    float* channelOutR = sums.getWritePointer(partitionChannelLane + 1);
+
+    for (int index = first; index < last; ++index)
+    {
+        auto* channel = topology.channels[static_cast<size_t>(index)];
+
+        // Skip muted channels (unless solo is active and this channel is soloed)
+        if (block.anySoloed && !channel->isSoloed())
+            continue;
+
+        auto channelStart = profiler.getStartTicks();
+
+        // Read the device input in place; mono aliases the same channel for L and R
+        int inputStart = channel->getInputChannelStart();
+        const float* inputLeft = silence;
+        const float* inputRight = silence;
+
+        if (inputStart >= 0 && inputStart < block.numInputs && block.inputs[inputStart] != nullptr)
         {
-            // Add to output (mix with existing content)
-            outputBuffer->getWritePointer(outCh)[startSample + i] += auxOutputBuffer.getReadPointer(0)[i];
+            inputLeft = block.inputs[inputStart];
+            inputRight = inputLeft;
 
-            if (stereo && outCh + 1 < outputBuffer->getNumChannels())
+            if (channel->isStereo() && inputStart + 1 < block.numInputs && block.inputs[inputStart + 1] != nullptr)
+                inputRight = block.inputs[inputStart + 1];
+        }
+        // If inputStart < 0, the channel reads silence
+
+        // Process channel; its sends are multiply-added straight into the partition's bus sums
+        channel->processAndAccumulate(inputLeft, inputRight,
+                                      channelOutL, channelOutR,
+                                      sums.getWritePointer(partitionDelayLane), sums.getWritePointer(partitionDelayLane + 1),
+                                      sums.getWritePointer(partitionGrainLane), sums.getWritePointer(partitionGrainLane + 1),
+                                      sums.getWritePointer(partitionReverbLane), sums.getWritePointer(partitionReverbLane + 1),
+                                      numSamples);
+
+        // Sum to the partition's master
+        juce::FloatVectorOperations::add(sums.getWritePointer(partitionMasterLane), channelOutL, numSamples);
+        juce::FloatVectorOperations::add(sums.getWritePointer(partitionMasterLane + 1), channelOutR, numSamples);
+
+        // Send to aux buses (with panner modulation); gains are indexed by aux ID
+        const float* auxGains = channel->getPannedAuxSendGains();
+        for (size_t a = 0; a < topology.auxBuses.size(); ++a)
+        {
+            float gain = auxGains[topology.auxBuses[a]->getId()];
+            if (gain > 0.0f)
             {
-                outputBuffer->getWritePointer(outCh + 1)[startSample + i] += auxOutputBuffer.getReadPointer(1)[i];
+                int lane = partitionAuxLane + 2 * static_cast<int>(a);
+                juce::FloatVectorOperations::addWithMultiply(sums.getWritePointer(lane), channelOutL, gain, numSamples);
+                juce::FloatVectorOperations::addWithMultiply(sums.getWritePointer(lane + 1), channelOutR, gain, numSamples);
             }
         }
 
-        // Send to RtAudio device (for multi-device output)
-        auxBus->sendToDevice(numSamples);
+        profiler.addChannelTime(channel->getId(), channelStart);
     }
 }
 
 int AudioEngine::addChannel()
 {
-    const juce::SpinLock::ScopedLockType lock(channelLock);
-
     if (channels.size() >= MAX_CHANNELS)
         return -1;
 
@@ -296,30 +440,33 @@ int AudioEngine::addChannel()
         id++;
     }
 
-    channels.push_back(std::make_unique<Channel>(id));
+    auto channel = std::make_unique<Channel>(id);
+    channel->prepare(currentSampleRate, currentBlockSize);
+    channels.push_back(std::move(channel));
+    publishTopology();
     return id;
 }
 
 void AudioEngine::removeChannel(int channelId)
 {
-    {
-        const juce::SpinLock::ScopedLockType lock(channelLock);
-
-        channels.erase(
-            std::remove_if(channels.begin(), channels.end(),
+    auto it = std::find_if(channels.begin(), channels.end(),
                            [channelId](const std::unique_ptr<Channel>& ch) {
                                return ch->getId() == channelId;
-                           }),
-            channels.end());
-    }
-    // Call after releasing lock to avoid deadlock
+                           });
+    if (it == channels.end())
+        return;
+
+    // The audio thread may still be processing the channel; it is freed once retired
+    std::vector<std::unique_ptr<Channel>> removed;
+    removed.push_back(std::move(*it));
+    channels.erase(it);
+
+    publishTopology(std::move(removed));
     updateSoloState();
 }
 
 Channel* AudioEngine::getChannel(int channelId)
 {
-    const juce::SpinLock::ScopedLockType lock(channelLock);
-
     for (auto& channel : channels)
     {
         if (channel->getId() == channelId)
@@ -334,50 +481,100 @@ void AudioEngine::setMasterVolume(float volume)
     smoothedMasterVolume.setTargetValue(masterVolume);
 }
 
-void AudioEngine::updateSoloState()
+void AudioEngine::setRenderWorkerCount(int numWorkers)
 {
-    const juce::SpinLock::ScopedLockType lock(channelLock);
+    workerPool.setNumWorkers(juce::jlimit(0, MAX_RENDER_WORKERS, numWorkers), currentBlockSize, currentSampleRate);
+}
+
+void AudioEngine::setMainOutputFormat(int numOutputChannels, int outputLatencyFrames)
+{
+    mainOutputChannels = juce::jlimit(0, MAX_IO_CHANNELS, numOutputChannels);
+    latencyCompensator.setMainOutputLatency(outputLatencyFrames);
+}
+
+void AudioEngine::updateLatencyCompensation()
+{
+    // One entry per device in use, however many aux buses share it
+    std::vector<std::pair<juce::String, int>> measured;
+    int mainInsertLatency = 0;
+
+    for (const auto& auxBus : auxBuses)
+    {
+        // The main outputs already carry the inserts' latency of the buses on them
+        const int outCh = auxBus->getOutputChannelStart();
+        if (outCh >= 0 && outCh < mainOutputChannels)
+            mainInsertLatency = std::max(mainInsertLatency, auxBus->getInserts().getLatencySamples());
 
-    soloActive = false;
+        const auto& deviceName = auxBus->getOutputDevice();
+        if (deviceName.isEmpty() || deviceName == "None")
+            continue;
+
+        auto alreadyListed = std::find_if(measured.begin(), measured.end(),
+                                          [&deviceName](const auto& entry) { return entry.first == deviceName; });
+        if (alreadyListed == measured.end())
+            measured.emplace_back(deviceName, auxBus->getDeviceLatencyFrames());
+    }
+
+    latencyCompensator.setMainInsertLatency(mainInsertLatency);
+    latencyCompensator.update(measured);
+}
+
+void AudioEngine::updateSoloState()
+{
+    bool anySoloed = false;
     for (const auto& channel : channels)
     {
         if (channel->isSoloed())
         {
-            soloActive = true;
+            anySoloed = true;
             break;
         }
     }
+    soloActive.store(anySoloed, std::memory_order_relaxed);
 }
 
 int AudioEngine::addAuxBus()
 {
-    int id = nextAuxId++;
+    // Reuse the lowest free ID so aux IDs can index the dense send rows directly
+    int id = 0;
+    while (id < AuxBus::MAX_AUX_BUSES && getAuxBus(id) != nullptr)
+        id++;
+
+    if (id >= AuxBus::MAX_AUX_BUSES)
+    {
+        DBG("AudioEngine: aux bus limit reached (" + juce::String(AuxBus::MAX_AUX_BUSES) + ")");
+        return -1;
+    }
+
     auto auxBus = std::make_unique<AuxBus>(id);
     auxBus->setRtAudioManager(&rtAudioManager);
     auxBus->prepareToPlay(currentBlockSize, currentSampleRate);
     auxBuses.push_back(std::move(auxBus));
+    publishTopology();
     return id;
 }
 
 void AudioEngine::removeAuxBus(int auxId)
 {
+    // Remove aux send from all channels
+    for (auto& channel : channels)
     {
-        const juce::SpinLock::ScopedLockType lock(channelLock);
-
-        // Remove aux send from all channels
-        for (auto& channel : channels)
-        {
-            channel->removeAuxSend(auxId);
-        }
+        channel->removeAuxSend(auxId);
     }
 
-    // Remove the aux bus
-    auxBuses.erase(
-        std::remove_if(auxBuses.begin(), auxBuses.end(),
-                       [auxId](const std::unique_ptr<AuxBus>& bus) {
-                           return bus->getId() == auxId;
-                       }),
-        auxBuses.end());
+    auto it = std::find_if(auxBuses.begin(), auxBuses.end(),
+                           [auxId](const std::unique_ptr<AuxBus>& bus) {
+                               return bus->getId() == auxId;
+                           });
+    if (it == auxBuses.end())
+        return;
+
+    // Unpublish the aux bus; its device stream is closed when the retired snapshot is freed
+    std::vector<std::unique_ptr<AuxBus>> removed;
+    removed.push_back(std::move(*it));
+    auxBuses.erase(it);
+
+    publishTopology({}, std::move(removed));
 }
 
 AuxBus* AudioEngine::getAuxBus(int auxId)
@@ -390,4 +587,53 @@ AuxBus* AudioEngine::getAuxBus(int auxId)
     return nullptr;
 }
 
+void AudioEngine::publishTopology(std::vector<std::unique_ptr<Channel>> removedChannels,
+                                  std::vector<std::unique_ptr<AuxBus>> removedAuxBuses)
+{
+    auto topology = std::make_unique<Topology>();
+    topology->epoch = ++lastPublishedEpoch;
+
+    topology->channels.reserve(channels.size());
+    for (auto& channel : channels)
+        topology->channels.push_back(channel.get());
+
+    topology->auxBuses.reserve(auxBuses.size());
+    for (auto& auxBus : auxBuses)
+        topology->auxBuses.push_back(auxBus.get());
+
+    // One set of partial sums per channel partition (master, sends and every aux)
+    int numPartitions = std::min(RENDER_PARTITIONS, static_cast<int>(channels.size()));
+    int numLanes = partitionAuxLane + 2 * static_cast<int>(auxBuses.size());
+
+    topology->partitionSums.resize(static_cast<size_t>(numPartitions));
+    for (auto& sums : topology->partitionSums)
+        sums.setSize(numLanes, currentBlockSize);
+
+    // Swap the snapshot in; the old one stays alive until the audio thread reports this epoch
+    RetiredTopology retired;
+    retired.epoch = topology->epoch;
+    retired.topology.reset(activeTopology.exchange(topology.release(), std::memory_order_acq_rel));
+    retired.channels = std::move(removedChannels);
+    retired.auxBuses = std::move(removedAuxBuses);
+
+    if (retired.topology != nullptr || !retired.channels.empty() || !retired.auxBuses.empty())
+        retiredTopologies.push_back(std::move(retired));
+
+    reclaimRetiredTopology();
+}
+
+void AudioEngine::reclaimRetiredTopology()
+{
+    // Once the audio thread has read a snapshot with epoch >= N, it can no longer hold
+    // anything retired when snapshot N was published
+    auto epochInUse = audioThreadEpoch.load(std::memory_order_acquire);
+
+    retiredTopologies.erase(
+        std::remove_if(retiredTopologies.begin(), retiredTopologies.end(),
+                       [epochInUse](const RetiredTopology& retired) {
+                           return retired.epoch <= epochInUse;
+                       }),
+        retiredTopologies.end());
+}
+
 } // namespace Kousaten
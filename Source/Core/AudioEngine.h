@@ -10,8 +10,13 @@
 #include "../Mixer/MixBus.h"
 #include "../Mixer/AuxBus.h"
 #include "RtAudioManager.h"
+#include "RenderWorkerPool.h"
+#include "RealtimeGuard.h"
+#include "DspLoadProfiler.h"
+#include "LatencyCompensator.h"
 #include <vector>
 #include <memory>
+#include <atomic>
 
 namespace Kousaten {
 
@@ -19,6 +24,13 @@ class AudioEngine : public juce::AudioSource
 {
 public:
     static constexpr int MAX_CHANNELS = 32;
+    // Enough for the master pair plus a pair per aux bus, so an offline render of every aux fits
+    static constexpr int MAX_IO_CHANNELS = 2 + 2 * AuxBus::MAX_AUX_BUSES;
+
+    // Channels are rendered in up to this many contiguous partitions, each into its own
+    // partial sums; partitions are the unit of work for the render workers
+    static constexpr int RENDER_PARTITIONS = 8;
+    static constexpr int MAX_RENDER_WORKERS = RENDER_PARTITIONS - 1;
 
     AudioEngine();
     ~AudioEngine() override;
@@ -28,7 +40,14 @@ public:
     void releaseResources() override;
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
 
-    // Channel management
+    // Render one block straight from device input pointers into device output pointers.
+    // Channels read their inputs in place (mono aliases one pointer for L/R), the master
+    // is written to outputs 0-1 and aux buses are added to their assigned outputs.
+    void processBlock(const float* const* inputs, int numInputs,
+                      float* const* outputs, int numOutputs,
+                      int numSamples);
+
+    // Channel management (message thread; the audio thread reads a published snapshot)
     int addChannel();
     void removeChannel(int channelId);
     Channel* getChannel(int channelId);
@@ -39,7 +58,7 @@ public:
     MixBus* getGrainBus() { return &grainBus; }
     MixBus* getReverbBus() { return &reverbBus; }
 
-    // Aux bus management
+    // Aux bus management (message thread). Returns -1 once AuxBus::MAX_AUX_BUSES exist.
     int addAuxBus();
     void removeAuxBus(int auxId);
     AuxBus* getAuxBus(int auxId);
@@ -64,21 +83,95 @@ public:
     // Solo handling
     void updateSoloState();
 
-    // Set input buffer for processing (called before getNextAudioBlock)
-    void setInputBuffer(const juce::AudioBuffer<float>* buffer) { inputBuffer = buffer; }
+    // Parallel rendering (opt-in): helper threads that render channel partitions alongside
+    // the audio thread. 0 (default) renders everything on the audio thread. Output is
+    // bit-identical for every worker count.
+    void setRenderWorkerCount(int numWorkers);
+    int getRenderWorkerCount() const { return workerPool.getNumWorkers(); }
+
+    // Per-stage timing of every callback (disabled by default). The audio thread only
+    // pushes records; call collect() on the profiler from the message thread to read them.
+    DspLoadProfiler& getProfiler() { return profiler; }
+
+    // Delay compensation for aux outputs on RtAudio devices: the main outputs are delayed
+    // to line up with the latest of them. Report the main device's format before
+    // prepareToPlay; call updateLatencyCompensation() regularly from the message thread
+    // to re-measure the devices in use. On the main device itself, the master and aux
+    // outputs are held back to the aux bus whose inserts add the most latency.
+    void setMainOutputFormat(int numOutputChannels, int outputLatencyFrames);
+    void updateLatencyCompensation();
+    LatencyCompensator& getLatencyCompensator() { return latencyCompensator; }
+
+    // Free channels, aux buses and routing snapshots the audio thread no longer uses.
+    // Message thread only; called after every topology edit and from the UI timer.
+    void reclaimRetiredTopology();
+
+    // Set input channels read by getNextAudioBlock (processBlock takes them directly)
+    void setInputChannels(const float* const* data, int numChannels)
+    {
+        inputChannels = data;
+        numInputChannels = data != nullptr ? numChannels : 0;
+    }
 
 private:
-    const juce::AudioBuffer<float>* inputBuffer = nullptr;
+    // Immutable routing snapshot read by the audio thread. The message thread owns the
+    // objects (channels/auxBuses below) and publishes a new snapshot after every edit.
+    struct Topology
+    {
+        juce::uint64 epoch = 0;
+        std::vector<Channel*> channels;
+        std::vector<AuxBus*> auxBuses;
+
+        // Per-partition partials, laid out as the partition*Lane constants below
+        std::vector<juce::AudioBuffer<float>> partitionSums;
+    };
+
+    static constexpr int partitionChannelLane = 0;  // Scratch output of the channel being processed
+    static constexpr int partitionMasterLane = 2;
+    static constexpr int partitionDelayLane = 4;
+    static constexpr int partitionGrainLane = 6;
+    static constexpr int partitionReverbLane = 8;
+    static constexpr int partitionAuxLane = 10;     // Two lanes per aux bus, in topology order
+
+    // What the partition tasks read for the block being rendered (written by the audio thread
+    // before the tasks are published)
+    struct BlockContext
+    {
+        Topology* topology = nullptr;
+        const float* const* inputs = nullptr;
+        int numInputs = 0;
+        int numSamples = 0;
+        bool anySoloed = false;
+    };
+
+    // A replaced snapshot plus the objects removed with it, freed once the audio
+    // thread has picked up a snapshot at least as new as `epoch`
+    struct RetiredTopology
+    {
+        juce::uint64 epoch = 0;
+        std::unique_ptr<Topology> topology;
+        std::vector<std::unique_ptr<Channel>> channels;
+        std::vector<std::unique_ptr<AuxBus>> auxBuses;
+    };
+
+    const float* const* inputChannels = nullptr;
+    int numInputChannels = 0;
+
+    // Owned by the message thread; never touched by the audio thread directly
     std::vector<std::unique_ptr<Channel>> channels;
-    juce::SpinLock channelLock;  // Protects channels vector access
 
     MixBus delayBus { BusType::Delay };
     MixBus grainBus { BusType::Grain };
     MixBus reverbBus { BusType::Reverb };
 
-    // Dynamic aux buses
+    // Dynamic aux buses (owned by the message thread)
     std::vector<std::unique_ptr<AuxBus>> auxBuses;
-    int nextAuxId = 0;
+
+    // Routing snapshot published to the audio thread with a pointer swap
+    std::atomic<Topology*> activeTopology { nullptr };
+    std::atomic<juce::uint64> audioThreadEpoch { 0 };  // Epoch of the snapshot last picked up by the audio thread
+    juce::uint64 lastPublishedEpoch = 0;
+    std::vector<RetiredTopology> retiredTopologies;
 
     // RtAudio manager for multi-device output
     RtAudioManager rtAudioManager;
@@ -90,13 +183,20 @@ private:
     juce::String masterOutputDevice;
     int masterOutputChannelStart = 0;
 
-    bool soloActive = false;
+    std::atomic<bool> soloActive { false };
+
+    LatencyCompensator latencyCompensator;
+    int mainOutputChannels = 2;
+
+    // Holds the master back by the latency of the aux inserts on the main device's outputs
+    CompensationDelay masterAlignment;
 
     double currentSampleRate = 48000.0;
     int currentBlockSize = 512;
 
     // Temporary buffers for processing
-    juce::AudioBuffer<float> tempBuffer;
+    juce::AudioBuffer<float> masterScratchBuffer;  // Master target when the device has < 2 outputs
+    juce::AudioBuffer<float> silentInputBuffer;    // Read by channels without an input
     juce::AudioBuffer<float> delaySendBuffer;
     juce::AudioBuffer<float> grainSendBuffer;
     juce::AudioBuffer<float> reverbSendBuffer;
@@ -104,16 +204,30 @@ private:
     juce::AudioBuffer<float> grainReturnBuffer;
     juce::AudioBuffer<float> reverbReturnBuffer;
 
-    // Per-channel send buffers (pre-allocated to avoid allocation in audio callback)
-    juce::AudioBuffer<float> channelDelaySendBuffer;
-    juce::AudioBuffer<float> channelGrainSendBuffer;
-    juce::AudioBuffer<float> channelReverbSendBuffer;
-
     // Aux bus output buffer (pre-allocated)
     juce::AudioBuffer<float> auxOutputBuffer;
 
     juce::SmoothedValue<float> smoothedMasterVolume;
 
+    void renderBlock(const float* const* inputs, int numInputs,
+                     float* const* outputs, int numOutputs,
+                     int numSamples);
+
+    // Render one channel partition of the current block into its partial sums
+    void renderPartition(int partition);
+
+    // Publish a snapshot of channels/auxBuses and retire the previous one together
+    // with any objects that were removed by this edit
+    void publishTopology(std::vector<std::unique_ptr<Channel>> removedChannels = {},
+                         std::vector<std::unique_ptr<AuxBus>> removedAuxBuses = {});
+
+    BlockContext blockContext;
+
+    DspLoadProfiler profiler;
+
+    // Declared last so its threads stop before anything they render is destroyed
+    RenderWorkerPool workerPool;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioEngine)
 };
 
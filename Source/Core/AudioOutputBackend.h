@@ -0,0 +1,52 @@
+/*
+    Kousaten Mixer - Audio Output Backend
+    The device API behind RtAudioManager: RtAudio for real devices, or virtual devices
+    for headless testing
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "DeviceEnumerator.h"
+#include <memory>
+
+namespace Kousaten {
+
+class AudioOutputBackend
+{
+public:
+    // Called on the device's thread for every buffer: fill numFrames interleaved frames
+    using RenderCallback = void (*)(float* output, unsigned int numFrames, void* userData);
+
+    // One open output stream; closed when destroyed
+    class Stream
+    {
+    public:
+        virtual ~Stream() = default;
+
+        virtual bool start() = 0;
+        virtual void stop() = 0;
+
+        // The device's own output latency in frames (0 if it reports none)
+        virtual long getLatencyFrames() const = 0;
+    };
+
+    virtual ~AudioOutputBackend() = default;
+
+    // Lists this backend's devices for the manager's DeviceEnumerator
+    virtual std::unique_ptr<DeviceEnumerationBackend> createEnumerationBackend() = 0;
+
+    // Where the device list is cached between launches (none for devices that only
+    // exist while the process runs)
+    virtual juce::File getCacheFile() const { return {}; }
+
+    // Control thread: open numChannels outputs of a device, given its name and the runtime
+    // id the enumerator last saw for it. Backends whose ids can change between instances
+    // look the device up by name. nullptr if the device can't be opened.
+    virtual std::unique_ptr<Stream> openStream(const juce::String& deviceName, unsigned int deviceId,
+                                               unsigned int numChannels,
+                                               unsigned int sampleRate, unsigned int bufferSize,
+                                               RenderCallback callback, void* userData) = 0;
+};
+
+} // namespace Kousaten
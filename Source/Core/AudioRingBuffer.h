@@ -0,0 +1,115 @@
+/*
+    Kousaten Mixer - Audio Ring Buffer
+    Single-producer/single-consumer float FIFO with power-of-two capacity,
+    two-segment bulk copies and overrun/underrun accounting
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace Kousaten {
+
+class AudioRingBuffer
+{
+public:
+    // Control thread: allocate at least minCapacity samples (rounded up to a power of two)
+    void setSize(size_t minCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity)
+            capacity <<= 1;
+
+        buffer.assign(capacity, 0.0f);
+        mask = capacity - 1;
+        reset();
+    }
+
+    // Not thread-safe: only while neither side is running
+    void reset()
+    {
+        writePos.store(0, std::memory_order_relaxed);
+        readPos.store(0, std::memory_order_relaxed);
+        overruns.store(0, std::memory_order_relaxed);
+        underruns.store(0, std::memory_order_relaxed);
+        starved = true;  // Nothing has flowed yet, so the first short read is not a dropout
+    }
+
+    size_t getCapacity() const { return buffer.size(); }
+
+    // Samples written but not yet read (approximate from any thread other than the two sides)
+    size_t getNumReady() const
+    {
+        return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire);
+    }
+
+    // Producer: append numSamples, or drop all of them (counting an overrun) if they don't fit
+    bool write(const float* data, size_t numSamples)
+    {
+        const size_t wp = writePos.load(std::memory_order_relaxed);
+        const size_t rp = readPos.load(std::memory_order_acquire);
+
+        if (numSamples > buffer.size() - (wp - rp))
+        {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        const size_t start = wp & mask;
+        const size_t first = std::min(numSamples, buffer.size() - start);
+        std::memcpy(buffer.data() + start, data, first * sizeof(float));
+        std::memcpy(buffer.data(), data + first, (numSamples - first) * sizeof(float));
+
+        writePos.store(wp + numSamples, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: fill dest with numSamples; whatever is missing is zeroed. One underrun is
+    // counted per dropout, not per starved read.
+    bool read(float* dest, size_t numSamples)
+    {
+        const size_t rp = readPos.load(std::memory_order_relaxed);
+        const size_t wp = writePos.load(std::memory_order_acquire);
+        const size_t available = std::min(numSamples, wp - rp);
+
+        const size_t start = rp & mask;
+        const size_t first = std::min(available, buffer.size() - start);
+        std::memcpy(dest, buffer.data() + start, first * sizeof(float));
+        std::memcpy(dest + first, buffer.data(), (available - first) * sizeof(float));
+
+        readPos.store(rp + available, std::memory_order_release);
+
+        if (available < numSamples)
+        {
+            std::memset(dest + available, 0, (numSamples - available) * sizeof(float));
+            if (!starved)
+                underruns.fetch_add(1, std::memory_order_relaxed);
+            starved = true;
+            return false;
+        }
+
+        starved = false;
+        return true;
+    }
+
+    int getNumOverruns() const { return overruns.load(std::memory_order_relaxed); }
+    int getNumUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<float> buffer;
+    size_t mask = 0;
+
+    // Free-running sample counters; positions are (counter & mask)
+    alignas(64) std::atomic<size_t> writePos { 0 };
+    alignas(64) std::atomic<size_t> readPos { 0 };
+
+    std::atomic<int> overruns { 0 };
+    std::atomic<int> underruns { 0 };
+    bool starved = true;  // Consumer only
+};
+
+} // namespace Kousaten
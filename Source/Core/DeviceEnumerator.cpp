@@ -0,0 +1,345 @@
+/*
+    Kousaten Mixer - Device Enumerator
+    Implementation
+*/
+
+#include "DeviceEnumerator.h"
+#include <algorithm>
+
+namespace Kousaten {
+
+namespace {
+
+constexpr int cacheFormatVersion = 1;
+
+juce::var toVar(const juce::StringArray& strings)
+{
+    juce::Array<juce::var> array;
+    for (const auto& s : strings)
+        array.add(s);
+    return array;
+}
+
+juce::StringArray stringsFromVar(const juce::var& value)
+{
+    juce::StringArray strings;
+    if (auto* array = value.getArray())
+    {
+        for (const auto& item : *array)
+            strings.add(item.toString());
+    }
+    return strings;
+}
+
+} // namespace
+
+class DeviceEnumerator::ScanThread : public juce::Thread
+{
+public:
+    ScanThread(DeviceEnumerator& ownerEnumerator, int intervalMs)
+        : juce::Thread("Kousaten Device Scan")
+        , owner(ownerEnumerator)
+        , rescanIntervalMs(intervalMs)
+    {
+    }
+
+    ~ScanThread() override
+    {
+        // A probe in progress can't be interrupted; let it finish
+        signalThreadShouldExit();
+        notify();
+        stopThread(-1);
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            owner.scanNow();
+
+            // notify() (requestScan or stopping) cuts the wait short
+            wait(rescanIntervalMs > 0 ? rescanIntervalMs : -1);
+        }
+    }
+
+private:
+    DeviceEnumerator& owner;
+    int rescanIntervalMs;
+};
+
+DeviceEnumerator::DeviceEnumerator(std::unique_ptr<DeviceEnumerationBackend> enumerationBackend,
+                                   const juce::File& file)
+    : backend(std::move(enumerationBackend))
+    , cacheFile(file)
+{
+}
+
+DeviceEnumerator::~DeviceEnumerator()
+{
+    stop();
+    cancelPendingUpdate();
+}
+
+juce::File DeviceEnumerator::getDefaultCacheDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("Kousaten Mixer");
+}
+
+void DeviceEnumerator::start(int rescanIntervalMs)
+{
+    stop();
+    loadCache();
+
+    scanThread = std::make_unique<ScanThread>(*this, rescanIntervalMs);
+    scanThread->startThread(juce::Thread::Priority::background);
+}
+
+void DeviceEnumerator::stop()
+{
+    scanThread.reset();
+}
+
+void DeviceEnumerator::requestScan()
+{
+    if (scanThread != nullptr)
+        scanThread->notify();
+}
+
+DeviceEnumerator::Changes DeviceEnumerator::scanNow()
+{
+    std::lock_guard<std::mutex> scanLock(scanMutex);
+
+    auto listed = backend->listDevices();
+
+    // Reuse what this session has already probed; everything else is probed below,
+    // without holding the list lock
+    std::vector<bool> needsProbe(listed.size(), true);
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+
+        for (size_t i = 0; i < listed.size(); ++i)
+        {
+            const auto key = listed[i].getKey();
+            auto it = std::find_if(entries.begin(), entries.end(),
+                                   [&key](const Entry& e) { return e.device.getKey() == key; });
+
+            if (it != entries.end() && it->verified)
+            {
+                const auto runtimeId = listed[i].runtimeId;
+                listed[i] = it->device;
+                listed[i].runtimeId = runtimeId;
+                needsProbe[i] = false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < listed.size(); ++i)
+    {
+        if (needsProbe[i])
+        {
+            // A device that can't be queried stays listed without channels, and isn't
+            // probed again every scan
+            if (!backend->probeDevice(listed[i]))
+                DBG("DeviceEnumerator: Could not query " + listed[i].getKey());
+
+            numProbes.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // A backend may give up part way when the scan thread is stopped; what it returned
+    // then isn't the device list
+    if (juce::Thread::currentThreadShouldExit())
+        return {};
+
+    Changes changes;
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+
+        std::vector<bool> stillPresent(entries.size(), false);
+
+        for (const auto& device : listed)
+        {
+            const auto key = device.getKey();
+            auto it = std::find_if(entries.begin(), entries.end(),
+                                   [&key](const Entry& e) { return e.device.getKey() == key; });
+
+            if (it == entries.end())
+            {
+                entries.push_back({ device, true, true });
+                stillPresent.push_back(true);
+                changes.added.push_back(device);
+                continue;
+            }
+
+            const bool changed = !it->present
+                              || it->device.runtimeId != device.runtimeId
+                              || !it->device.sameCapabilities(device);
+
+            it->device = device;
+            it->present = true;
+            it->verified = true;
+            stillPresent[static_cast<size_t>(it - entries.begin())] = true;
+
+            if (changed)
+                changes.added.push_back(device);
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (entries[i].present && !stillPresent[i])
+            {
+                entries[i].present = false;
+                changes.removed.add(entries[i].device.getKey());
+            }
+        }
+
+        // Fold into what the message thread hasn't picked up yet: removals first, then
+        // additions, so a device that came back in between ends up present
+        for (const auto& key : changes.removed)
+        {
+            auto& added = pendingChanges.added;
+            added.erase(std::remove_if(added.begin(), added.end(),
+                                       [&key](const EnumeratedDevice& d) { return d.getKey() == key; }),
+                        added.end());
+            pendingChanges.removed.addIfNotAlreadyThere(key);
+        }
+
+        for (const auto& device : changes.added)
+        {
+            const auto key = device.getKey();
+            auto& added = pendingChanges.added;
+            added.erase(std::remove_if(added.begin(), added.end(),
+                                       [&key](const EnumeratedDevice& d) { return d.getKey() == key; }),
+                        added.end());
+            added.push_back(device);
+        }
+    }
+
+    scanCompleted.store(true, std::memory_order_release);
+
+    if (!changes.isEmpty())
+    {
+        version.fetch_add(1, std::memory_order_acq_rel);
+        saveCache();
+        triggerAsyncUpdate();
+    }
+
+    return changes;
+}
+
+std::vector<EnumeratedDevice> DeviceEnumerator::getDevices() const
+{
+    std::lock_guard<std::mutex> lock(entriesMutex);
+
+    std::vector<EnumeratedDevice> devices;
+    for (const auto& entry : entries)
+    {
+        if (entry.present)
+            devices.push_back(entry.device);
+    }
+
+    return devices;
+}
+
+void DeviceEnumerator::handleAsyncUpdate()
+{
+    Changes changes;
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        std::swap(changes, pendingChanges);
+    }
+
+    if (onDevicesChanged != nullptr && !changes.isEmpty())
+        onDevicesChanged(changes);
+}
+
+void DeviceEnumerator::loadCache()
+{
+    if (!cacheFile.existsAsFile())
+        return;
+
+    const auto root = juce::JSON::parse(cacheFile.loadFileAsString());
+    if (static_cast<int>(root["version"]) != cacheFormatVersion)
+        return;
+
+    std::vector<Entry> cached;
+    if (auto* devices = root["devices"].getArray())
+    {
+        for (const auto& item : *devices)
+        {
+            Entry entry;
+            entry.device.typeName = item["type"].toString();
+            entry.device.name = item["name"].toString();
+            entry.device.isInput = static_cast<bool>(item["input"]);
+            entry.device.inputChannelNames = stringsFromVar(item["inputs"]);
+            entry.device.outputChannelNames = stringsFromVar(item["outputs"]);
+            entry.device.isDefaultOutput = static_cast<bool>(item["default"]);
+
+            if (auto* rates = item["rates"].getArray())
+            {
+                for (const auto& rate : *rates)
+                    entry.device.sampleRates.add(static_cast<double>(rate));
+            }
+
+            // Served until the first scan confirms (or drops) it
+            entry.present = static_cast<bool>(item["present"]);
+            entry.verified = false;
+
+            if (entry.device.name.isNotEmpty())
+                cached.push_back(std::move(entry));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        entries = std::move(cached);
+        scanCompleted.store(false, std::memory_order_release);
+    }
+
+    version.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void DeviceEnumerator::saveCache() const
+{
+    if (cacheFile == juce::File())
+        return;
+
+    juce::Array<juce::var> devices;
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+
+        for (const auto& entry : entries)
+        {
+            if (!entry.verified)
+                continue;
+
+            const auto& device = entry.device;
+            auto* item = new juce::DynamicObject();
+            item->setProperty("type", device.typeName);
+            item->setProperty("name", device.name);
+            item->setProperty("input", device.isInput);
+            item->setProperty("inputs", toVar(device.inputChannelNames));
+            item->setProperty("outputs", toVar(device.outputChannelNames));
+            item->setProperty("default", device.isDefaultOutput);
+            item->setProperty("present", entry.present);
+
+            juce::Array<juce::var> rates;
+            for (auto rate : device.sampleRates)
+                rates.add(rate);
+            item->setProperty("rates", rates);
+
+            devices.add(juce::var(item));
+        }
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("version", cacheFormatVersion);
+    root->setProperty("devices", devices);
+
+    cacheFile.getParentDirectory().createDirectory();
+    if (!cacheFile.replaceWithText(juce::JSON::toString(juce::var(root))))
+        DBG("DeviceEnumerator: Could not write " + cacheFile.getFullPathName());
+}
+
+} // namespace Kousaten
@@ -0,0 +1,143 @@
+/*
+    Kousaten Mixer - Device Enumerator
+    Background device enumeration with an on-disk cache and incremental hot-plug diffs
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Kousaten {
+
+// One device as seen by an enumeration backend
+struct EnumeratedDevice
+{
+    juce::String typeName;             // Driver type, e.g. "CoreAudio" or "RtAudio/ALSA"
+    juce::String name;
+    bool isInput = false;              // JUCE lists inputs and outputs separately
+    juce::StringArray inputChannelNames;
+    juce::StringArray outputChannelNames;
+    juce::Array<double> sampleRates;
+    bool isDefaultOutput = false;
+    unsigned int runtimeId = 0;        // Backend's id for this session; 0 until listed (not cached)
+
+    // Cache identity: the same device keeps its key across launches
+    juce::String getKey() const { return typeName + (isInput ? "/in/" : "/out/") + name; }
+
+    bool sameCapabilities(const EnumeratedDevice& other) const
+    {
+        return inputChannelNames == other.inputChannelNames
+            && outputChannelNames == other.outputChannelNames
+            && sampleRates == other.sampleRates
+            && isDefaultOutput == other.isDefaultOutput;
+    }
+};
+
+// The device API behind an enumerator. Only ever called from one thread at a time. A call
+// made on the scan thread may return early once that thread is asked to exit; the scan's
+// result is then discarded.
+class DeviceEnumerationBackend
+{
+public:
+    virtual ~DeviceEnumerationBackend() = default;
+
+    // Cheap: the devices present right now (type, name, direction and runtime id only)
+    virtual std::vector<EnumeratedDevice> listDevices() = 0;
+
+    // Expensive: fill in channels and sample rates of a listed device; false if it
+    // can't be queried
+    virtual bool probeDevice(EnumeratedDevice& device) = 0;
+};
+
+// Keeps a device list current without blocking the message thread. start() serves the
+// list from the cache file straight away; a background thread then lists the devices
+// every few seconds (or whenever requestScan() is called) and probes only those it has
+// not seen before (plus, once, every device served from the cache). Differences are
+// handed to onDevicesChanged on the message thread and written back to the cache.
+class DeviceEnumerator : private juce::AsyncUpdater
+{
+public:
+    struct Changes
+    {
+        std::vector<EnumeratedDevice> added;    // Newly present (or changed) devices
+        juce::StringArray removed;              // Keys of devices no longer present
+
+        bool isEmpty() const { return added.empty() && removed.isEmpty(); }
+    };
+
+    DeviceEnumerator(std::unique_ptr<DeviceEnumerationBackend> backend, const juce::File& cacheFile);
+    ~DeviceEnumerator() override;
+
+    // Message thread: load the cache and start scanning (first scan right away). Pass
+    // rescanIntervalMs <= 0 to scan again only when requestScan() is called.
+    void start(int rescanIntervalMs = 3000);
+    void stop();
+
+    // Message thread: have the scan thread scan again as soon as it is free, without
+    // waiting for it (e.g. when a driver reports that its devices changed)
+    void requestScan();
+
+    // Run one scan now (waits for a scan already in progress) and return its differences.
+    // onDevicesChanged still receives them. Not on the message thread if the backend calls
+    // into it, since the scan thread may be waiting for the message thread while it holds
+    // the scan.
+    Changes scanNow();
+
+    // Any thread: the current list and a counter that moves whenever it changes
+    std::vector<EnumeratedDevice> getDevices() const;
+    int getVersion() const { return version.load(std::memory_order_acquire); }
+
+    // True once every listed device has been verified by a scan
+    bool hasCompletedScan() const { return scanCompleted.load(std::memory_order_acquire); }
+
+    // Probes run so far (the expensive calls a cache avoids)
+    int getNumProbes() const { return numProbes.load(std::memory_order_relaxed); }
+
+    // Message thread: called with each scan's differences
+    std::function<void(const Changes&)> onDevicesChanged;
+
+    // Default location of the cache files
+    static juce::File getDefaultCacheDirectory();
+
+private:
+    class ScanThread;
+
+    struct Entry
+    {
+        EnumeratedDevice device;
+        bool present = false;   // Listed by the last scan (or served from the cache before one)
+        bool verified = false;  // Probed during this session
+    };
+
+    std::unique_ptr<DeviceEnumerationBackend> backend;
+    juce::File cacheFile;
+
+    // Every device known to this session or the cache, present or not, so a device that
+    // is unplugged and plugged back in isn't probed again
+    std::vector<Entry> entries;
+    mutable std::mutex entriesMutex;
+
+    std::mutex scanMutex;  // One scan (and one backend call) at a time
+
+    std::atomic<int> version { 0 };
+    std::atomic<bool> scanCompleted { false };
+    std::atomic<int> numProbes { 0 };
+
+    Changes pendingChanges;  // Guarded by entriesMutex until handed to the message thread
+
+    std::unique_ptr<ScanThread> scanThread;
+
+    void loadCache();
+    void saveCache() const;
+
+    void handleAsyncUpdate() override;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeviceEnumerator)
+};
+
+} // namespace Kousaten
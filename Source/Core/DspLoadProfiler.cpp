@@ -0,0 +1,212 @@
+/*
+    Kousaten Mixer - DSP Load Profiler
+    Implementation
+*/
+
+#include "DspLoadProfiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Kousaten {
+
+DspLoadProfiler::DspLoadProfiler()
+    : microsPerTick(1.0e6 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond()))
+    , fifoRecords(static_cast<size_t>(FIFO_BLOCKS))
+    , history(static_cast<size_t>(numSeries * HISTORY_BLOCKS), 0.0f)
+{
+}
+
+const char* DspLoadProfiler::getStageName(int stage)
+{
+    switch (stage)
+    {
+        case Prepare:         return "Prepare";
+        case ChannelRender:   return "Channels";
+        case Reduce:          return "Reduce";
+        case DelayBus:        return "Delay bus";
+        case GrainBus:        return "Grain bus";
+        case ReverbBus:       return "Reverb bus";
+        case Master:          return "Master";
+        case AuxBuses:        return "Aux buses";
+        case AuxDeviceWrites: return "Aux device writes";
+        case Total:           return "Total";
+        default:              return "?";
+    }
+}
+
+void DspLoadProfiler::beginBlock(int numSamples, double sampleRate)
+{
+    active = enabled.load(std::memory_order_relaxed) && sampleRate > 0.0;
+    if (!active)
+        return;
+
+    current.deadlineMicros = static_cast<float>(numSamples * 1.0e6 / sampleRate);
+    current.stageMicros.fill(0.0f);
+    current.channelMicros.fill(-1.0f);
+    blockStartTicks = now();
+}
+
+void DspLoadProfiler::endBlock()
+{
+    if (!active)
+        return;
+
+    addStageTime(Total, blockStartTicks);
+    active = false;
+
+    // Never wait for the reader: a full FIFO drops the record
+    const auto scope = fifo.write(1);
+    if (scope.blockSize1 > 0)
+        fifoRecords[static_cast<size_t>(scope.startIndex1)] = current;
+    else if (scope.blockSize2 > 0)
+        fifoRecords[static_cast<size_t>(scope.startIndex2)] = current;
+    else
+        numDroppedBlocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DspLoadProfiler::addStageTime(Stage stage, juce::int64 startTicks)
+{
+    if (!active)
+        return;
+
+    current.stageMicros[static_cast<size_t>(stage)] += static_cast<float>((now() - startTicks) * microsPerTick);
+}
+
+void DspLoadProfiler::addChannelTime(int channelId, juce::int64 startTicks)
+{
+    if (!active || !juce::isPositiveAndBelow(channelId, MAX_CHANNEL_SLOTS))
+        return;
+
+    // Oversized callbacks render in chunks, so a channel can be timed more than once per record
+    auto& slot = current.channelMicros[static_cast<size_t>(channelId)];
+    slot = std::max(slot, 0.0f) + static_cast<float>((now() - startTicks) * microsPerTick);
+}
+
+void DspLoadProfiler::collect()
+{
+    for (;;)
+    {
+        const auto scope = fifo.read(1);
+        int index = scope.blockSize1 > 0 ? scope.startIndex1
+                  : scope.blockSize2 > 0 ? scope.startIndex2
+                  : -1;
+        if (index < 0)
+            break;
+
+        const auto& record = fifoRecords[static_cast<size_t>(index)];
+        float* column = history.data() + historyWritePos;
+
+        for (int s = 0; s < NUM_STAGES; ++s)
+            column[s * HISTORY_BLOCKS] = record.stageMicros[static_cast<size_t>(s)];
+        for (int c = 0; c < MAX_CHANNEL_SLOTS; ++c)
+            column[(NUM_STAGES + c) * HISTORY_BLOCKS] = record.channelMicros[static_cast<size_t>(c)];
+
+        float loadPercent = record.deadlineMicros > 0.0f
+                          ? 100.0f * record.stageMicros[Total] / record.deadlineMicros
+                          : 0.0f;
+        column[loadSeries * HISTORY_BLOCKS] = loadPercent;
+
+        if (loadPercent > 100.0f)
+            ++numOverruns;
+
+        historyWritePos = (historyWritePos + 1) % HISTORY_BLOCKS;
+        historySize = std::min(historySize + 1, HISTORY_BLOCKS);
+    }
+}
+
+DspLoadProfiler::Stats DspLoadProfiler::computeStats(int series) const
+{
+    Stats stats;
+
+    std::vector<float> values;
+    values.reserve(static_cast<size_t>(historySize));
+
+    const float* row = history.data() + series * HISTORY_BLOCKS;
+    for (int i = 0; i < historySize; ++i)
+    {
+        if (row[i] >= 0.0f)  // Skip blocks where a channel did not exist
+            values.push_back(row[i]);
+    }
+
+    if (values.empty())
+        return stats;
+
+    stats.numBlocks = static_cast<int>(values.size());
+
+    double sum = 0.0;
+    stats.minimum = values.front();
+    stats.maximum = values.front();
+    for (float v : values)
+    {
+        sum += v;
+        stats.minimum = std::min(stats.minimum, v);
+        stats.maximum = std::max(stats.maximum, v);
+    }
+    stats.average = static_cast<float>(sum / static_cast<double>(values.size()));
+
+    auto percentile = values.begin() + static_cast<std::ptrdiff_t>(std::ceil(0.99 * static_cast<double>(values.size())) - 1);
+    std::nth_element(values.begin(), percentile, values.end());
+    stats.p99 = *percentile;
+
+    return stats;
+}
+
+DspLoadProfiler::Stats DspLoadProfiler::getStageStats(Stage stage) const
+{
+    return computeStats(static_cast<int>(stage));
+}
+
+DspLoadProfiler::Stats DspLoadProfiler::getChannelStats(int channelId) const
+{
+    if (!juce::isPositiveAndBelow(channelId, MAX_CHANNEL_SLOTS))
+        return {};
+    return computeStats(NUM_STAGES + channelId);
+}
+
+DspLoadProfiler::Stats DspLoadProfiler::getLoadStats() const
+{
+    return computeStats(loadSeries);
+}
+
+juce::String DspLoadProfiler::createReport() const
+{
+    auto formatRow = [](const juce::String& name, const Stats& stats) {
+        return name.paddedRight(' ', 20)
+             + juce::String(stats.minimum, 1).paddedLeft(' ', 9)
+             + juce::String(stats.average, 1).paddedLeft(' ', 9)
+             + juce::String(stats.p99, 1).paddedLeft(' ', 9)
+             + juce::String(stats.maximum, 1).paddedLeft(' ', 9) + "\n";
+    };
+
+    auto load = getLoadStats();
+
+    juce::String report;
+    report << "DSP load over " << load.numBlocks << " blocks: avg " << juce::String(load.average, 1)
+           << "%, p99 " << juce::String(load.p99, 1) << "%, max " << juce::String(load.maximum, 1)
+           << "% (" << numOverruns << " overruns, " << getNumDroppedBlocks() << " dropped)\n";
+    report << juce::String("stage (us)").paddedRight(' ', 20)
+           << "      min      avg      p99      max\n";
+
+    for (int s = 0; s < NUM_STAGES; ++s)
+        report << formatRow(getStageName(s), getStageStats(static_cast<Stage>(s)));
+
+    for (int c = 0; c < MAX_CHANNEL_SLOTS; ++c)
+    {
+        auto stats = getChannelStats(c);
+        if (stats.numBlocks > 0)
+            report << formatRow("  Channel " + juce::String(c + 1), stats);
+    }
+
+    return report;
+}
+
+void DspLoadProfiler::reset()
+{
+    collect();
+    historyWritePos = 0;
+    historySize = 0;
+    numOverruns = 0;
+    numDroppedBlocks.store(0, std::memory_order_relaxed);
+}
+
+} // namespace Kousaten
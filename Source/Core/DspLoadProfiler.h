@@ -0,0 +1,148 @@
+/*
+    Kousaten Mixer - DSP Load Profiler
+    Per-block stage timings, passed from the audio thread to the message thread
+    through a lock-free single-producer/single-consumer FIFO
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace Kousaten {
+
+class DspLoadProfiler
+{
+public:
+    enum Stage
+    {
+        Prepare = 0,        // Output/send clears and snapshot pickup
+        ChannelRender,      // Wall time of all channel partitions (see per-channel stats)
+        Reduce,             // Summing the partition partials
+        DelayBus,
+        GrainBus,
+        ReverbBus,
+        Master,             // Returns, master volume and tanh
+        AuxBuses,           // Aux processing and same-device routing
+        AuxDeviceWrites,    // Pushing aux blocks to the RtAudio streams
+        Total,              // Whole callback
+        NUM_STAGES
+    };
+
+    static constexpr int MAX_CHANNEL_SLOTS = 32;  // Indexed by channel ID
+    static constexpr int FIFO_BLOCKS = 256;       // Records in flight before the audio thread drops them
+    static constexpr int HISTORY_BLOCKS = 512;    // Window the statistics are computed over
+
+    // Microseconds for stages and channels, percent of the deadline for the load
+    struct Stats
+    {
+        int numBlocks = 0;
+        float minimum = 0.0f;
+        float average = 0.0f;
+        float maximum = 0.0f;
+        float p99 = 0.0f;
+    };
+
+    DspLoadProfiler();
+
+    static const char* getStageName(int stage);
+
+    // Off by default: when disabled the audio thread reads no clocks
+    void setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // ---- Audio thread (and render workers inside ChannelRender) ----
+
+    // Start a record for a callback of numSamples; stage times accumulate until endBlock
+    void beginBlock(int numSamples, double sampleRate);
+    void endBlock();
+    bool isActive() const { return active; }
+
+    // Start of a timed section (0 without reading the clock while inactive)
+    juce::int64 getStartTicks() const { return active ? now() : 0; }
+    void addStageTime(Stage stage, juce::int64 startTicks);
+
+    // Each channel is only ever timed by the thread rendering its partition
+    void addChannelTime(int channelId, juce::int64 startTicks);
+
+    // Times the enclosing scope into a stage (no-op while the profiler is inactive)
+    class ScopedStage
+    {
+    public:
+        ScopedStage(DspLoadProfiler& owner, Stage stageToTime)
+            : profiler(owner), stage(stageToTime), start(owner.getStartTicks())
+        {
+        }
+
+        ~ScopedStage()
+        {
+            profiler.addStageTime(stage, start);
+        }
+
+    private:
+        DspLoadProfiler& profiler;
+        Stage stage;
+        juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedStage)
+    };
+
+    // ---- Message thread ----
+
+    // Move finished records from the FIFO into the statistics window
+    void collect();
+
+    Stats getStageStats(Stage stage) const;
+    Stats getChannelStats(int channelId) const;
+
+    // Callback load in percent of the buffer deadline (Total / block duration)
+    Stats getLoadStats() const;
+
+    // Blocks that took longer than their deadline, and records lost to a full FIFO
+    int getNumOverruns() const { return numOverruns; }
+    int getNumDroppedBlocks() const { return numDroppedBlocks.load(std::memory_order_relaxed); }
+
+    // Multi-line summary of every stage and channel, for logging
+    juce::String createReport() const;
+
+    void reset();
+
+private:
+    static constexpr int loadSeries = NUM_STAGES + MAX_CHANNEL_SLOTS;
+    static constexpr int numSeries = loadSeries + 1;
+
+    struct BlockRecord
+    {
+        float deadlineMicros = 0.0f;
+        std::array<float, NUM_STAGES> stageMicros {};
+        std::array<float, MAX_CHANNEL_SLOTS> channelMicros {};  // < 0: channel not rendered
+    };
+
+    std::atomic<bool> enabled { false };
+    std::atomic<int> numDroppedBlocks { 0 };
+
+    // Audio thread
+    bool active = false;
+    juce::int64 blockStartTicks = 0;
+    BlockRecord current;
+    const double microsPerTick;
+
+    juce::AbstractFifo fifo { FIFO_BLOCKS };
+    std::vector<BlockRecord> fifoRecords;
+
+    // Message thread: ring of the last HISTORY_BLOCKS values per series
+    std::vector<float> history;
+    int historyWritePos = 0;
+    int historySize = 0;
+    int numOverruns = 0;
+
+    static juce::int64 now() { return juce::Time::getHighResolutionTicks(); }
+
+    Stats computeStats(int series) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DspLoadProfiler)
+};
+
+} // namespace Kousaten
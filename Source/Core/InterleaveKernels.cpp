@@ -0,0 +1,603 @@
+/*
+    Kousaten Mixer - Interleave Kernels
+    Implementation
+*/
+
+#include "InterleaveKernels.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+ #define KOUSATEN_INTERLEAVE_X86 1
+ #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #define KOUSATEN_INTERLEAVE_NEON 1
+ #include <arm_neon.h>
+#endif
+
+// AVX2 code is compiled for its own functions only; the rest of the build stays baseline
+#if defined(__GNUC__) || defined(__clang__)
+ #define KOUSATEN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+ #define KOUSATEN_TARGET_AVX2
+#endif
+
+namespace Kousaten {
+namespace Interleave {
+
+namespace {
+
+// =============================================================================
+// Scalar: the reference kernels, and the tails of the vector ones
+// =============================================================================
+
+inline float rampGain(float startGain, float step, int frame)
+{
+    return startGain + step * static_cast<float>(frame + 1);
+}
+
+void interleaveChannel(const float* source, float* dest, int stride, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+        dest[i * stride] = source[i];
+}
+
+void deinterleaveChannel(const float* source, int stride, float* dest, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+        dest[i] = source[i * stride];
+}
+
+void addChannel(const float* source, float* dest, int stride, int first, int last,
+                float startGain, float step, bool unity)
+{
+    if (unity)
+    {
+        for (int i = first; i < last; ++i)
+            dest[i * stride] += source[i];
+    }
+    else
+    {
+        for (int i = first; i < last; ++i)
+            dest[i * stride] += source[i] * rampGain(startGain, step, i);
+    }
+}
+
+// One channel is the same either way
+inline void copyMono(const float* source, float* dest, int numFrames)
+{
+    if (numFrames > 0)
+        std::memcpy(dest, source, sizeof(float) * static_cast<size_t>(numFrames));
+}
+
+void interleaveScalar(const float* const* source, int numChannels, float* dest, int numFrames)
+{
+    for (int ch = 0; ch < numChannels; ++ch)
+        interleaveChannel(source[ch], dest + ch, numChannels, 0, numFrames);
+}
+
+void deinterleaveScalar(const float* source, int numChannels, float* const* dest, int numFrames)
+{
+    for (int ch = 0; ch < numChannels; ++ch)
+        deinterleaveChannel(source + ch, numChannels, dest[ch], 0, numFrames);
+}
+
+void addWithRampScalar(const float* const* source, int numSources, float* dest, int destStride,
+                       int numFrames, float startGain, float endGain)
+{
+    if (numFrames <= 0)
+        return;
+
+    const bool unity = startGain == 1.0f && endGain == 1.0f;
+    const float step = (endGain - startGain) / static_cast<float>(numFrames);
+
+    for (int ch = 0; ch < numSources; ++ch)
+        addChannel(source[ch], dest + ch, destStride, 0, numFrames, startGain, step, unity);
+}
+
+const Kernels scalarKernels { "Scalar", interleaveScalar, deinterleaveScalar, addWithRampScalar };
+
+#if KOUSATEN_INTERLEAVE_X86
+
+// =============================================================================
+// SSE2: channel pairs, four frames at a time. A stereo buffer is written with full
+// vector stores; wider buffers take each frame's pair as one 64-bit load or store.
+// =============================================================================
+
+inline void storePairs(float* dest, int stride, __m128 lo, __m128 hi)
+{
+    _mm_storel_pi(reinterpret_cast<__m64*>(dest), lo);
+    _mm_storeh_pi(reinterpret_cast<__m64*>(dest + stride), lo);
+    _mm_storel_pi(reinterpret_cast<__m64*>(dest + 2 * stride), hi);
+    _mm_storeh_pi(reinterpret_cast<__m64*>(dest + 3 * stride), hi);
+}
+
+inline __m128 loadPairs(const float* source, int stride)
+{
+    const __m128 low = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(source));
+    return _mm_loadh_pi(low, reinterpret_cast<const __m64*>(source + stride));
+}
+
+void interleaveSSE2(const float* const* source, int numChannels, float* dest, int numFrames)
+{
+    if (numChannels == 1)
+    {
+        copyMono(source[0], dest, numFrames);
+        return;
+    }
+
+    const int vectorFrames = numFrames & ~3;
+
+    int ch = 0;
+    for (; ch + 1 < numChannels; ch += 2)
+    {
+        const float* left = source[ch];
+        const float* right = source[ch + 1];
+        float* pair = dest + ch;
+
+        for (int i = 0; i < vectorFrames; i += 4)
+        {
+            const __m128 l = _mm_loadu_ps(left + i);
+            const __m128 r = _mm_loadu_ps(right + i);
+            const __m128 lo = _mm_unpacklo_ps(l, r);
+            const __m128 hi = _mm_unpackhi_ps(l, r);
+
+            if (numChannels == 2)
+            {
+                _mm_storeu_ps(pair + 2 * i, lo);
+                _mm_storeu_ps(pair + 2 * i + 4, hi);
+            }
+            else
+            {
+                storePairs(pair + i * numChannels, numChannels, lo, hi);
+            }
+        }
+
+        interleaveChannel(left, pair, numChannels, vectorFrames, numFrames);
+        interleaveChannel(right, pair + 1, numChannels, vectorFrames, numFrames);
+    }
+
+    if (ch < numChannels)
+        interleaveChannel(source[ch], dest + ch, numChannels, 0, numFrames);
+}
+
+void deinterleaveSSE2(const float* source, int numChannels, float* const* dest, int numFrames)
+{
+    if (numChannels == 1)
+    {
+        copyMono(source, dest[0], numFrames);
+        return;
+    }
+
+    const int vectorFrames = numFrames & ~3;
+
+    int ch = 0;
+    for (; ch + 1 < numChannels; ch += 2)
+    {
+        const float* pair = source + ch;
+        float* left = dest[ch];
+        float* right = dest[ch + 1];
+
+        for (int i = 0; i < vectorFrames; i += 4)
+        {
+            __m128 a, b;
+            if (numChannels == 2)
+            {
+                a = _mm_loadu_ps(pair + 2 * i);
+                b = _mm_loadu_ps(pair + 2 * i + 4);
+            }
+            else
+            {
+                a = loadPairs(pair + i * numChannels, numChannels);
+                b = loadPairs(pair + (i + 2) * numChannels, numChannels);
+            }
+
+            _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+
+        deinterleaveChannel(pair, numChannels, left, vectorFrames, numFrames);
+        deinterleaveChannel(pair + 1, numChannels, right, vectorFrames, numFrames);
+    }
+
+    if (ch < numChannels)
+        deinterleaveChannel(source + ch, numChannels, dest[ch], 0, numFrames);
+}
+
+void addWithRampSSE2(const float* const* source, int numSources, float* dest, int destStride,
+                     int numFrames, float startGain, float endGain)
+{
+    if (numFrames <= 0)
+        return;
+
+    const bool unity = startGain == 1.0f && endGain == 1.0f;
+    const float step = (endGain - startGain) / static_cast<float>(numFrames);
+    const int vectorFrames = numFrames & ~3;
+
+    const __m128 start = _mm_set1_ps(startGain);
+    const __m128 steps = _mm_set1_ps(step);
+    const __m128 offsets = _mm_setr_ps(1.0f, 2.0f, 3.0f, 4.0f);
+
+    int ch = 0;
+    for (; ch + 1 < numSources; ch += 2)
+    {
+        const float* left = source[ch];
+        const float* right = source[ch + 1];
+        float* pair = dest + ch;
+
+        for (int i = 0; i < vectorFrames; i += 4)
+        {
+            __m128 l = _mm_loadu_ps(left + i);
+            __m128 r = _mm_loadu_ps(right + i);
+
+            if (!unity)
+            {
+                const __m128 frame = _mm_add_ps(_mm_set1_ps(static_cast<float>(i)), offsets);
+                const __m128 gain = _mm_add_ps(start, _mm_mul_ps(steps, frame));
+                l = _mm_mul_ps(l, gain);
+                r = _mm_mul_ps(r, gain);
+            }
+
+            const __m128 lo = _mm_unpacklo_ps(l, r);
+            const __m128 hi = _mm_unpackhi_ps(l, r);
+
+            if (destStride == 2)
+            {
+                float* d = pair + 2 * i;
+                _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d), lo));
+                _mm_storeu_ps(d + 4, _mm_add_ps(_mm_loadu_ps(d + 4), hi));
+            }
+            else
+            {
+                float* d = pair + i * destStride;
+                storePairs(d, destStride,
+                           _mm_add_ps(loadPairs(d, destStride), lo),
+                           _mm_add_ps(loadPairs(d + 2 * destStride, destStride), hi));
+            }
+        }
+
+        addChannel(left, pair, destStride, vectorFrames, numFrames, startGain, step, unity);
+        addChannel(right, pair + 1, destStride, vectorFrames, numFrames, startGain, step, unity);
+    }
+
+    if (ch < numSources)
+    {
+        const float* mono = source[ch];
+        float* d = dest + ch;
+        int first = 0;
+
+        if (destStride == 1)
+        {
+            for (; first < vectorFrames; first += 4)
+            {
+                __m128 s = _mm_loadu_ps(mono + first);
+                if (!unity)
+                {
+                    const __m128 frame = _mm_add_ps(_mm_set1_ps(static_cast<float>(first)), offsets);
+                    s = _mm_mul_ps(s, _mm_add_ps(start, _mm_mul_ps(steps, frame)));
+                }
+                _mm_storeu_ps(d + first, _mm_add_ps(_mm_loadu_ps(d + first), s));
+            }
+        }
+
+        addChannel(mono, d, destStride, first, numFrames, startGain, step, unity);
+    }
+}
+
+const Kernels sse2Kernels { "SSE2", interleaveSSE2, deinterleaveSSE2, addWithRampSSE2 };
+
+// =============================================================================
+// AVX2: eight frames at a time for stereo buffers (the usual device layout); other
+// layouts use the SSE2 kernels
+// =============================================================================
+
+KOUSATEN_TARGET_AVX2 void interleaveAVX2(const float* const* source, int numChannels, float* dest, int numFrames)
+{
+    if (numChannels != 2)
+    {
+        interleaveSSE2(source, numChannels, dest, numFrames);
+        return;
+    }
+
+    const float* left = source[0];
+    const float* right = source[1];
+    const int vectorFrames = numFrames & ~7;
+
+    for (int i = 0; i < vectorFrames; i += 8)
+    {
+        const __m256 l = _mm256_loadu_ps(left + i);
+        const __m256 r = _mm256_loadu_ps(right + i);
+
+        // Unpacks work within 128-bit lanes; the permutes put the lanes back in order
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dest + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dest + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+
+    interleaveChannel(left, dest, 2, vectorFrames, numFrames);
+    interleaveChannel(right, dest + 1, 2, vectorFrames, numFrames);
+}
+
+KOUSATEN_TARGET_AVX2 void deinterleaveAVX2(const float* source, int numChannels, float* const* dest, int numFrames)
+{
+    if (numChannels != 2)
+    {
+        deinterleaveSSE2(source, numChannels, dest, numFrames);
+        return;
+    }
+
+    float* left = dest[0];
+    float* right = dest[1];
+    const int vectorFrames = numFrames & ~7;
+
+    for (int i = 0; i < vectorFrames; i += 8)
+    {
+        const __m256 a = _mm256_loadu_ps(source + 2 * i);
+        const __m256 b = _mm256_loadu_ps(source + 2 * i + 8);
+
+        // Frames 0-1 and 4-5 in one register, 2-3 and 6-7 in the other, so the in-lane
+        // shuffles come out in frame order
+        const __m256 front = _mm256_permute2f128_ps(a, b, 0x20);
+        const __m256 back = _mm256_permute2f128_ps(a, b, 0x31);
+        _mm256_storeu_ps(left + i, _mm256_shuffle_ps(front, back, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm256_storeu_ps(right + i, _mm256_shuffle_ps(front, back, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    deinterleaveChannel(source, 2, left, vectorFrames, numFrames);
+    deinterleaveChannel(source + 1, 2, right, vectorFrames, numFrames);
+}
+
+KOUSATEN_TARGET_AVX2 void addWithRampAVX2(const float* const* source, int numSources, float* dest, int destStride,
+                                          int numFrames, float startGain, float endGain)
+{
+    if (numSources != 2 || destStride != 2 || numFrames <= 0)
+    {
+        addWithRampSSE2(source, numSources, dest, destStride, numFrames, startGain, endGain);
+        return;
+    }
+
+    const bool unity = startGain == 1.0f && endGain == 1.0f;
+    const float step = (endGain - startGain) / static_cast<float>(numFrames);
+    const int vectorFrames = numFrames & ~7;
+
+    const __m256 start = _mm256_set1_ps(startGain);
+    const __m256 steps = _mm256_set1_ps(step);
+    const __m256 offsets = _mm256_setr_ps(1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f);
+
+    const float* left = source[0];
+    const float* right = source[1];
+
+    for (int i = 0; i < vectorFrames; i += 8)
+    {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+
+        if (!unity)
+        {
+            const __m256 frame = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), offsets);
+            const __m256 gain = _mm256_add_ps(start, _mm256_mul_ps(steps, frame));
+            l = _mm256_mul_ps(l, gain);
+            r = _mm256_mul_ps(r, gain);
+        }
+
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+
+        float* d = dest + 2 * i;
+        _mm256_storeu_ps(d, _mm256_add_ps(_mm256_loadu_ps(d), _mm256_permute2f128_ps(lo, hi, 0x20)));
+        _mm256_storeu_ps(d + 8, _mm256_add_ps(_mm256_loadu_ps(d + 8), _mm256_permute2f128_ps(lo, hi, 0x31)));
+    }
+
+    addChannel(left, dest, 2, vectorFrames, numFrames, startGain, step, unity);
+    addChannel(right, dest + 1, 2, vectorFrames, numFrames, startGain, step, unity);
+}
+
+const Kernels avx2Kernels { "AVX2", interleaveAVX2, deinterleaveAVX2, addWithRampAVX2 };
+
+#elif KOUSATEN_INTERLEAVE_NEON
+
+// =============================================================================
+// NEON: channel pairs, four frames at a time. Stereo buffers use the structured
+// load/store instructions; wider buffers take each frame's pair as one 64-bit access.
+// =============================================================================
+
+inline void storePairs(float* dest, int stride, float32x4x2_t zipped)
+{
+    vst1_f32(dest, vget_low_f32(zipped.val[0]));
+    vst1_f32(dest + stride, vget_high_f32(zipped.val[0]));
+    vst1_f32(dest + 2 * stride, vget_low_f32(zipped.val[1]));
+    vst1_f32(dest + 3 * stride, vget_high_f32(zipped.val[1]));
+}
+
+inline float32x4x2_t loadPairs(const float* source, int stride)
+{
+    const float32x4_t a = vcombine_f32(vld1_f32(source), vld1_f32(source + stride));
+    const float32x4_t b = vcombine_f32(vld1_f32(source + 2 * stride), vld1_f32(source + 3 * stride));
+    return vuzpq_f32(a, b);
+}
+
+void interleaveNEON(const float* const* source, int numChannels, float* dest, int numFrames)
+{
+    if (numChannels == 1)
+    {
+        copyMono(source[0], dest, numFrames);
+        return;
+    }
+
+    const int vectorFrames = numFrames & ~3;
+
+    int ch = 0;
+    for (; ch + 1 < numChannels; ch += 2)
+    {
+        const float* left = source[ch];
+        const float* right = source[ch + 1];
+        float* pair = dest + ch;
+
+        for (int i = 0; i < vectorFrames; i += 4)
+        {
+            const float32x4_t l = vld1q_f32(left + i);
+            const float32x4_t r = vld1q_f32(right + i);
+
+            if (numChannels == 2)
+            {
+                const float32x4x2_t frames { { l, r } };
+                vst2q_f32(pair + 2 * i, frames);
+            }
+            else
+            {
+                storePairs(pair + i * numChannels, numChannels, vzipq_f32(l, r));
+            }
+        }
+
+        interleaveChannel(left, pair, numChannels, vectorFrames, numFrames);
+        interleaveChannel(right, pair + 1, numChannels, vectorFrames, numFrames);
+    }
+
+    if (ch < numChannels)
+        interleaveChannel(source[ch], dest + ch, numChannels, 0, numFrames);
+}
+
+void deinterleaveNEON(const float* source, int numChannels, float* const* dest, int numFrames)
+{
+    if (numChannels == 1)
+    {
+        copyMono(source, dest[0], numFrames);
+        return;
+    }
+
+    const int vectorFrames = numFrames & ~3;
+
+    int ch = 0;
+    for (; ch + 1 < numChannels; ch += 2)
+    {
+        const float* pair = source + ch;
+        float* left = dest[ch];
+        float* right = dest[ch + 1];
+
+        for (int i = 0; i < vectorFrames; i += 4)
+        {
+            const float32x4x2_t split = numChannels == 2 ? vld2q_f32(pair + 2 * i)
+                                                         : loadPairs(pair + i * numChannels, numChannels);
+            vst1q_f32(left + i, split.val[0]);
+            vst1q_f32(right + i, split.val[1]);
+        }
+
+        deinterleaveChannel(pair, numChannels, left, vectorFrames, numFrames);
+        deinterleaveChannel(pair + 1, numChannels, right, vectorFrames, numFrames);
+    }
+
+    if (ch < numChannels)
+        deinterleaveChannel(source + ch, numChannels, dest[ch], 0, numFrames);
+}
+
+void addWithRampNEON(const float* const* source, int numSources, float* dest, int destStride,
+                     int numFrames, float startGain, float endGain)
+{
+    if (numFrames <= 0)
+        return;
+
+    const bool unity = startGain == 1.0f && endGain == 1.0f;
+    const float step = (endGain - startGain) / static_cast<float>(numFrames);
+    const int vectorFrames = numFrames & ~3;
+
+    const float offsetValues[] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    const float32x4_t start = vdupq_n_f32(startGain);
+    const float32x4_t steps = vdupq_n_f32(step);
+    const float32x4_t offsets = vld1q_f32(offsetValues);
+
+    int ch = 0;
+    for (; ch + 1 < numSources; ch += 2)
+    {
+        const float* left = source[ch];
+        const float* right = source[ch + 1];
+        float* pair = dest + ch;
+
+        for (int i = 0; i < vectorFrames; i += 4)
+        {
+            float32x4_t l = vld1q_f32(left + i);
+            float32x4_t r = vld1q_f32(right + i);
+
+            if (!unity)
+            {
+                const float32x4_t frame = vaddq_f32(vdupq_n_f32(static_cast<float>(i)), offsets);
+                const float32x4_t gain = vaddq_f32(start, vmulq_f32(steps, frame));
+                l = vmulq_f32(l, gain);
+                r = vmulq_f32(r, gain);
+            }
+
+            if (destStride == 2)
+            {
+                float32x4x2_t frames = vld2q_f32(pair + 2 * i);
+                frames.val[0] = vaddq_f32(frames.val[0], l);
+                frames.val[1] = vaddq_f32(frames.val[1], r);
+                vst2q_f32(pair + 2 * i, frames);
+            }
+            else
+            {
+                float* d = pair + i * destStride;
+                const float32x4x2_t existing = loadPairs(d, destStride);
+                storePairs(d, destStride, vzipq_f32(vaddq_f32(existing.val[0], l),
+                                                    vaddq_f32(existing.val[1], r)));
+            }
+        }
+
+        addChannel(left, pair, destStride, vectorFrames, numFrames, startGain, step, unity);
+        addChannel(right, pair + 1, destStride, vectorFrames, numFrames, startGain, step, unity);
+    }
+
+    if (ch < numSources)
+    {
+        const float* mono = source[ch];
+        float* d = dest + ch;
+        int first = 0;
+
+        if (destStride == 1)
+        {
+            for (; first < vectorFrames; first += 4)
+            {
+                float32x4_t s = vld1q_f32(mono + first);
+                if (!unity)
+                {
+                    const float32x4_t frame = vaddq_f32(vdupq_n_f32(static_cast<float>(first)), offsets);
+                    s = vmulq_f32(s, vaddq_f32(start, vmulq_f32(steps, frame)));
+                }
+                vst1q_f32(d + first, vaddq_f32(vld1q_f32(d + first), s));
+            }
+        }
+
+        addChannel(mono, d, destStride, first, numFrames, startGain, step, unity);
+    }
+}
+
+const Kernels neonKernels { "NEON", interleaveNEON, deinterleaveNEON, addWithRampNEON };
+
+#endif
+
+const Kernels& selectKernels()
+{
+   #if KOUSATEN_INTERLEAVE_X86
+    if (juce::SystemStats::hasAVX2())
+        return avx2Kernels;
+    return sse2Kernels;
+   #elif KOUSATEN_INTERLEAVE_NEON
+    return neonKernels;
+   #else
+    return scalarKernels;
+   #endif
+}
+
+} // namespace
+
+const Kernels& getKernels()
+{
+    static const Kernels& kernels = selectKernels();
+    return kernels;
+}
+
+const Kernels& getScalarKernels()
+{
+    return scalarKernels;
+}
+
+} // namespace Interleave
+} // namespace Kousaten
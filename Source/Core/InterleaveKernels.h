@@ -0,0 +1,54 @@
+/*
+    Kousaten Mixer - Interleave Kernels
+    Interleave, deinterleave and gain-ramped mix kernels for device I/O, in SSE2, AVX2
+    and NEON with a scalar fallback; the best set for the CPU is picked once at runtime
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Kousaten {
+namespace Interleave {
+
+struct Kernels
+{
+    const char* name;  // "Scalar", "SSE2", "AVX2" or "NEON"
+
+    // Copy numChannels planar channels into one interleaved buffer
+    void (*interleave)(const float* const* source, int numChannels, float* dest, int numFrames);
+
+    // Split an interleaved buffer into numChannels planar channels
+    void (*deinterleave)(const float* source, int numChannels, float* const* dest, int numFrames);
+
+    // Mix numSources planar channels into consecutive channels of an interleaved buffer
+    // destStride channels wide (dest points at the first of them), under a linear ramp
+    // that reaches endGain on the last frame. Frame i gets startGain + step * (i + 1).
+    void (*addWithRamp)(const float* const* source, int numSources, float* dest, int destStride,
+                        int numFrames, float startGain, float endGain);
+};
+
+// The fastest kernels this CPU supports (chosen on first use, safe from any thread)
+const Kernels& getKernels();
+
+// Plain loops, the reference the others must match
+const Kernels& getScalarKernels();
+
+inline void interleave(const float* const* source, int numChannels, float* dest, int numFrames)
+{
+    getKernels().interleave(source, numChannels, dest, numFrames);
+}
+
+inline void deinterleave(const float* source, int numChannels, float* const* dest, int numFrames)
+{
+    getKernels().deinterleave(source, numChannels, dest, numFrames);
+}
+
+inline void addWithRamp(const float* const* source, int numSources, float* dest, int destStride,
+                        int numFrames, float startGain = 1.0f, float endGain = 1.0f)
+{
+    getKernels().addWithRamp(source, numSources, dest, destStride, numFrames, startGain, endGain);
+}
+
+} // namespace Interleave
+} // namespace Kousaten
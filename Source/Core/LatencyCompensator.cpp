@@ -0,0 +1,131 @@
+/*
+    Kousaten Mixer - Latency Compensator
+    Implementation
+*/
+
+#include "LatencyCompensator.h"
+
+namespace Kousaten {
+
+void CompensationDelay::prepare(int numChannels, int maxDelayFrames, int maxBlockSize, int initialDelay)
+{
+    maxDelay = std::max(0, maxDelayFrames);
+
+    // Room for the longest delay behind a full block
+    const int size = juce::nextPowerOfTwo(maxDelay + std::max(1, maxBlockSize));
+    buffer.setSize(std::max(0, numChannels), size);
+    buffer.clear();
+    mask = size - 1;
+    writePos = 0;
+    currentDelay = juce::jlimit(0, maxDelay, initialDelay);
+}
+
+void CompensationDelay::process(float* const* channels, int numChannels, int numSamples, int delayFrames)
+{
+    const int newDelay = juce::jlimit(0, maxDelay, delayFrames);
+    numChannels = std::min(numChannels, buffer.getNumChannels());
+
+    // Record, so a delay switched on later starts from real audio. Undelayed, only the last
+    // maxDelay samples of the block can ever be read.
+    const int firstRecorded = newDelay == 0 && currentDelay == 0 ? std::max(0, numSamples - maxDelay) : 0;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        float* data = channels[ch];
+        if (data == nullptr)
+            continue;
+
+        float* line = buffer.getWritePointer(ch);
+        for (int i = firstRecorded; i < numSamples; ++i)
+            line[(writePos + i) & mask] = data[i];
+
+        if (newDelay == currentDelay)
+        {
+            if (currentDelay == 0)
+                continue;
+
+            for (int i = 0; i < numSamples; ++i)
+                data[i] = line[(writePos + i - currentDelay) & mask];
+        }
+        else
+        {
+            // Crossfade from the old tap to the new one instead of jumping
+            const float step = 1.0f / static_cast<float>(numSamples);
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float from = line[(writePos + i - currentDelay) & mask];
+                const float to = line[(writePos + i - newDelay) & mask];
+                data[i] = from + static_cast<float>(i + 1) * step * (to - from);
+            }
+        }
+    }
+
+    writePos = (writePos + numSamples) & mask;
+    currentDelay = newDelay;
+}
+
+void LatencyCompensator::prepare(double rate, int maxBlockSize, int numChannels)
+{
+    sampleRate = rate;
+    maxDelayFrames = juce::roundToInt(MAX_DELAY_MS * rate / 1000.0);
+    const int kept = std::min(targetDelay.load(std::memory_order_relaxed), maxDelayFrames);
+    targetDelay.store(kept, std::memory_order_relaxed);
+    delay.prepare(numChannels, maxDelayFrames, maxBlockSize, kept);
+}
+
+void LatencyCompensator::setDeviceTrim(const juce::String& deviceName, double trimMs)
+{
+    for (auto& trim : trims)
+    {
+        if (trim.first == deviceName)
+        {
+            trim.second = trimMs;
+            return;
+        }
+    }
+
+    trims.emplace_back(deviceName, trimMs);
+}
+
+double LatencyCompensator::getDeviceTrim(const juce::String& deviceName) const
+{
+    for (const auto& trim : trims)
+    {
+        if (trim.first == deviceName)
+            return trim.second;
+    }
+
+    return 0.0;
+}
+
+void LatencyCompensator::update(const std::vector<std::pair<juce::String, int>>& measuredLatencies)
+{
+    table.clear();
+    int latest = 0;
+
+    for (const auto& [deviceName, measuredFrames] : measuredLatencies)
+    {
+        DeviceLatency row;
+        row.deviceName = deviceName;
+        row.measuredFrames = measuredFrames;
+        row.trimMs = getDeviceTrim(deviceName);
+        row.totalFrames = measuredFrames + juce::roundToInt(row.trimMs * sampleRate / 1000.0);
+
+        latest = std::max(latest, row.totalFrames);
+        table.push_back(row);
+    }
+
+    const int newDelay = enabled ? juce::jlimit(0, maxDelayFrames, latest - mainOutputLatency - mainInsertLatency) : 0;
+    const int hysteresis = juce::roundToInt(HYSTERESIS_MS * sampleRate / 1000.0);
+
+    // Switching off (or losing the last device) always takes effect
+    if (newDelay == 0 || std::abs(newDelay - getDelayFrames()) > hysteresis)
+        targetDelay.store(newDelay, std::memory_order_relaxed);
+}
+
+void LatencyCompensator::process(float* const* channels, int numChannels, int numSamples)
+{
+    delay.process(channels, numChannels, numSamples, targetDelay.load(std::memory_order_relaxed));
+}
+
+} // namespace Kousaten
@@ -0,0 +1,107 @@
+/*
+    Kousaten Mixer - Latency Compensator
+    Delays the main device's outputs (master and same-device aux buses) so they line up
+    with aux outputs that reach their RtAudio devices later
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+namespace Kousaten {
+
+// Delay lines for a few channels whose delay can change while they run: a new delay is
+// crossfaded in from the old tap over one block instead of jumped to
+class CompensationDelay
+{
+public:
+    // Message thread, audio stopped: allocate for delays up to maxDelayFrames and start
+    // from silence at initialDelay
+    void prepare(int numChannels, int maxDelayFrames, int maxBlockSize, int initialDelay = 0);
+
+    int getMaxDelay() const { return maxDelay; }
+    int getDelay() const { return currentDelay; }
+
+    // Audio thread: delay the first numChannels channels in place by delayFrames (clamped
+    // to the maximum). Undelayed blocks only keep the history a later delay will read.
+    void process(float* const* channels, int numChannels, int numSamples, int delayFrames);
+
+private:
+    // Power-of-two lines, one per channel
+    juce::AudioBuffer<float> buffer;
+    int mask = 0;
+    int maxDelay = 0;
+    int writePos = 0;
+    int currentDelay = 0;
+};
+
+class LatencyCompensator
+{
+public:
+    // Longest delay applied to the main outputs
+    static constexpr double MAX_DELAY_MS = 250.0;
+
+    // Measured latency changes smaller than this leave the delay alone, so the
+    // controller's fill jitter doesn't keep moving it
+    static constexpr double HYSTERESIS_MS = 1.0;
+
+    // One row of the compensation table: an RtAudio device in use by an aux bus
+    struct DeviceLatency
+    {
+        juce::String deviceName;
+        int measuredFrames = 0;  // Engine to device output, as measured by its stream
+        double trimMs = 0.0;     // User offset, added to the measurement
+        int totalFrames = 0;     // measuredFrames + trim
+    };
+
+    // Message thread, audio stopped: allocate for numChannels main outputs
+    void prepare(double sampleRate, int maxBlockSize, int numChannels);
+
+    // Message thread: the main device's own output latency (buffer included)
+    void setMainOutputLatency(int frames) { mainOutputLatency = frames; }
+    int getMainOutputLatency() const { return mainOutputLatency; }
+
+    // Message thread: delay the engine has already added to the main outputs (aux inserts
+    // on the main device), which the devices in use get this much less of
+    void setMainInsertLatency(int frames) { mainInsertLatency = frames; }
+
+    // Message thread: compensation on/off (off = no delay, table still measured)
+    void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+    bool isEnabled() const { return enabled; }
+
+    // Message thread: per-device trim in ms; kept for devices not currently in use
+    void setDeviceTrim(const juce::String& deviceName, double trimMs);
+    double getDeviceTrim(const juce::String& deviceName) const;
+
+    // Message thread: rebuild the table from the latencies of the devices in use and
+    // retarget the main output delay to the latest of them
+    void update(const std::vector<std::pair<juce::String, int>>& measuredLatencies);
+
+    const std::vector<DeviceLatency>& getTable() const { return table; }
+    int getDelayFrames() const { return targetDelay.load(std::memory_order_relaxed); }
+    double getDelayMs() const { return framesToMs(getDelayFrames()); }
+    double framesToMs(int frames) const { return frames * 1000.0 / sampleRate; }
+
+    // Audio thread: delay the first numChannels outputs in place. A new delay is
+    // crossfaded in over one block.
+    void process(float* const* channels, int numChannels, int numSamples);
+
+private:
+    double sampleRate = 48000.0;
+    int maxDelayFrames = 0;
+    int mainOutputLatency = 0;
+    int mainInsertLatency = 0;
+    bool enabled = true;
+
+    std::vector<DeviceLatency> table;
+    std::vector<std::pair<juce::String, double>> trims;
+
+    CompensationDelay delay;  // One line per main output
+    std::atomic<int> targetDelay { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LatencyCompensator)
+};
+
+} // namespace Kousaten
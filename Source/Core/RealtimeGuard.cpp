@@ -0,0 +1,308 @@
+/*
+    Kousaten Mixer - Realtime Guard
+    Implementation
+
+    On glibc the C allocator, pthread locks/waits and common blocking calls are
+    interposed, which also covers operator new/delete and std::mutex. Elsewhere only
+    operator new/delete are replaced.
+*/
+
+#include "RealtimeGuard.h"
+
+#if KOUSATEN_REALTIME_GUARD
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+ #include <dlfcn.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <time.h>
+ #include <unistd.h>
+#elif defined(_WIN32)
+ #include <malloc.h>
+#endif
+
+namespace Kousaten {
+
+namespace {
+
+thread_local int realtimeDepth = 0;
+thread_local bool reportingViolation = false;
+
+std::atomic<int> violationCount { 0 };
+
+// Full stacks for the first few violations; later ones are only counted
+constexpr int maxReportedStacks = 16;
+
+bool shouldAbortOnViolation()
+{
+    static const bool abortOnViolation = [] {
+        const char* value = std::getenv("KOUSATEN_RT_GUARD_ABORT");
+        return value != nullptr && value[0] == '1';
+    }();
+    return abortOnViolation;
+}
+
+} // namespace
+
+int RealtimeGuard::getViolationCount()
+{
+    return violationCount.load();
+}
+
+void RealtimeGuard::enterRealtimeSection()
+{
+    ++realtimeDepth;
+}
+
+void RealtimeGuard::exitRealtimeSection()
+{
+    --realtimeDepth;
+}
+
+void RealtimeGuard::reportViolation(const char* what)
+{
+    if (realtimeDepth == 0 || reportingViolation)
+        return;
+
+    // Reporting allocates and writes; don't trap ourselves
+    reportingViolation = true;
+
+    int count = ++violationCount;
+    if (count <= maxReportedStacks)
+    {
+        auto stack = juce::SystemStats::getStackBacktrace();
+        std::fprintf(stderr, "[RealtimeGuard] %s on the audio thread (violation %d)\n%s\n",
+                     what, count, stack.toRawUTF8());
+    }
+    else if (count == maxReportedStacks + 1)
+    {
+        std::fprintf(stderr, "[RealtimeGuard] further violations are counted but not printed\n");
+    }
+
+    if (shouldAbortOnViolation())
+        std::abort();
+
+    reportingViolation = false;
+}
+
+} // namespace Kousaten
+
+using Kousaten::RealtimeGuard;
+
+#if defined(__GLIBC__)
+
+// =============================================================================
+// glibc: interpose the allocator and blocking calls
+// =============================================================================
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+void* __libc_pvalloc(size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    RealtimeGuard::reportViolation("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    RealtimeGuard::reportViolation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    RealtimeGuard::reportViolation("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    RealtimeGuard::reportViolation("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* valloc(size_t size)
+{
+    RealtimeGuard::reportViolation("valloc");
+    return __libc_valloc(size);
+}
+
+void* pvalloc(size_t size)
+{
+    RealtimeGuard::reportViolation("pvalloc");
+    return __libc_pvalloc(size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    RealtimeGuard::reportViolation("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size)
+{
+    RealtimeGuard::reportViolation("posix_memalign");
+
+    // Same contract as glibc's: a non-zero power of two multiple of sizeof(void*)
+    if (alignment == 0 || alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    *result = __libc_memalign(alignment, size);
+    return *result != nullptr ? 0 : ENOMEM;
+}
+
+void free(void* ptr)
+{
+    if (ptr != nullptr)
+        RealtimeGuard::reportViolation("free");
+    __libc_free(ptr);
+}
+
+} // extern "C"
+
+namespace {
+
+// Resolve the next definition of an interposed function (libc/libpthread)
+template <typename Function>
+Function getNextFunction(std::atomic<Function>& cache, const char* name)
+{
+    auto function = cache.load(std::memory_order_relaxed);
+    if (function == nullptr)
+    {
+        function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+        cache.store(function, std::memory_order_relaxed);
+    }
+    return function;
+}
+
+} // namespace
+
+#define KOUSATEN_GUARDED_CALL(returnType, name, params, args)                       \
+    extern "C" returnType name params                                               \
+    {                                                                               \
+        using Function = returnType (*) params;                                     \
+        static std::atomic<Function> next { nullptr };                              \
+        RealtimeGuard::reportViolation(#name);                                      \
+        return getNextFunction(next, #name) args;                                   \
+    }
+
+KOUSATEN_GUARDED_CALL(int, pthread_mutex_lock, (pthread_mutex_t* mutex), (mutex))
+KOUSATEN_GUARDED_CALL(int, pthread_mutex_trylock, (pthread_mutex_t* mutex), (mutex))
+KOUSATEN_GUARDED_CALL(int, pthread_cond_wait, (pthread_cond_t* cond, pthread_mutex_t* mutex), (cond, mutex))
+KOUSATEN_GUARDED_CALL(int, pthread_cond_timedwait, (pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* time), (cond, mutex, time))
+KOUSATEN_GUARDED_CALL(int, sem_wait, (sem_t* semaphore), (semaphore))
+KOUSATEN_GUARDED_CALL(int, nanosleep, (const struct timespec* request, struct timespec* remaining), (request, remaining))
+KOUSATEN_GUARDED_CALL(int, clock_nanosleep, (clockid_t clock, int flags, const struct timespec* request, struct timespec* remaining), (clock, flags, request, remaining))
+KOUSATEN_GUARDED_CALL(int, usleep, (useconds_t microseconds), (microseconds))
+KOUSATEN_GUARDED_CALL(ssize_t, read, (int fd, void* data, size_t size), (fd, data, size))
+KOUSATEN_GUARDED_CALL(ssize_t, write, (int fd, const void* data, size_t size), (fd, data, size))
+
+#undef KOUSATEN_GUARDED_CALL
+
+#else
+
+// =============================================================================
+// Other platforms: operator new/delete only
+// =============================================================================
+
+void* operator new(std::size_t size)
+{
+    RealtimeGuard::reportViolation("operator new");
+
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeGuard::reportViolation("operator delete");
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept                { operator delete(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept     { operator delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept   { operator delete(ptr); }
+
+#if defined(__cpp_aligned_new)
+
+// Over-aligned types (alignas above the default new alignment) come through these
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    RealtimeGuard::reportViolation("operator new");
+
+    auto align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    if (size == 0)
+        size = 1;
+
+   #if defined(_WIN32)
+    if (void* ptr = _aligned_malloc(size, align))
+        return ptr;
+   #else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, align, size) == 0)
+        return ptr;
+   #endif
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    if (ptr != nullptr)
+        RealtimeGuard::reportViolation("operator delete");
+
+   #if defined(_WIN32)
+    _aligned_free(ptr);
+   #else
+    std::free(ptr);
+   #endif
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept                { operator delete(ptr, alignment); }
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept     { operator delete(ptr, alignment); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept   { operator delete(ptr, alignment); }
+
+#endif
+
+#endif
+
+#else
+
+namespace Kousaten {
+
+int RealtimeGuard::getViolationCount()                  { return 0; }
+void RealtimeGuard::reportViolation(const char*)        {}
+void RealtimeGuard::enterRealtimeSection()              {}
+void RealtimeGuard::exitRealtimeSection()               {}
+
+} // namespace Kousaten
+
+#endif
@@ -0,0 +1,52 @@
+/*
+    Kousaten Mixer - Realtime Guard
+    Debug/CI instrumentation that reports allocations, locks and blocking calls
+    made by a thread while it is inside the audio callback
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Enabled with the KOUSATEN_REALTIME_GUARD CMake option. When off, sections compile to nothing.
+#ifndef KOUSATEN_REALTIME_GUARD
+ #define KOUSATEN_REALTIME_GUARD 0
+#endif
+
+namespace Kousaten {
+
+class RealtimeGuard
+{
+public:
+    // Marks the calling thread as real-time for the lifetime of the object (nestable).
+    // Place at the top of every audio callback and of work run on its behalf.
+    class ScopedRealtimeSection
+    {
+    public:
+       #if KOUSATEN_REALTIME_GUARD
+        ScopedRealtimeSection()  { enterRealtimeSection(); }
+        ~ScopedRealtimeSection() { exitRealtimeSection(); }
+       #else
+        ScopedRealtimeSection()  {}
+        ~ScopedRealtimeSection() {}
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+
+    static constexpr bool isEnabled() { return KOUSATEN_REALTIME_GUARD != 0; }
+
+    // Number of violations seen so far, on any thread (always 0 when compiled out)
+    static int getViolationCount();
+
+    // Called by the interposed functions: records and reports `what` (with the stack) if
+    // the calling thread is inside a real-time section. Set KOUSATEN_RT_GUARD_ABORT=1 in
+    // the environment to abort at the first violation instead.
+    static void reportViolation(const char* what);
+
+private:
+    static void enterRealtimeSection();
+    static void exitRealtimeSection();
+};
+
+} // namespace Kousaten
@@ -0,0 +1,284 @@
+/*
+    Kousaten Mixer - Render Worker Pool
+    Implementation
+*/
+
+#include "RenderWorkerPool.h"
+#include "RealtimeGuard.h"
+#include <chrono>
+#include <thread>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <cerrno>
+ #include <semaphore.h>
+#endif
+
+namespace Kousaten {
+
+namespace {
+
+constexpr juce::uint64 taskMask = 0xffff;
+
+int getNextTask(juce::uint64 state)  { return static_cast<int>(state & taskMask); }
+int getNumTasks(juce::uint64 state)  { return static_cast<int>((state >> 16) & taskMask); }
+
+// Workers keep polling this long after their last task, which covers the rest of a job,
+// then block until the audio thread publishes the next one
+constexpr auto spinBeforeSleep = std::chrono::microseconds(10);
+
+} // namespace
+
+// Counting semaphore whose post takes no lock, so the audio thread can wake workers
+class RenderWorkerPool::Semaphore
+{
+public:
+#if JUCE_WINDOWS
+    Semaphore() : handle(CreateSemaphoreW(nullptr, 0, MAX_WORKERS, nullptr)) {}
+    ~Semaphore() { CloseHandle(handle); }
+
+    void post(int count) { ReleaseSemaphore(handle, count, nullptr); }
+    void wait() { WaitForSingleObject(handle, INFINITE); }
+
+private:
+    HANDLE handle;
+#elif JUCE_MAC || JUCE_IOS
+    Semaphore() : semaphore(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(semaphore); }
+
+    void post(int count)
+    {
+        for (int i = 0; i < count; ++i)
+            dispatch_semaphore_signal(semaphore);
+    }
+
+    void wait() { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+
+private:
+    dispatch_semaphore_t semaphore;
+#else
+    Semaphore() { sem_init(&semaphore, 0, 0); }
+    ~Semaphore() { sem_destroy(&semaphore); }
+
+    void post(int count)
+    {
+        for (int i = 0; i < count; ++i)
+            sem_post(&semaphore);
+    }
+
+    void wait()
+    {
+        while (sem_wait(&semaphore) != 0 && errno == EINTR) {}
+    }
+
+private:
+    sem_t semaphore;
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE(Semaphore)
+};
+
+class RenderWorkerPool::Worker : public juce::Thread
+{
+public:
+    Worker(RenderWorkerPool& ownerPool, int index)
+        : juce::Thread("Kousaten Render " + juce::String(index + 1))
+        , pool(ownerPool)
+    {
+    }
+
+    // The pool signals the thread to exit and wakes it first; a claimed task always
+    // finishes, so the join has no timeout
+    ~Worker() override
+    {
+        stopThread(-1);
+    }
+
+    void run() override
+    {
+        auto lastWork = std::chrono::steady_clock::now();
+
+        while (!threadShouldExit())
+        {
+            if (pool.runNextTask())
+            {
+                lastWork = std::chrono::steady_clock::now();
+                continue;
+            }
+
+            if (std::chrono::steady_clock::now() - lastWork < spinBeforeSleep)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            pool.waitForWork(*this);
+            lastWork = std::chrono::steady_clock::now();
+        }
+    }
+
+private:
+    RenderWorkerPool& pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Worker)
+};
+
+RenderWorkerPool::RenderWorkerPool(std::function<void(int)> taskFunction)
+    : task(std::move(taskFunction))
+    , wakeUp(std::make_unique<Semaphore>())
+{
+}
+
+RenderWorkerPool::~RenderWorkerPool()
+{
+    stopWorkers();
+}
+
+void RenderWorkerPool::stopWorkers()
+{
+    // The audio thread stops handing out jobs to workers; one already published still
+    // completes, as the caller runs whatever no worker has claimed
+    numActiveWorkers.store(0);
+
+    for (auto& worker : workers)
+        worker->signalThreadShouldExit();
+
+    wakeWorkers(MAX_WORKERS);
+    workers.clear();
+}
+
+void RenderWorkerPool::setNumWorkers(int numWorkers, int blockSize, double sampleRate)
+{
+    numWorkers = juce::jlimit(0, MAX_WORKERS, numWorkers);
+    if (numWorkers == static_cast<int>(workers.size()))
+        return;
+
+    // A stopping worker finishes the task it has claimed before it is joined, so this is
+    // safe mid-stream
+    stopWorkers();
+
+    // Pin each worker to its own core, leaving core 0 for the device callback. With more
+    // workers than spare cores the OS places them instead.
+    const int numCpus = juce::SystemStats::getNumCpus();
+    const bool pinWorkers = numWorkers < numCpus && numWorkers < 32;
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto worker = std::make_unique<Worker>(*this, i);
+
+        if (pinWorkers)
+            worker->setAffinityMask(1u << (i + 1));
+
+        auto options = juce::Thread::RealtimeOptions{}
+                           .withApproximateAudioProcessingTime(blockSize, sampleRate);
+
+        if (!worker->startRealtimeThread(options))
+        {
+            DBG("RenderWorkerPool: real-time priority unavailable, using highest");
+            worker->startThread(juce::Thread::Priority::highest);
+        }
+
+        workers.push_back(std::move(worker));
+    }
+
+    numActiveWorkers.store(numWorkers);
+    DBG("RenderWorkerPool: " + juce::String(numWorkers) + " worker(s)");
+}
+
+void RenderWorkerPool::run(int numTasks)
+{
+    numTasks = std::min(numTasks, MAX_TASKS);
+
+    if (numTasks <= 1 || numActiveWorkers.load(std::memory_order_relaxed) == 0)
+    {
+        for (int i = 0; i < numTasks; ++i)
+            task(i);
+        return;
+    }
+
+    // Publish the job: everything the tasks read was written before this store. It is
+    // sequentially consistent with the sleep count, so a worker going to sleep either sees
+    // the job or is counted and woken.
+    completedTasks.store(0, std::memory_order_relaxed);
+    ++generation;
+    jobState.store((static_cast<juce::uint64>(generation) << 32)
+                       | (static_cast<juce::uint64>(numTasks) << 16));
+
+    wakeWorkers(numTasks - 1);
+
+    while (runNextTask()) {}
+
+    // Barrier: wait for the tasks workers claimed to complete
+    while (completedTasks.load(std::memory_order_acquire) < numTasks)
+        std::this_thread::yield();
+}
+
+bool RenderWorkerPool::hasUnclaimedTask() const
+{
+    const auto state = jobState.load();
+    return getNextTask(state) < getNumTasks(state);
+}
+
+void RenderWorkerPool::waitForWork(Worker& worker)
+{
+    sleepingWorkers.fetch_add(1);
+
+    // A job or stop that arrived before the count went up may not have woken anyone:
+    // withdraw from the count, unless another thread already took this worker off it and
+    // so owes it a post
+    if (hasUnclaimedTask() || worker.threadShouldExit())
+    {
+        int sleeping = sleepingWorkers.load();
+        while (sleeping > 0)
+        {
+            if (sleepingWorkers.compare_exchange_weak(sleeping, sleeping - 1))
+                return;
+        }
+    }
+
+    wakeUp->wait();
+}
+
+void RenderWorkerPool::wakeWorkers(int count)
+{
+    int sleeping = sleepingWorkers.load();
+    int taken = 0;
+
+    do
+    {
+        taken = std::min(sleeping, count);
+        if (taken <= 0)
+            return;
+    }
+    while (!sleepingWorkers.compare_exchange_weak(sleeping, sleeping - taken));
+
+    wakeUp->post(taken);
+}
+
+bool RenderWorkerPool::runNextTask()
+{
+    auto state = jobState.load(std::memory_order_acquire);
+
+    while (getNextTask(state) < getNumTasks(state))
+    {
+        if (jobState.compare_exchange_weak(state, state + 1,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire))
+        {
+            // Workers render on behalf of the audio callback and obey the same rules
+            {
+                RealtimeGuard::ScopedRealtimeSection realtimeSection;
+                task(getNextTask(state));
+            }
+            completedTasks.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+} // namespace Kousaten
@@ -0,0 +1,73 @@
+/*
+    Kousaten Mixer - Render Worker Pool
+    Real-time helper threads that share independent render tasks with the audio thread
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Kousaten {
+
+class RenderWorkerPool
+{
+public:
+    static constexpr int MAX_WORKERS = 15;
+    static constexpr int MAX_TASKS = 0xffff;
+
+    // taskFunction(taskIndex) is called from the audio thread and from the workers.
+    // Each task index of a job runs exactly once, on whichever thread claims it.
+    explicit RenderWorkerPool(std::function<void(int)> taskFunction);
+    ~RenderWorkerPool();
+
+    // Start or stop helper threads (message thread). 0 = tasks run on the caller only.
+    // The block size and rate tell the OS scheduler how much work each period carries.
+    // Stopping waits for each worker to finish the task it is running.
+    void setNumWorkers(int numWorkers, int blockSize, double sampleRate);
+    int getNumWorkers() const { return numActiveWorkers.load(std::memory_order_relaxed); }
+
+    // Audio thread: run tasks [0, numTasks) on the calling thread plus any idle workers and
+    // return once all have finished. Lock-free: the caller claims whatever the workers have
+    // not, so it only ever waits for tasks that are already running.
+    void run(int numTasks);
+
+private:
+    class Worker;
+    class Semaphore;
+
+    // Claim and run one task of the current job; false once every task has been claimed
+    bool runNextTask();
+    bool hasUnclaimedTask() const;
+
+    // A worker with nothing to do blocks here until run() publishes a job or the pool
+    // stops it
+    void waitForWork(Worker& worker);
+
+    // Takes up to count sleeping workers off sleepingWorkers and posts one wake-up for each
+    void wakeWorkers(int count);
+
+    void stopWorkers();
+
+    std::function<void(int)> task;
+
+    // [generation:32][numTasks:16][nextTask:16] - one word so claims can never mix jobs
+    std::atomic<juce::uint64> jobState { 0 };
+    std::atomic<int> completedTasks { 0 };
+    juce::uint32 generation = 0;  // Audio thread only
+
+    std::vector<std::unique_ptr<Worker>> workers;  // Message thread only
+    std::atomic<int> numActiveWorkers { 0 };
+
+    // Every worker counted here is blocked on wakeUp or about to be; whoever takes one off
+    // the count owes it one post, so the semaphore never holds a stray wake-up
+    std::unique_ptr<Semaphore> wakeUp;
+    std::atomic<int> sleepingWorkers { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderWorkerPool)
+};
+
+} // namespace Kousaten
@@ -4,141 +4,360 @@
 */
 
 #include "RtAudioManager.h"
+#include <RtAudio.h>
+#include "RealtimeGuard.h"
+#include "InterleaveKernels.h"
+#include <algorithm>
+#include <thread>
 
 namespace Kousaten {
 
-// =============================================================================
-// RtOutputStream
-// =============================================================================
+namespace {
 
-RtOutputStream::RtOutputStream(unsigned int deviceId, unsigned int numChannels,
-                               unsigned int sampleRate, unsigned int bufferSize)
-    : deviceId(deviceId)
-    , numChannels(numChannels)
-    , sampleRate(sampleRate)
-    , bufferSize(bufferSize)
+// Enumerates RtAudio's devices for the manager's DeviceEnumerator. Keeps one RtAudio
+// instance, so device ids stay stable between scans. Streams open on instances of their
+// own, which number devices independently, so they look devices up by name.
+class RtAudioEnumerationBackend : public DeviceEnumerationBackend
 {
-    // Ring buffer: 8x buffer size for safety (more headroom)
-    ringBufferSize = bufferSize * numChannels * 8;
-    ringBuffer.resize(ringBufferSize, 0.0f);
-
-    // Initialize with zeros and set write position ahead
-    std::fill(ringBuffer.begin(), ringBuffer.end(), 0.0f);
-    writePos.store(bufferSize * numChannels * 2);  // Pre-fill 2 buffers of silence
-    readPos.store(0);
-
-    try
+public:
+    std::vector<EnumeratedDevice> listDevices() override
     {
-        RtAudio::StreamParameters outputParams;
-        outputParams.deviceId = deviceId;
-        outputParams.nChannels = numChannels;
-        outputParams.firstChannel = 0;
+        std::vector<EnumeratedDevice> listed;
 
-        RtAudio::StreamOptions options;
-        // Use RTAUDIO_SCHEDULE_REALTIME like VCV Rack, not MINIMIZE_LATENCY
-        options.flags = RTAUDIO_SCHEDULE_REALTIME;
-        options.numberOfBuffers = 2;  // VCV Rack uses 2 buffers
+        try
+        {
+            if (rtAudio == nullptr)
+                rtAudio = std::make_unique<RtAudio>();
 
-        unsigned int frames = bufferSize;
+            // RtAudio 6.x: ids and names come back in the same order
+            const auto ids = rtAudio->getDeviceIds();
+            const auto names = rtAudio->getDeviceNames();
+            const juce::String typeName = "RtAudio/" + juce::String(RtAudio::getApiName(rtAudio->getCurrentApi()));
 
-        rtAudio.openStream(&outputParams, nullptr, RTAUDIO_FLOAT32,
-                          sampleRate, &frames, &audioCallback, this, &options);
+            for (size_t i = 0; i < std::min(ids.size(), names.size()); ++i)
+            {
+                EnumeratedDevice device;
+                device.typeName = typeName;
+                device.name = juce::String(names[i]);
+                device.runtimeId = ids[i];
+                listed.push_back(device);
+            }
+        }
+        catch (RtAudioErrorType& e)
+        {
+            DBG("RtAudio error listing devices: " + juce::String(static_cast<int>(e)));
+        }
 
-        streamOpen = true;
-        DBG("RtOutputStream opened: device " + juce::String(deviceId) +
-            ", channels " + juce::String(numChannels));
-    }
-    catch (RtAudioErrorType& e)
-    {
-        DBG("RtAudio error opening stream: " + juce::String(static_cast<int>(e)));
-        streamOpen = false;
+        return listed;
     }
-}
 
-RtOutputStream::~RtOutputStream()
-{
-    stop();
-    if (streamOpen)
+    bool probeDevice(EnumeratedDevice& device) override
     {
         try
         {
-            rtAudio.closeStream();
+            const RtAudio::DeviceInfo info = rtAudio->getDeviceInfo(device.runtimeId);
+            if (info.ID == 0)
+                return false;
+
+            // RtAudio has no channel names
+            for (unsigned int ch = 0; ch < info.outputChannels; ++ch)
+                device.outputChannelNames.add("Output " + juce::String(ch + 1));
+            for (unsigned int ch = 0; ch < info.inputChannels; ++ch)
+                device.inputChannelNames.add("Input " + juce::String(ch + 1));
+
+            for (unsigned int rate : info.sampleRates)
+                device.sampleRates.add(rate);
+
+            device.isDefaultOutput = info.isDefaultOutput;
+            return true;
         }
         catch (...)
         {
-            // Ignore errors on close
+            return false;
         }
     }
-}
 
-bool RtOutputStream::start()
+private:
+    std::unique_ptr<RtAudio> rtAudio;
+};
+
+// One RtAudio stream, forwarding its callback to the RtOutputStream's
+class RtAudioStream : public AudioOutputBackend::Stream
 {
-    if (!streamOpen) return false;
+public:
+    RtAudioStream(AudioOutputBackend::RenderCallback renderCallback, void* renderUserData)
+        : callback(renderCallback), userData(renderUserData)
+    {
+    }
+
+    ~RtAudioStream() override
+    {
+        if (rtAudio.isStreamOpen())
+        {
+            try
+            {
+                rtAudio.closeStream();
+            }
+            catch (...)
+            {
+                // Ignore errors on close
+            }
+        }
+    }
 
-    try
+    bool open(const juce::String& deviceName, unsigned int listedId, unsigned int numChannels,
+              unsigned int sampleRate, unsigned int bufferSize)
     {
-        // Reset ring buffer positions (lock-free)
-        writePos.store(0, std::memory_order_release);
-        readPos.store(0, std::memory_order_release);
+        try
+        {
+            const unsigned int deviceId = findDeviceId(deviceName, listedId);
+            if (deviceId == 0)
+            {
+                DBG("RtAudio device not found: " + deviceName);
+                return false;
+            }
 
-        // Clear ring buffer (safe before stream starts)
-        std::fill(ringBuffer.begin(), ringBuffer.end(), 0.0f);
+            RtAudio::StreamParameters outputParams;
+            outputParams.deviceId = deviceId;
+            outputParams.nChannels = numChannels;
+            outputParams.firstChannel = 0;
 
-        // Enable fade-in to let hardware settle
-        fadeInCallbacksRemaining.store(fadeInCallbacks, std::memory_order_release);
+            RtAudio::StreamOptions options;
+            // Use RTAUDIO_SCHEDULE_REALTIME like VCV Rack, not MINIMIZE_LATENCY
+            options.flags = RTAUDIO_SCHEDULE_REALTIME;
+            options.numberOfBuffers = 2;  // VCV Rack uses 2 buffers
 
-        rtAudio.startStream();
-        streamRunning = true;
-        return true;
+            unsigned int frames = bufferSize;
+
+            rtAudio.openStream(&outputParams, nullptr, RTAUDIO_FLOAT32,
+                               sampleRate, &frames, &rtAudioCallback, this, &options);
+
+            if (!rtAudio.isStreamOpen())
+                return false;
+
+            latencyFrames = rtAudio.getStreamLatency();
+            return true;
+        }
+        catch (RtAudioErrorType& e)
+        {
+            DBG("RtAudio error opening stream: " + juce::String(static_cast<int>(e)));
+            return false;
+        }
     }
-    catch (RtAudioErrorType& e)
+
+    bool start() override
     {
-        DBG("RtAudio error starting stream: " + juce::String(static_cast<int>(e)));
-        return false;
+        try
+        {
+            rtAudio.startStream();
+            return true;
+        }
+        catch (RtAudioErrorType& e)
+        {
+            DBG("RtAudio error starting stream: " + juce::String(static_cast<int>(e)));
+            return false;
+        }
     }
-}
 
-void RtOutputStream::stop()
-{
-    if (streamRunning)
+    void stop() override
     {
         try
         {
             rtAudio.stopStream();
-            streamRunning = false;
         }
         catch (...)
         {
             // Ignore errors on stop
         }
     }
+
+    long getLatencyFrames() const override { return latencyFrames; }
+
+private:
+    RtAudio rtAudio;
+    long latencyFrames = 0;
+    AudioOutputBackend::RenderCallback callback;
+    void* userData;
+
+    // RtAudio 6.x numbers devices per instance in probe order, so after a hot-plug this
+    // instance and the enumerator's can give one device different ids. Takes the listed
+    // id if it still names the device here (two devices may share a name), else the
+    // first device with that name; 0 if there is none.
+    unsigned int findDeviceId(const juce::String& deviceName, unsigned int listedId)
+    {
+        const auto ids = rtAudio.getDeviceIds();
+        const auto names = rtAudio.getDeviceNames();
+        unsigned int found = 0;
+
+        for (size_t i = 0; i < std::min(ids.size(), names.size()); ++i)
+        {
+            if (juce::String(names[i]) != deviceName)
+                continue;
+
+            if (ids[i] == listedId)
+                return listedId;
+
+            if (found == 0)
+                found = ids[i];
+        }
+
+        return found;
+    }
+
+    static int rtAudioCallback(void* outputBuffer, void* /*inputBuffer*/,
+                               unsigned int nFrames, double /*streamTime*/,
+                               RtAudioStreamStatus /*status*/, void* streamData)
+    {
+        auto* stream = static_cast<RtAudioStream*>(streamData);
+        stream->callback(static_cast<float*>(outputBuffer), nFrames, stream->userData);
+        return 0;
+    }
+};
+
+} // namespace
+
+// =============================================================================
+// RtAudioOutputBackend
+// =============================================================================
+
+std::unique_ptr<DeviceEnumerationBackend> RtAudioOutputBackend::createEnumerationBackend()
+{
+    return std::make_unique<RtAudioEnumerationBackend>();
 }
 
-void RtOutputStream::writeBuffer(const float* left, const float* right, int numSamples)
+juce::File RtAudioOutputBackend::getCacheFile() const
+{
+    return DeviceEnumerator::getDefaultCacheDirectory().getChildFile("RtAudioDevices.json");
+}
+
+std::unique_ptr<AudioOutputBackend::Stream> RtAudioOutputBackend::openStream(const juce::String& deviceName,
+                                                                             unsigned int deviceId, unsigned int numChannels,
+                                                                             unsigned int sampleRate, unsigned int bufferSize,
+                                                                             RenderCallback callback, void* userData)
+{
+    auto stream = std::make_unique<RtAudioStream>(callback, userData);
+    if (!stream->open(deviceName, deviceId, numChannels, sampleRate, bufferSize))
+        return nullptr;
+
+    return stream;
+}
+
+// =============================================================================
+// RtOutputStream
+// =============================================================================
+
+RtOutputStream::RtOutputStream(AudioOutputBackend& backend, const juce::String& deviceName, unsigned int deviceId,
+                               unsigned int numChannels, unsigned int sampleRate, unsigned int bufferSize)
+    : deviceId(deviceId)
+    , numChannels(numChannels)
+    , sampleRate(sampleRate)
+    , bufferSize(bufferSize)
 {
-    // Lock-free write to ring buffer
-    size_t wp = writePos.load(std::memory_order_relaxed);
+    // Ring buffer: 8x buffer size for safety (more headroom)
+    ring.setSize(static_cast<size_t>(bufferSize) * numChannels * 8);
+    stagingBuffer.assign(static_cast<size_t>(bufferSize) * numChannels, 0.0f);
+
+    // Keep the ring half full: room for drift either way
+    resampler.prepare(static_cast<int>(numChannels), static_cast<int>(bufferSize), sampleRate,
+                      ring.getCapacity() / (2.0 * numChannels));
+
+    deviceStream = backend.openStream(deviceName, deviceId, numChannels, sampleRate, bufferSize, &audioCallback, this);
 
-    for (int i = 0; i < numSamples; ++i)
+    streamOpen = deviceStream != nullptr;
+    if (streamOpen)
     {
-        size_t pos = wp % ringBufferSize;
+        deviceLatencyFrames = deviceStream->getLatencyFrames();
+        DBG("RtOutputStream opened: device " + juce::String(deviceId) +
+            ", channels " + juce::String(numChannels) +
+            ", latency " + juce::String(deviceLatencyFrames));
+    }
+}
 
-        // Interleaved stereo
-        ringBuffer[pos] = left[i];
-        ringBuffer[(pos + 1) % ringBufferSize] = right[i];
+RtOutputStream::~RtOutputStream()
+{
+    stop();
+    deviceStream.reset();
+}
 
-        wp = (wp + 2) % ringBufferSize;
+int RtOutputStream::getLatencyFrames() const
+{
+    const double queued = resampler.getLatencyFrames();
+    if (queued <= 0.0)
+        return 0;
+
+    const long device = deviceLatencyFrames > 0 ? deviceLatencyFrames : static_cast<long>(bufferSize);
+    return juce::roundToInt(queued) + static_cast<int>(device);
+}
+
+bool RtOutputStream::start()
+{
+    if (!streamOpen) return false;
+
+    // Safe: the stream is not attached to a handle or running yet
+    ring.reset();
+    resampler.reset();
+    std::fill(stagingBuffer.begin(), stagingBuffer.end(), 0.0f);
+    stagedFrames = 0;
+    lastWriteFrames.store(0, std::memory_order_relaxed);
+
+    // Enable fade-in to let hardware settle
+    fadeInCallbacksRemaining.store(fadeInCallbacks, std::memory_order_release);
+
+    streamRunning = deviceStream->start();
+    return streamRunning;
+}
+
+void RtOutputStream::stop()
+{
+    if (streamRunning)
+    {
+        deviceStream->stop();
+        streamRunning = false;
     }
+}
+
+void RtOutputStream::writeBuffer(const float* left, const float* right, int numSamples,
+                                 int firstChannel, int numWriteChannels,
+                                 float startGain, float endGain)
+{
+    const int channels = static_cast<int>(numChannels);
+    const int frames = std::min(numSamples, static_cast<int>(bufferSize));
+    const float* sources[] = { left, right };
 
-    writePos.store(wp, std::memory_order_release);
+    // The part of the bus's channels that lands on the device
+    const int skipped = std::max(0, -firstChannel);
+    const int first = firstChannel + skipped;
+    const int count = std::min(std::min(numWriteChannels, 2) - skipped, channels - first);
+
+    // Mix (not copy), so buses sharing a channel add up as they do on the main outputs
+    if (count > 0)
+        Interleave::addWithRamp(sources + skipped, count, stagingBuffer.data() + first, channels,
+                                frames, startGain, endGain);
+
+    stagedFrames = std::max(stagedFrames, frames);
 }
 
-int RtOutputStream::audioCallback(void* outputBuffer, void* /*inputBuffer*/,
-                                  unsigned int nFrames, double /*streamTime*/,
-                                  RtAudioStreamStatus /*status*/, void* userData)
+void RtOutputStream::commitBlock()
 {
+    if (stagedFrames == 0)
+        return;
+
+    // One bulk write for all channels (dropped whole and counted as an overrun if the
+    // ring is full)
+    const size_t numSamples = static_cast<size_t>(stagedFrames) * numChannels;
+    ring.write(stagingBuffer.data(), numSamples);
+    std::fill_n(stagingBuffer.data(), numSamples, 0.0f);
+
+    lastWriteTicks.store(juce::Time::getHighResolutionTicks(), std::memory_order_relaxed);
+    lastWriteFrames.store(stagedFrames, std::memory_order_release);
+    stagedFrames = 0;
+}
+
+void RtOutputStream::audioCallback(float* out, unsigned int nFrames, void* userData)
+{
+    RealtimeGuard::ScopedRealtimeSection realtimeSection;
+
     auto* stream = static_cast<RtOutputStream*>(userData);
-    auto* out = static_cast<float*>(outputBuffer);
 
     // Check if we're in fade-in period (output silence to let hardware settle)
     size_t fadeRemaining = stream->fadeInCallbacksRemaining.load(std::memory_order_acquire);
@@ -148,24 +367,142 @@ int RtOutputStream::audioCallback(void* outputBuffer, void* /*inputBuffer*/,
         // Output silence during initial callbacks
         std::memset(out, 0, nFrames * stream->numChannels * sizeof(float));
         stream->fadeInCallbacksRemaining.store(fadeRemaining - 1, std::memory_order_release);
-        return 0;
+        return;
+    }
+
+    // Engine frames produced since its last write but not yet delivered
+    double producerLead = 0.0;
+    if (const int writeFrames = stream->lastWriteFrames.load(std::memory_order_acquire); writeFrames > 0)
+    {
+        const auto elapsedTicks = juce::Time::getHighResolutionTicks() - stream->lastWriteTicks.load(std::memory_order_relaxed);
+        producerLead = juce::jlimit(0.0, static_cast<double>(writeFrames),
+                                    juce::Time::highResolutionTicksToSeconds(elapsedTicks) * stream->sampleRate);
+    }
+
+    // Lock-free, drift-compensated read; a short ring is padded with silence and counted
+    // as an underrun
+    stream->resampler.process(stream->ring, out, static_cast<int>(nFrames), producerLead);
+}
+
+// =============================================================================
+// RtStreamHandle
+// =============================================================================
+
+RtOutputStream* RtStreamHandle::exchange(RtOutputStream* newStream)
+{
+    auto* previous = swap(newStream);
+    switching.store(false, std::memory_order_release);
+    return previous;
+}
+
+RtOutputStream* RtStreamHandle::crossfadeTo(RtOutputStream* newStream)
+{
+    startFadeOut();
+    waitUntilSilent();
+
+    // Nothing writes while the handle has no stream, so the gain can be reset for the
+    // fade-in here
+    auto* previous = swap(nullptr);
+    fadeGain.store(0.0f, std::memory_order_relaxed);
+    stream.store(newStream, std::memory_order_seq_cst);
+    switching.store(false, std::memory_order_release);
+
+    fadeTarget.store(1.0f, std::memory_order_release);
+    return previous;
+}
+
+void RtStreamHandle::startFadeOut()
+{
+    fadeTarget.store(0.0f, std::memory_order_release);
+}
+
+void RtStreamHandle::waitUntilSilent()
+{
+    // A bus that isn't being rendered never finishes its ramp; it isn't audible either
+    const auto deadline = juce::Time::getMillisecondCounterHiRes() + 100.0;
+
+    while (stream.load(std::memory_order_acquire) != nullptr
+           && fadeGain.load(std::memory_order_acquire) > 0.0f
+           && juce::Time::getMillisecondCounterHiRes() < deadline)
+    {
+        juce::Thread::sleep(1);
     }
+}
+
+RtOutputStream* RtStreamHandle::detachForSwitch()
+{
+    switching.store(true, std::memory_order_release);
+    return swap(nullptr);
+}
 
-    // Lock-free read from ring buffer
-    size_t rp = stream->readPos.load(std::memory_order_acquire);
-    const size_t totalSamples = nFrames * stream->numChannels;
+RtOutputStream* RtStreamHandle::swap(RtOutputStream* newStream)
+{
+    auto* previous = stream.exchange(newStream, std::memory_order_seq_cst);
 
-    for (unsigned int i = 0; i < totalSamples; ++i)
+    // Wait out a write that picked up the previous stream before the swap
+    if (previous != nullptr)
     {
-        size_t pos = rp % stream->ringBufferSize;
-        out[i] = stream->ringBuffer[pos];
-        stream->ringBuffer[pos] = 0.0f;  // Clear after reading
-        rp = (rp + 1) % stream->ringBufferSize;
+        while (streamInUse.load(std::memory_order_seq_cst) == previous)
+            std::this_thread::yield();
     }
 
-    stream->readPos.store(rp, std::memory_order_release);
+    // Nothing publishes without a stream, so the previous stream's figures can go
+    if (newStream == nullptr)
+    {
+        publishedOverruns.store(0, std::memory_order_relaxed);
+        publishedUnderruns.store(0, std::memory_order_relaxed);
+        publishedDriftPpm.store(0.0, std::memory_order_relaxed);
+        publishedLatencyFrames.store(0, std::memory_order_relaxed);
+    }
+
+    return previous;
+}
+
+void RtStreamHandle::publishStats(const RtOutputStream& current)
+{
+    publishedOverruns.store(current.getNumOverruns(), std::memory_order_relaxed);
+    publishedUnderruns.store(current.getNumUnderruns(), std::memory_order_relaxed);
+    publishedDriftPpm.store(current.getDriftPpm(), std::memory_order_relaxed);
+    publishedLatencyFrames.store(current.getLatencyFrames(), std::memory_order_relaxed);
+}
+
+RtStreamHandle::StreamStats RtStreamHandle::getStreamStats() const
+{
+    StreamStats stats;
+    stats.overruns = publishedOverruns.load(std::memory_order_relaxed);
+    stats.underruns = publishedUnderruns.load(std::memory_order_relaxed);
+    stats.driftPpm = publishedDriftPpm.load(std::memory_order_relaxed);
+    stats.latencyFrames = publishedLatencyFrames.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void RtStreamHandle::write(const float* left, const float* right, int numSamples,
+                           int firstChannel, int numChannels)
+{
+    access([&](RtOutputStream& current) {
+        // Step the gain towards its target by one block's share of FADE_MS
+        const float target = fadeTarget.load(std::memory_order_acquire);
+        const float startGain = fadeGain.load(std::memory_order_relaxed);
+        float endGain = target;
+
+        if (startGain != target)
+        {
+            const auto step = static_cast<float>(numSamples * 1000.0 / (FADE_MS * current.getSampleRate()));
+            endGain = target > startGain ? std::min(target, startGain + step)
+                                         : std::max(target, startGain - step);
+            fadeGain.store(endGain, std::memory_order_release);
+        }
+
+        if (startGain > 0.0f || endGain > 0.0f)
+            current.writeBuffer(left, right, numSamples, firstChannel, numChannels, startGain, endGain);
+
+        publishStats(current);
+    });
+}
 
-    return 0;
+void RtStreamHandle::commit()
+{
+    access([](RtOutputStream& current) { current.commitBlock(); });
 }
 
 // =============================================================================
@@ -173,68 +510,90 @@ int RtOutputStream::audioCallback(void* outputBuffer, void* /*inputBuffer*/,
 // =============================================================================
 
 RtAudioManager::RtAudioManager()
+    : backend(std::make_unique<RtAudioOutputBackend>())
+    , controlThread([this] { runControlThread(); })
 {
 }
 
 RtAudioManager::~RtAudioManager()
 {
+    {
+        std::lock_guard<std::mutex> lock(operationMutex);
+        stopControlThread = true;
+        pendingOperations.clear();
+    }
+    operationCondition.notify_all();
+    controlThread.join();
+
+    deviceEnumerator.reset();
+
     stopAll();
-    streams.clear();
+
+    for (auto& handle : commitHandles)
+        handle.exchange(nullptr);
+
+    deviceStreams.clear();
+}
+
+void RtAudioManager::setBackend(std::unique_ptr<AudioOutputBackend> newBackend)
+{
+    jassert(deviceEnumerator == nullptr && deviceStreams.empty());
+    backend = std::move(newBackend);
 }
 
 void RtAudioManager::initialize()
 {
-    scanDevices();
+    if (deviceEnumerator != nullptr)
+        return;
+
+    deviceEnumerator = std::make_unique<DeviceEnumerator>(backend->createEnumerationBackend(),
+                                                          backend->getCacheFile());
+
+    deviceEnumerator->onDevicesChanged = [this](const DeviceEnumerator::Changes& changes) {
+        for (const auto& key : changes.removed)
+            DBG("RtAudio device removed: " + key);
+        for (const auto& device : changes.added)
+            DBG("RtAudio device found: " + device.name + " (" + juce::String(device.outputChannelNames.size()) + " out)");
+
+        updateDevices();
+    };
+
+    // The cached list is usable right away; scans update it from the enumerator's thread
+    deviceEnumerator->start();
+    updateDevices();
 }
 
-void RtAudioManager::scanDevices()
+void RtAudioManager::updateDevices()
 {
-    std::lock_guard<std::mutex> lock(deviceMutex);
-    devices.clear();
+    if (deviceEnumerator == nullptr)
+        return;
+
+    std::vector<RtDeviceInfo> outputDevices;
 
-    try
+    for (const auto& device : deviceEnumerator->getDevices())
     {
-        RtAudio rtAudio;
+        if (device.outputChannelNames.isEmpty())
+            continue;
 
-        // RtAudio 6.x: use getDeviceIds() instead of iterating by index
-        std::vector<unsigned int> deviceIds = rtAudio.getDeviceIds();
+        RtDeviceInfo deviceInfo;
+        deviceInfo.id = device.runtimeId;
+        deviceInfo.name = device.name;
+        deviceInfo.outputChannels = static_cast<unsigned int>(device.outputChannelNames.size());
+        deviceInfo.inputChannels = static_cast<unsigned int>(device.inputChannelNames.size());
+        deviceInfo.isDefault = device.isDefaultOutput;
 
-        for (unsigned int deviceId : deviceIds)
-        {
-            try
-            {
-                RtAudio::DeviceInfo info = rtAudio.getDeviceInfo(deviceId);
-
-                if (info.outputChannels > 0)
-                {
-                    RtDeviceInfo deviceInfo;
-                    deviceInfo.id = deviceId;
-                    deviceInfo.name = juce::String(info.name);
-                    deviceInfo.outputChannels = info.outputChannels;
-                    deviceInfo.inputChannels = info.inputChannels;
-                    deviceInfo.isDefault = info.isDefaultOutput;
-
-                    for (unsigned int rate : info.sampleRates)
-                    {
-                        deviceInfo.sampleRates.push_back(rate);
-                    }
-
-                    devices.push_back(deviceInfo);
-
-                    DBG("RtAudio device found: " + deviceInfo.name +
-                        " (" + juce::String(deviceInfo.outputChannels) + " out)");
-                }
-            }
-            catch (...)
-            {
-                // Skip devices that can't be queried
-            }
-        }
+        for (double rate : device.sampleRates)
+            deviceInfo.sampleRates.push_back(static_cast<unsigned int>(rate));
+
+        outputDevices.push_back(deviceInfo);
     }
-    catch (RtAudioErrorType& e)
+
     {
-        DBG("RtAudio error scanning devices: " + juce::String(static_cast<int>(e)));
+        std::lock_guard<std::mutex> lock(deviceMutex);
+        devices = std::move(outputDevices);
     }
+
+    deviceListVersion.fetch_add(1, std::memory_order_acq_rel);
 }
 
 std::vector<RtDeviceInfo> RtAudioManager::getOutputDevices() const
@@ -269,135 +628,317 @@ RtDeviceInfo RtAudioManager::getDeviceInfo(const juce::String& deviceName) const
     return {};
 }
 
-int RtAudioManager::createOutputStream(const juce::String& deviceName,
-                                       unsigned int channelOffset,
-                                       unsigned int numChannels)
+RtAudioManager::DeviceStream* RtAudioManager::findDeviceStream(const juce::String& deviceName) const
 {
-    std::lock_guard<std::mutex> lock(streamMutex);
+    for (const auto& device : deviceStreams)
+    {
+        if (device->deviceName == deviceName)
+            return device.get();
+    }
 
+    return nullptr;
+}
+
+RtAudioManager::DeviceStream* RtAudioManager::findDeviceStream(const RtStreamHandle& handle) const
+{
+    for (const auto& device : deviceStreams)
+    {
+        if (std::find(device->handles.begin(), device->handles.end(), &handle) != device->handles.end())
+            return device.get();
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<RtOutputStream> RtAudioManager::openStream(const juce::String& deviceName)
+{
     // Find device by name
-    unsigned int deviceId = 0;
+    RtDeviceInfo deviceInfo {};
     bool found = false;
 
-    {
+    auto findDevice = [&] {
         std::lock_guard<std::mutex> devLock(deviceMutex);
         for (const auto& device : devices)
         {
             if (device.name == deviceName)
             {
-                deviceId = device.id;
+                deviceInfo = device;
                 found = true;
                 break;
             }
         }
+    };
+
+    findDevice();
+
+    // Plugged in since the last scan, or listed from the cache but not scanned yet this
+    // session (its id is still unknown)
+    if ((!found || deviceInfo.id == 0) && deviceEnumerator != nullptr)
+    {
+        deviceEnumerator->scanNow();
+        updateDevices();
+        found = false;
+        findDevice();
     }
 
-    if (!found)
+    if (!found || deviceInfo.id == 0)
     {
         DBG("RtAudioManager: Device not found: " + deviceName);
-        return -1;
+        return nullptr;
     }
 
-    auto stream = std::make_unique<RtOutputStream>(deviceId, numChannels,
-                                                    sampleRate, bufferSize);
+    // All of the device's outputs, so any aux bus can use any channel without a reopen
+    auto stream = std::make_unique<RtOutputStream>(*backend, deviceName, deviceInfo.id,
+                                                    deviceInfo.outputChannels, sampleRate, bufferSize);
 
-    if (!stream->isOpen())
+    if (!stream->isOpen() || !stream->start())
     {
         DBG("RtAudioManager: Failed to open stream for: " + deviceName);
-        return -1;
+        return nullptr;
     }
 
-    stream->setChannelOffset(channelOffset);
+    DBG("RtAudioManager: Opened " + juce::String(deviceInfo.outputChannels) +
+        "-channel stream for device: " + deviceName);
 
-    int streamId = nextStreamId++;
-    streams[streamId] = std::move(stream);
+    return stream;
+}
 
-    DBG("RtAudioManager: Created stream " + juce::String(streamId) +
-        " for device: " + deviceName);
+bool RtAudioManager::reopenDevice(DeviceStream& device)
+{
+    auto& commitHandle = commitHandles[static_cast<size_t>(device.commitSlot)];
 
-    return streamId;
+    // Open the replacement first, so the device's feeds only pause for their fades
+    auto replacement = openStream(device.deviceName);
+
+    // Fade every bus on the device out together
+    for (auto* handle : device.handles)
+        handle->startFadeOut();
+    for (auto* handle : device.handles)
+        handle->waitUntilSilent();
+
+    if (replacement == nullptr)
+    {
+        // Device may not allow a second stream: take the feeds down while reopening
+        commitHandle.detachForSwitch();
+        for (auto* handle : device.handles)
+            handle->detachForSwitch();
+
+        takeStream(device, nullptr).reset();
+        replacement = openStream(device.deviceName);
+    }
+
+    // Commits move first, so the new stream never stages more than one block before
+    // it is committed; the buses fade back in on it
+    auto* newStream = replacement.get();
+    commitHandle.exchange(newStream);
+    for (auto* handle : device.handles)
+        handle->crossfadeTo(newStream);
+
+    // The old stream (if it is still open) closes here, outside the list lock
+    takeStream(device, std::move(replacement));
+    return newStream != nullptr;
 }
 
-void RtAudioManager::destroyOutputStream(int streamId)
+std::unique_ptr<RtOutputStream> RtAudioManager::takeStream(DeviceStream& device, std::unique_ptr<RtOutputStream> newStream)
 {
     std::lock_guard<std::mutex> lock(streamMutex);
+    std::swap(device.stream, newStream);
+    return newStream;
+}
+
+void RtAudioManager::closeDevice(DeviceStream* device)
+{
+    commitHandles[static_cast<size_t>(device->commitSlot)].exchange(nullptr);
+    for (auto* handle : device->handles)
+        handle->exchange(nullptr);
+
+    DBG("RtAudioManager: Closing stream for device: " + device->deviceName);
 
-    auto it = streams.find(streamId);
-    if (it != streams.end())
+    std::unique_ptr<DeviceStream> closed;
     {
-        it->second->stop();
-        streams.erase(it);
-        DBG("RtAudioManager: Destroyed stream " + juce::String(streamId));
+        std::lock_guard<std::mutex> lock(streamMutex);
+        auto entry = std::find_if(deviceStreams.begin(), deviceStreams.end(),
+                                  [device](const auto& d) { return d.get() == device; });
+        closed = std::move(*entry);
+        deviceStreams.erase(entry);
     }
+
+    // Stopping and closing the device can block, so it happens once the list is unlocked
+    closed.reset();
 }
 
-void RtAudioManager::writeToStream(int streamId, const float* left,
-                                   const float* right, int numSamples)
+void RtAudioManager::leaveDevice(DeviceStream* device, RtStreamHandle& handle)
 {
-    // Lock-free check: only write if streams are active
-    if (!streamsActive.load(std::memory_order_acquire))
-        return;
+    auto& handles = device->handles;
+    handles.erase(std::find(handles.begin(), handles.end(), &handle));
 
-    // Fast path: try lock, if fails, skip this write (audio continues without glitch)
-    std::unique_lock<std::mutex> lock(streamMutex, std::try_to_lock);
-    if (!lock.owns_lock())
-        return;
+    if (handles.empty())
+        closeDevice(device);
+}
+
+bool RtAudioManager::attachToDevice(RtStreamHandle& handle, const juce::String& deviceName)
+{
+    // Opening, fading and closing all happen under switchMutex alone; streamMutex is only
+    // taken for the moment the list or a device's stream changes
+    std::lock_guard<std::mutex> lock(switchMutex);
 
-    auto it = streams.find(streamId);
-    if (it != streams.end())
+    auto* previous = findDeviceStream(handle);
+    auto* device = findDeviceStream(deviceName);
+
+    if (device == nullptr)
     {
-        it->second->writeBuffer(left, right, numSamples);
+        int freeSlot = -1;
+        for (int slot = 0; slot < MAX_DEVICE_STREAMS && freeSlot < 0; ++slot)
+        {
+            if (commitHandles[static_cast<size_t>(slot)].get() == nullptr)
+                freeSlot = slot;
+        }
+
+        auto stream = freeSlot >= 0 ? openStream(deviceName) : nullptr;
+        if (stream == nullptr)
+        {
+            handle.crossfadeTo(nullptr);
+            if (previous != nullptr)
+                leaveDevice(previous, handle);
+            return false;
+        }
+
+        auto newDevice = std::make_unique<DeviceStream>();
+        newDevice->deviceName = deviceName;
+        newDevice->stream = std::move(stream);
+        newDevice->commitSlot = freeSlot;
+        commitHandles[static_cast<size_t>(freeSlot)].exchange(newDevice->stream.get());
+
+        device = newDevice.get();
+
+        std::lock_guard<std::mutex> listLock(streamMutex);
+        deviceStreams.push_back(std::move(newDevice));
     }
+    else if (device->stream->getSampleRate() != sampleRate || device->stream->getBufferSize() != bufferSize)
+    {
+        // Format changed: every bus on the device moves to the reopened stream together
+        if (!reopenDevice(*device))
+        {
+            closeDevice(device);
+            if (previous != device)
+            {
+                handle.crossfadeTo(nullptr);
+                if (previous != nullptr)
+                    leaveDevice(previous, handle);
+            }
+            return false;
+        }
+    }
+
+    if (previous == device)
+        return true;
+
+    // Fade the bus out of the previous device and into this one before leaving the
+    // previous one (which may close it)
+    handle.crossfadeTo(device->stream.get());
+    device->handles.push_back(&handle);
+
+    if (previous != nullptr)
+        leaveDevice(previous, handle);
+
+    return true;
 }
 
-void RtAudioManager::startAll()
+void RtAudioManager::detachFromDevice(RtStreamHandle& handle, bool fadeOut)
+{
+    std::lock_guard<std::mutex> lock(switchMutex);
+
+    if (fadeOut)
+        handle.crossfadeTo(nullptr);
+    else
+        handle.exchange(nullptr);
+
+    if (auto* device = findDeviceStream(handle))
+        leaveDevice(device, handle);
+}
+
+bool RtAudioManager::isDeviceOpen(const juce::String& deviceName) const
 {
     std::lock_guard<std::mutex> lock(streamMutex);
 
-    for (auto& pair : streams)
-    {
-        pair.second->start();
-    }
+    auto* device = findDeviceStream(deviceName);
+    return device != nullptr && device->stream != nullptr;
+}
 
-    streamsActive.store(true, std::memory_order_release);
-    DBG("RtAudioManager: Started all streams");
+void RtAudioManager::commitBlocks()
+{
+    for (auto& handle : commitHandles)
+        handle.commit();
 }
 
 void RtAudioManager::stopAll()
 {
-    // First, signal that streams are no longer active (lock-free)
-    streamsActive.store(false, std::memory_order_release);
+    // Stopped streams only stop reading their rings, so this never races the audio thread
+    std::lock_guard<std::mutex> lock(switchMutex);
 
-    // Small delay to let audio callbacks finish
-    juce::Thread::sleep(10);
+    for (auto& device : deviceStreams)
+    {
+        if (device->stream != nullptr)
+            device->stream->stop();
+    }
 
-    // Now safe to acquire lock and stop streams
-    std::lock_guard<std::mutex> lock(streamMutex);
+    DBG("RtAudioManager: Stopped all streams");
+}
 
-    for (auto& pair : streams)
+void RtAudioManager::switchDeviceAsync(const void* owner, std::function<bool()> operation,
+                                       std::function<void(bool)> onComplete)
+{
     {
-        pair.second->stop();
+        std::lock_guard<std::mutex> lock(operationMutex);
+
+        // Only the latest request from an owner matters; one already running still finishes
+        pendingOperations.erase(std::remove_if(pendingOperations.begin(), pendingOperations.end(),
+                                               [owner](const auto& op) { return op.owner == owner; }),
+                                pendingOperations.end());
+
+        pendingOperations.push_back({ owner, std::move(operation), std::move(onComplete) });
     }
 
-    DBG("RtAudioManager: Stopped all streams");
+    operationCondition.notify_all();
+}
+
+void RtAudioManager::cancelDeviceOperations(const void* owner)
+{
+    std::unique_lock<std::mutex> lock(operationMutex);
+
+    pendingOperations.erase(std::remove_if(pendingOperations.begin(), pendingOperations.end(),
+                                           [owner](const auto& op) { return op.owner == owner; }),
+                            pendingOperations.end());
+
+    operationCondition.wait(lock, [this, owner] { return runningOwner != owner; });
 }
 
-void RtAudioManager::switchDeviceAsync(std::function<void()> switchOperation)
+void RtAudioManager::runControlThread()
 {
-    // Execute on message thread to avoid blocking UI
-    juce::MessageManager::callAsync([this, switchOperation]() {
-        // Stop streams first (non-blocking for audio thread)
-        stopAll();
+    std::unique_lock<std::mutex> lock(operationMutex);
 
-        // Additional delay for hardware to settle
-        juce::Thread::sleep(50);
+    while (true)
+    {
+        operationCondition.wait(lock, [this] { return stopControlThread || !pendingOperations.empty(); });
+        if (stopControlThread)
+            return;
 
-        // Perform the switch operation
-        switchOperation();
+        auto op = std::move(pendingOperations.front());
+        pendingOperations.pop_front();
+        runningOwner = op.owner;
+        lock.unlock();
 
-        // Start streams again
-        startAll();
-    });
+        // Opening, closing and fading happen here; the audio thread keeps rendering and
+        // only the streams the operation touches are interrupted
+        const bool result = op.operation();
+
+        if (op.onComplete)
+            juce::MessageManager::callAsync([onComplete = std::move(op.onComplete), result] { onComplete(result); });
+
+        lock.lock();
+        runningOwner = nullptr;
+        operationCondition.notify_all();
+    }
 }
 
 } // namespace Kousaten
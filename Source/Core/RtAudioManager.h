@@ -5,15 +5,20 @@
 
 #pragma once
 
-#include <RtAudio.h>
 #include <JuceHeader.h>
-#include <map>
+#include "AudioRingBuffer.h"
+#include "AdaptiveResampler.h"
+#include "AudioOutputBackend.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <vector>
 #include <atomic>
 #include <cstring>
 #include <functional>
+#include <thread>
 
 namespace Kousaten {
 
@@ -28,49 +33,199 @@ struct RtDeviceInfo
     bool isDefault;
 };
 
-// A single output stream to a device
+// The output stream to one device, carrying all of its channels. Every aux bus on the
+// device mixes its block into a shared staging block at its own channels; the engine then
+// commits the staged block to the ring once, so the channels stay sample-aligned.
 class RtOutputStream
 {
 public:
-    RtOutputStream(unsigned int deviceId, unsigned int numChannels,
-                   unsigned int sampleRate, unsigned int bufferSize);
+    RtOutputStream(AudioOutputBackend& backend, const juce::String& deviceName, unsigned int deviceId,
+                   unsigned int numChannels, unsigned int sampleRate, unsigned int bufferSize);
     ~RtOutputStream();
 
     bool isOpen() const { return streamOpen; }
+
+    // Start resets the ring, so call it before the stream is attached to an RtStreamHandle
     bool start();
     void stop();
 
-    // Write audio data to the output buffer
-    void writeBuffer(const float* left, const float* right, int numSamples);
+    // Audio thread: mix one or two channels into the staging block, starting at
+    // firstChannel (channels outside the device are skipped), under a linear gain ramp.
+    // Blocks longer than the stream's buffer size are truncated.
+    void writeBuffer(const float* left, const float* right, int numSamples,
+                     int firstChannel, int numWriteChannels,
+                     float startGain = 1.0f, float endGain = 1.0f);
+
+    // Audio thread: hand the staged block to the device callback and clear it
+    void commitBlock();
+
+    // Ring health: blocks dropped because the ring was full (device consuming too slowly)
+    // and dropouts where the device callback found too little data (feeding too slowly)
+    int getNumOverruns() const { return ring.getNumOverruns(); }
+    int getNumUnderruns() const { return ring.getNumUnderruns(); }
+    int getFillLevelFrames() const { return static_cast<int>(ring.getNumReady() / numChannels); }
+
+    // Clock drift of the device against the engine, as measured by the resampler (ppm,
+    // positive when the device runs fast), and the ratio currently compensating it
+    double getDriftPpm() const { return resampler.getDriftPpm(); }
+    double getResampleRatio() const { return resampler.getRatio(); }
+
+    // Engine-to-output latency in frames: what the ring and resampler hold (measured)
+    // plus the device's own reported latency, or one buffer if it reports none.
+    // 0 until the stream has been fed.
+    int getLatencyFrames() const;
 
     unsigned int getDeviceId() const { return deviceId; }
     unsigned int getNumChannels() const { return numChannels; }
-    unsigned int getChannelOffset() const { return channelOffset; }
-    void setChannelOffset(unsigned int offset) { channelOffset = offset; }
+    unsigned int getSampleRate() const { return sampleRate; }
+    unsigned int getBufferSize() const { return bufferSize; }
 
 private:
-    RtAudio rtAudio;
+    std::unique_ptr<AudioOutputBackend::Stream> deviceStream;  // nullptr if the device didn't open
     unsigned int deviceId;
     unsigned int numChannels;
-    unsigned int channelOffset = 0;
     unsigned int sampleRate;
     unsigned int bufferSize;
     bool streamOpen = false;
     bool streamRunning = false;
+    long deviceLatencyFrames = 0;  // As reported by the device once open
 
-    // Lock-free ring buffer for audio data (no mutex in audio callback!)
-    std::vector<float> ringBuffer;
-    std::atomic<size_t> writePos{0};
-    std::atomic<size_t> readPos{0};
-    size_t ringBufferSize;
+    // Interleaved samples from the engine's audio thread to the device callback
+    AudioRingBuffer ring;
+
+    // Writer side: the block being assembled from the aux buses, interleaved
+    std::vector<float> stagingBuffer;
+    int stagedFrames = 0;
+
+    // Reads the ring at the device's clock rate; the last write's time and length let it
+    // see how far the engine is into its next block
+    AdaptiveResampler resampler;
+    std::atomic<juce::int64> lastWriteTicks { 0 };
+    std::atomic<int> lastWriteFrames { 0 };
 
     // Fade-in to prevent pop/click at stream start (count in callbacks, not samples)
     std::atomic<size_t> fadeInCallbacksRemaining{0};
     static constexpr size_t fadeInCallbacks = 4;  // 4 callbacks of silence (~40ms at 512 buffer/48kHz)
 
-    static int audioCallback(void* outputBuffer, void* inputBuffer,
-                            unsigned int nFrames, double streamTime,
-                            RtAudioStreamStatus status, void* userData);
+    static void audioCallback(float* output, unsigned int nFrames, void* userData);
+};
+
+// Real devices through RtAudio (the manager's default backend)
+class RtAudioOutputBackend : public AudioOutputBackend
+{
+public:
+    std::unique_ptr<DeviceEnumerationBackend> createEnumerationBackend() override;
+    juce::File getCacheFile() const override;
+    std::unique_ptr<Stream> openStream(const juce::String& deviceName, unsigned int deviceId,
+                                       unsigned int numChannels,
+                                       unsigned int sampleRate, unsigned int bufferSize,
+                                       RenderCallback callback, void* userData) override;
+};
+
+// The audio thread's wait-free reference to an output stream. The control thread swaps
+// streams in and out; the audio thread never blocks, locks or searches to reach one.
+class RtStreamHandle
+{
+public:
+    // Length of the ramps around a crossfadeTo()
+    static constexpr double FADE_MS = 10.0;
+
+    RtStreamHandle() = default;
+
+    // Control thread: publish a stream (or nullptr) and return the previous one. Returns
+    // once the audio thread has finished any write to the previous stream, so the caller
+    // may destroy it straight away.
+    RtOutputStream* exchange(RtOutputStream* newStream);
+
+    // Control thread: like exchange(), but ramp this handle's writes down before leaving
+    // the previous stream and back up on the new one, so neither device clicks. Blocks
+    // for the fade-out (at most a few blocks).
+    RtOutputStream* crossfadeTo(RtOutputStream* newStream);
+
+    // Control thread: the two halves of a fade-out, so several handles can fade together.
+    // waitUntilSilent() gives up after a while if no blocks are being written.
+    void startFadeOut();
+    void waitUntilSilent();
+
+    // Control thread: like exchange(nullptr), for when the feed must go down while its
+    // stream is replaced; blocks written until the next exchange() are counted as dropped
+    RtOutputStream* detachForSwitch();
+
+    // Audio thread: mix one block into the current stream's staging block, if any
+    void write(const float* left, const float* right, int numSamples,
+               int firstChannel, int numChannels);
+
+    // Audio thread: commit the current stream's staged block
+    void commit();
+
+    RtOutputStream* get() const { return stream.load(std::memory_order_relaxed); }
+
+    bool hasStream() const { return stream.load(std::memory_order_relaxed) != nullptr; }
+
+    // Blocks the audio thread could not deliver (stream being switched)
+    int getNumDroppedBlocks() const { return droppedBlocks.load(std::memory_order_relaxed); }
+
+    // Health of the stream as of the handle's last write, copied out by the audio thread
+    // so other threads never reach a stream the control thread may be closing (any
+    // thread; all 0 while the handle has no stream)
+    struct StreamStats
+    {
+        int overruns = 0;
+        int underruns = 0;
+        double driftPpm = 0.0;
+        int latencyFrames = 0;
+    };
+
+    StreamStats getStreamStats() const;
+
+private:
+    std::atomic<RtOutputStream*> stream { nullptr };
+    std::atomic<RtOutputStream*> streamInUse { nullptr };  // Stream the audio thread is writing to
+    std::atomic<bool> switching { false };
+    std::atomic<int> droppedBlocks { 0 };
+
+    // Write gain ramps towards fadeTarget; only the audio thread moves fadeGain while a
+    // stream is attached
+    std::atomic<float> fadeTarget { 1.0f };
+    std::atomic<float> fadeGain { 1.0f };
+
+    // Published by write(), cleared when the handle is left without a stream
+    std::atomic<int> publishedOverruns { 0 };
+    std::atomic<int> publishedUnderruns { 0 };
+    std::atomic<double> publishedDriftPpm { 0.0 };
+    std::atomic<int> publishedLatencyFrames { 0 };
+
+    RtOutputStream* swap(RtOutputStream* newStream);
+    void publishStats(const RtOutputStream& current);
+
+    // Run fn on the current stream unless it is being swapped out; returns false if the
+    // block was dropped (or there was no stream)
+    template <typename Function>
+    bool access(Function&& fn)
+    {
+        auto* current = stream.load(std::memory_order_acquire);
+        if (current == nullptr)
+        {
+            if (switching.load(std::memory_order_acquire))
+                droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Announce the access, then confirm the stream was not swapped out in between;
+        // if it was, the control thread may already be destroying it, so skip this block
+        streamInUse.store(current, std::memory_order_seq_cst);
+
+        const bool stillCurrent = stream.load(std::memory_order_seq_cst) == current;
+        if (stillCurrent)
+            fn(*current);
+        else
+            droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+
+        streamInUse.store(nullptr, std::memory_order_release);
+        return stillCurrent;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(RtStreamHandle)
 };
 
 // Manages multiple RtAudio output streams
@@ -80,9 +235,18 @@ public:
     RtAudioManager();
     ~RtAudioManager();
 
-    // Initialize and scan for devices
+    // Message thread, before initialize(): replace the RtAudio backend, e.g. with a
+    // VirtualOutputBackend for headless tests
+    void setBackend(std::unique_ptr<AudioOutputBackend> newBackend);
+    AudioOutputBackend& getBackend() { return *backend; }
+
+    // Message thread: list the devices from the cache straight away and keep the list
+    // current from a background scan (hot-plugged devices show up within a few seconds)
     void initialize();
 
+    // Counter that moves whenever the device list changes, for UIs to poll
+    int getDeviceListVersion() const { return deviceListVersion.load(std::memory_order_acquire); }
+
     // Get available output devices
     std::vector<RtDeviceInfo> getOutputDevices() const;
     juce::StringArray getOutputDeviceNames() const;
@@ -90,21 +254,40 @@ public:
     // Get device info by name
     RtDeviceInfo getDeviceInfo(const juce::String& deviceName) const;
 
-    // Create/destroy output streams
-    int createOutputStream(const juce::String& deviceName,
-                          unsigned int channelOffset = 0,
-                          unsigned int numChannels = 2);
-    void destroyOutputStream(int streamId);
+    // Most devices open at once, each with one stream shared by all of its aux buses
+    static constexpr int MAX_DEVICE_STREAMS = 16;
+
+    // Control thread: point handle at the shared stream for deviceName, opening the device
+    // (with all its output channels) on first use, or reopening it if the sample rate or
+    // buffer size changed since. A handle attached elsewhere crossfades over; other
+    // devices are not touched. Returns false, leaving the handle detached, if the device
+    // could not be opened.
+    bool attachToDevice(RtStreamHandle& handle, const juce::String& deviceName);
+
+    // Control thread: detach handle (fading it out unless its writes have already
+    // stopped); the device closes with its last handle
+    void detachFromDevice(RtStreamHandle& handle, bool fadeOut = true);
 
-    // Write to a stream (lock-free, safe from audio thread)
-    void writeToStream(int streamId, const float* left, const float* right, int numSamples);
+    // Whether deviceName has an open stream (any thread). Its health is read through the
+    // handles routed to it; the stream itself is never handed out.
+    bool isDeviceOpen(const juce::String& deviceName) const;
+
+    // Audio thread: commit the block every open stream has staged (call once per block,
+    // after all aux buses have written)
+    void commitBlocks();
 
-    // Start/stop all streams
-    void startAll();
     void stopAll();
 
-    // Async device switching (call from message thread)
-    void switchDeviceAsync(std::function<void()> switchOperation);
+    // Message thread: queue a device operation (attach/detach calls) for the manager's
+    // control thread, so opening and closing devices never blocks the UI. Operations run
+    // one at a time; a newer one from the same owner replaces one still queued.
+    // onComplete receives the operation's result on the message thread.
+    void switchDeviceAsync(const void* owner, std::function<bool()> operation,
+                           std::function<void(bool)> onComplete = nullptr);
+
+    // Message thread: drop owner's queued operations and wait for one already running
+    // (call before destroying anything an operation refers to)
+    void cancelDeviceOperations(const void* owner);
 
     // Set global sample rate and buffer size
     void setSampleRate(unsigned int rate) { sampleRate = rate; }
@@ -113,20 +296,67 @@ public:
     unsigned int getBufferSize() const { return bufferSize; }
 
 private:
+    // An open device and the handles routed to it (under switchMutex; changes to the list
+    // and to stream also take streamMutex)
+    struct DeviceStream
+    {
+        juce::String deviceName;
+        std::unique_ptr<RtOutputStream> stream;
+        std::vector<RtStreamHandle*> handles;
+        int commitSlot = -1;
+    };
+
+    std::unique_ptr<AudioOutputBackend> backend;
+
     std::vector<RtDeviceInfo> devices;
-    std::map<int, std::unique_ptr<RtOutputStream>> streams;
-    int nextStreamId = 0;
+    std::atomic<int> deviceListVersion { 0 };
+    std::unique_ptr<DeviceEnumerator> deviceEnumerator;
+
+    std::vector<std::unique_ptr<DeviceStream>> deviceStreams;
+
+    // What commitBlocks() walks: one handle per open device, in a fixed array so the
+    // audio thread never sees the list change shape
+    std::array<RtStreamHandle, MAX_DEVICE_STREAMS> commitHandles;
 
-    unsigned int sampleRate = 48000;
-    unsigned int bufferSize = 512;
+    // Set on the message thread, read by the control thread
+    std::atomic<unsigned int> sampleRate { 48000 };
+    std::atomic<unsigned int> bufferSize { 512 };
 
+    // Never taken by the audio thread. switchMutex is held for a whole device operation
+    // (opens, fades, closes); streamMutex only while deviceStreams or a device's stream
+    // pointer changes, so isDeviceOpen() never waits for a device.
     mutable std::mutex deviceMutex;
+    std::mutex switchMutex;
     mutable std::mutex streamMutex;
 
-    // Atomic flag for safe stream access from audio thread
-    std::atomic<bool> streamsActive{false};
+    // Control thread and its queue
+    struct DeviceOperation
+    {
+        const void* owner = nullptr;
+        std::function<bool()> operation;
+        std::function<void(bool)> onComplete;
+    };
+
+    std::deque<DeviceOperation> pendingOperations;
+    const void* runningOwner = nullptr;
+    bool stopControlThread = false;
+    std::mutex operationMutex;
+    std::condition_variable operationCondition;
+    std::thread controlThread;
+
+    void runControlThread();
+
+    // Rebuild devices from the enumerator's list (any thread)
+    void updateDevices();
 
-    void scanDevices();
+    // Under switchMutex (or streamMutex, for the finds)
+    DeviceStream* findDeviceStream(const juce::String& deviceName) const;
+    DeviceStream* findDeviceStream(const RtStreamHandle& handle) const;
+    std::unique_ptr<RtOutputStream> openStream(const juce::String& deviceName);
+    bool reopenDevice(DeviceStream& device);
+    std::unique_ptr<RtOutputStream> takeStream(DeviceStream& device, std::unique_ptr<RtOutputStream> newStream);
+    void closeDevice(DeviceStream* device);
+    void leaveDevice(DeviceStream* device, RtStreamHandle& handle);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RtAudioManager)
 };
@@ -0,0 +1,268 @@
+/*
+    Kousaten Mixer - Virtual Output Backend
+    Implementation
+*/
+
+#include "VirtualOutputBackend.h"
+#include "InterleaveKernels.h"
+#include <thread>
+
+namespace Kousaten {
+
+// A device callback clocked by its own thread: deadlines advance by one buffer at the
+// device's (drifted) rate, the thread waits most of the way to each and yields the rest
+class VirtualOutputBackend::VirtualStream : public AudioOutputBackend::Stream,
+                                            private juce::Thread
+{
+public:
+    VirtualStream(Device& targetDevice, unsigned int channels, unsigned int rate, unsigned int frames,
+                  RenderCallback renderCallback, void* renderUserData)
+        : juce::Thread("Kousaten Virtual " + targetDevice.config.name)
+        , device(targetDevice)
+        , numChannels(channels)
+        , sampleRate(rate)
+        , bufferSize(frames)
+        , callback(renderCallback)
+        , userData(renderUserData)
+        , buffer(static_cast<size_t>(frames) * channels, 0.0f)
+    {
+    }
+
+    ~VirtualStream() override
+    {
+        stop();
+    }
+
+    bool start() override { return startThread(juce::Thread::Priority::highest); }
+
+    // Wakes the thread from its wait; a callback in progress always finishes, so the join
+    // has no timeout
+    void stop() override
+    {
+        signalThreadShouldExit();
+        notify();
+        stopThread(-1);
+    }
+
+    long getLatencyFrames() const override { return device.config.latencyFrames; }
+
+private:
+    Device& device;
+    unsigned int numChannels;
+    unsigned int sampleRate;
+    unsigned int bufferSize;
+    RenderCallback callback;
+    void* userData;
+    std::vector<float> buffer;
+
+    void run() override
+    {
+        const double periodMs = 1000.0 * bufferSize / (sampleRate * (1.0 + device.config.driftPpm * 1.0e-6));
+        double deadlineMs = juce::Time::getMillisecondCounterHiRes() + periodMs;
+
+        while (!threadShouldExit())
+        {
+            const double remainingMs = deadlineMs - juce::Time::getMillisecondCounterHiRes();
+
+            if (remainingMs > 2.0)
+            {
+                wait(static_cast<int>(remainingMs) - 1);
+                continue;
+            }
+
+            if (remainingMs > 0.0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            callback(buffer.data(), bufferSize, userData);
+            capture();
+            device.numCallbacks.fetch_add(1, std::memory_order_relaxed);
+
+            // After a long stall, skip ahead instead of bursting to catch up
+            deadlineMs += periodMs;
+            if (-remainingMs > 100.0 * periodMs)
+                deadlineMs = juce::Time::getMillisecondCounterHiRes() + periodMs;
+        }
+    }
+
+    void capture()
+    {
+        // Registered before looking at the flag, and clearCapture() raises the flag before
+        // counting writers, so one of the two always sees the other
+        device.activeWriters.fetch_add(1, std::memory_order_seq_cst);
+
+        if (!device.clearing.load(std::memory_order_seq_cst))
+            write();
+
+        device.activeWriters.fetch_sub(1, std::memory_order_release);
+    }
+
+    void write()
+    {
+        const int capacity = device.config.captureFrames;
+        const int frames = static_cast<int>(bufferSize);
+
+        if (device.capturedFrames.load(std::memory_order_relaxed) >= capacity)
+            return;
+
+        // Two streams on the device (while it is being reopened) take turns, so neither can
+        // publish a count that covers frames the other is still writing
+        while (device.writing.exchange(true, std::memory_order_acquire))
+            std::this_thread::yield();
+
+        const int first = device.capturedFrames.load(std::memory_order_relaxed);
+        const int count = std::min(frames, capacity - first);
+        if (count <= 0)
+        {
+            device.writing.store(false, std::memory_order_release);
+            return;
+        }
+
+        const auto deviceChannels = static_cast<int>(device.config.numChannels);
+        const int channels = std::min(deviceChannels, static_cast<int>(numChannels));
+
+        for (int i = 0; i < count; ++i)
+        {
+            for (int ch = 0; ch < channels; ++ch)
+                device.capture[static_cast<size_t>((first + i) * deviceChannels + ch)] =
+                    buffer[static_cast<size_t>(i * static_cast<int>(numChannels) + ch)];
+        }
+
+        device.capturedFrames.store(first + count, std::memory_order_release);
+        device.writing.store(false, std::memory_order_release);
+    }
+};
+
+// Lists the backend's devices; they report every common sample rate
+class VirtualOutputBackend::Enumeration : public DeviceEnumerationBackend
+{
+public:
+    explicit Enumeration(VirtualOutputBackend& ownerBackend) : backend(ownerBackend) {}
+
+    std::vector<EnumeratedDevice> listDevices() override
+    {
+        std::lock_guard<std::mutex> lock(backend.devicesMutex);
+
+        std::vector<EnumeratedDevice> listed;
+        for (const auto& device : backend.devices)
+        {
+            EnumeratedDevice enumerated;
+            enumerated.typeName = "Virtual";
+            enumerated.name = device->config.name;
+            enumerated.runtimeId = device->id;
+            listed.push_back(enumerated);
+        }
+        return listed;
+    }
+
+    bool probeDevice(EnumeratedDevice& enumerated) override
+    {
+        auto* device = backend.findDevice(enumerated.runtimeId);
+        if (device == nullptr)
+            return false;
+
+        for (unsigned int ch = 0; ch < device->config.numChannels; ++ch)
+            enumerated.outputChannelNames.add("Output " + juce::String(ch + 1));
+
+        enumerated.sampleRates = { 44100.0, 48000.0, 88200.0, 96000.0 };
+        return true;
+    }
+
+private:
+    VirtualOutputBackend& backend;
+};
+
+void VirtualOutputBackend::addDevice(const DeviceConfig& config)
+{
+    auto device = std::make_unique<Device>();
+    device->config = config;
+    device->config.numChannels = std::max(1u, config.numChannels);
+    device->config.captureFrames = std::max(0, config.captureFrames);
+    device->capture.assign(static_cast<size_t>(device->config.captureFrames) * device->config.numChannels, 0.0f);
+
+    std::lock_guard<std::mutex> lock(devicesMutex);
+    device->id = static_cast<unsigned int>(devices.size() + 1);  // 0 means "no id" to the manager
+    devices.push_back(std::move(device));
+}
+
+VirtualOutputBackend::Device* VirtualOutputBackend::findDevice(const juce::String& deviceName) const
+{
+    std::lock_guard<std::mutex> lock(devicesMutex);
+
+    for (const auto& device : devices)
+    {
+        if (device->config.name == deviceName)
+            return device.get();
+    }
+
+    return nullptr;
+}
+
+VirtualOutputBackend::Device* VirtualOutputBackend::findDevice(unsigned int deviceId) const
+{
+    std::lock_guard<std::mutex> lock(devicesMutex);
+
+    if (deviceId == 0 || deviceId > devices.size())
+        return nullptr;
+
+    return devices[deviceId - 1].get();
+}
+
+juce::AudioBuffer<float> VirtualOutputBackend::getCapture(const juce::String& deviceName) const
+{
+    auto* device = findDevice(deviceName);
+    if (device == nullptr)
+        return {};
+
+    const int frames = device->capturedFrames.load(std::memory_order_acquire);
+    const auto channels = static_cast<int>(device->config.numChannels);
+
+    juce::AudioBuffer<float> captured(channels, frames);
+    Interleave::deinterleave(device->capture.data(), channels, captured.getArrayOfWritePointers(), frames);
+    return captured;
+}
+
+void VirtualOutputBackend::clearCapture(const juce::String& deviceName)
+{
+    auto* device = findDevice(deviceName);
+    if (device == nullptr)
+        return;
+
+    // One clear at a time; then no callback claims frames until the counts are reset
+    while (device->clearing.exchange(true, std::memory_order_seq_cst))
+        std::this_thread::yield();
+
+    while (device->activeWriters.load(std::memory_order_seq_cst) != 0)
+        std::this_thread::yield();
+
+    device->capturedFrames.store(0, std::memory_order_relaxed);
+    device->clearing.store(false, std::memory_order_release);
+}
+
+juce::int64 VirtualOutputBackend::getNumCallbacks(const juce::String& deviceName) const
+{
+    auto* device = findDevice(deviceName);
+    return device != nullptr ? device->numCallbacks.load(std::memory_order_relaxed) : 0;
+}
+
+std::unique_ptr<DeviceEnumerationBackend> VirtualOutputBackend::createEnumerationBackend()
+{
+    return std::make_unique<Enumeration>(*this);
+}
+
+std::unique_ptr<AudioOutputBackend::Stream> VirtualOutputBackend::openStream(const juce::String& /*deviceName*/,
+                                                                             unsigned int deviceId, unsigned int numChannels,
+                                                                             unsigned int sampleRate, unsigned int bufferSize,
+                                                                             RenderCallback callback, void* userData)
+{
+    // Virtual ids never change while the backend exists
+    auto* device = findDevice(deviceId);
+    if (device == nullptr || numChannels == 0 || sampleRate == 0 || bufferSize == 0)
+        return nullptr;
+
+    return std::make_unique<VirtualStream>(*device, numChannels, sampleRate, bufferSize, callback, userData);
+}
+
+} // namespace Kousaten
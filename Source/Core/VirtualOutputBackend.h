@@ -0,0 +1,80 @@
+/*
+    Kousaten Mixer - Virtual Output Backend
+    Loopback output devices for RtAudioManager: each open stream is clocked by its own
+    timer thread at a configurable drift and everything it plays is captured, so the
+    multi-device aux paths can be tested without sound cards
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "AudioOutputBackend.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Kousaten {
+
+class VirtualOutputBackend : public AudioOutputBackend
+{
+public:
+    struct DeviceConfig
+    {
+        juce::String name;
+        unsigned int numChannels = 2;
+        double driftPpm = 0.0;        // Device clock against its nominal rate (positive = fast)
+        long latencyFrames = 0;       // Reported as the device's output latency
+        int captureFrames = 480000;   // Frames kept from the start of the capture
+    };
+
+    VirtualOutputBackend() = default;
+
+    // Any thread: add a device. It shows up with the manager's next device scan, like a
+    // hot-plugged interface.
+    void addDevice(const DeviceConfig& config);
+
+    // Any thread: what the device has played (deinterleaved) since it was added or its
+    // capture was last cleared, up to captureFrames
+    juce::AudioBuffer<float> getCapture(const juce::String& deviceName) const;
+
+    // Any thread, streams running or not: start capturing from scratch. Waits out a callback
+    // that is writing; callbacks during the clear keep nothing.
+    void clearCapture(const juce::String& deviceName);
+
+    // Any thread: device callbacks run so far
+    juce::int64 getNumCallbacks(const juce::String& deviceName) const;
+
+    std::unique_ptr<DeviceEnumerationBackend> createEnumerationBackend() override;
+    std::unique_ptr<Stream> openStream(const juce::String& deviceName, unsigned int deviceId,
+                                       unsigned int numChannels,
+                                       unsigned int sampleRate, unsigned int bufferSize,
+                                       RenderCallback callback, void* userData) override;
+
+private:
+    class VirtualStream;
+    class Enumeration;
+
+    // Allocated when added and never moved, so streams can write to it without a lock
+    struct Device
+    {
+        DeviceConfig config;
+        unsigned int id = 0;
+        std::vector<float> capture;                  // Interleaved, config.numChannels wide
+        std::atomic<int> capturedFrames { 0 };       // Written and readable
+        std::atomic<bool> writing { false };         // Held by the callback copying its block in
+        std::atomic<int> activeWriters { 0 };        // Callbacks between claiming and publishing
+        std::atomic<bool> clearing { false };        // Held by clearCapture(); no new claims
+        std::atomic<juce::int64> numCallbacks { 0 };
+    };
+
+    std::vector<std::unique_ptr<Device>> devices;
+    mutable std::mutex devicesMutex;
+
+    Device* findDevice(const juce::String& deviceName) const;
+    Device* findDevice(unsigned int deviceId) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VirtualOutputBackend)
+};
+
+} // namespace Kousaten
@@ -0,0 +1,102 @@
+/*
+    Kousaten Mixer - Compressor Processor
+    Implementation
+*/
+
+#include "CompressorProcessor.h"
+#include <cmath>
+
+namespace Kousaten {
+
+void CompressorProcessor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    reset();
+}
+
+void CompressorProcessor::reset()
+{
+    envelopeDb = 0.0f;
+    gainReductionDb.store(0.0f, std::memory_order_relaxed);
+}
+
+void CompressorProcessor::setThreshold(float newThresholdDb)
+{
+    thresholdDb.store(juce::jlimit(-60.0f, 0.0f, newThresholdDb), std::memory_order_relaxed);
+}
+
+void CompressorProcessor::setRatio(float newRatio)
+{
+    ratio.store(juce::jlimit(1.0f, 20.0f, newRatio), std::memory_order_relaxed);
+}
+
+void CompressorProcessor::setAttack(float newAttackMs)
+{
+    attackMs.store(juce::jlimit(0.1f, 100.0f, newAttackMs), std::memory_order_relaxed);
+}
+
+void CompressorProcessor::setRelease(float newReleaseMs)
+{
+    releaseMs.store(juce::jlimit(10.0f, 1000.0f, newReleaseMs), std::memory_order_relaxed);
+}
+
+void CompressorProcessor::setMakeupGain(float newMakeupDb)
+{
+    makeupDb.store(juce::jlimit(0.0f, 24.0f, newMakeupDb), std::memory_order_relaxed);
+}
+
+void CompressorProcessor::process(float* left, float* right, int numSamples)
+{
+    const float threshold = thresholdDb.load(std::memory_order_relaxed);
+    const float slope = 1.0f - 1.0f / ratio.load(std::memory_order_relaxed);
+    const float makeup = makeupDb.load(std::memory_order_relaxed);
+    const float makeupGain = juce::Decibels::decibelsToGain(makeup);
+
+    // dB <-> gain through log2/exp2, which are cheaper than log10/pow
+    constexpr float decibelsPerOctave = 6.0205999f;  // 20 * log10(2)
+
+    auto coefficient = [this](float ms) {
+        return static_cast<float>(std::exp(-1000.0 / (ms * sampleRate)));
+    };
+    const float attack = coefficient(attackMs.load(std::memory_order_relaxed));
+    const float release = coefficient(releaseMs.load(std::memory_order_relaxed));
+
+    // Below the knee nothing is reduced, so quiet samples skip the log
+    const float kneeStart = juce::Decibels::decibelsToGain(threshold - KNEE_DB / 2.0f);
+
+    float envelope = envelopeDb;
+    float maxReduction = 0.0f;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float peak = std::max(std::abs(left[i]), std::abs(right[i]));
+
+        float reduction = 0.0f;
+        if (peak > kneeStart)
+        {
+            const float overshoot = decibelsPerOctave * std::log2(peak) - threshold;
+            if (overshoot >= KNEE_DB / 2.0f)
+            {
+                reduction = overshoot * slope;
+            }
+            else
+            {
+                const float intoKnee = overshoot + KNEE_DB / 2.0f;
+                reduction = slope * intoKnee * intoKnee / (2.0f * KNEE_DB);
+            }
+        }
+
+        envelope = reduction + (reduction > envelope ? attack : release) * (envelope - reduction);
+        maxReduction = std::max(maxReduction, envelope);
+
+        // Fully released: only the makeup gain applies
+        const float gain = envelope > 1.0e-4f ? std::exp2((makeup - envelope) / decibelsPerOctave) : makeupGain;
+        left[i] *= gain;
+        right[i] *= gain;
+    }
+
+    envelopeDb = envelope;
+    gainReductionDb.store(maxReduction, std::memory_order_relaxed);
+}
+
+} // namespace Kousaten
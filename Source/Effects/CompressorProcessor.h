@@ -0,0 +1,56 @@
+/*
+    Kousaten Mixer - Compressor Processor
+    Stereo-linked feed-forward compressor with a soft knee
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+namespace Kousaten {
+
+class CompressorProcessor
+{
+public:
+    static constexpr float KNEE_DB = 6.0f;
+
+    CompressorProcessor() = default;
+
+    void prepare(double sampleRate);
+    void reset();
+
+    // Message thread
+    void setThreshold(float thresholdDb);     // -60 to 0 dB
+    void setRatio(float ratio);               // 1 to 20
+    void setAttack(float attackMs);           // 0.1 to 100 ms
+    void setRelease(float releaseMs);         // 10 to 1000 ms
+    void setMakeupGain(float makeupDb);       // 0 to 24 dB
+
+    float getThreshold() const { return thresholdDb.load(); }
+    float getRatio() const { return ratio.load(); }
+    float getAttack() const { return attackMs.load(); }
+    float getRelease() const { return releaseMs.load(); }
+    float getMakeupGain() const { return makeupDb.load(); }
+
+    // Largest gain reduction of the last block, in dB (for metering)
+    float getGainReduction() const { return gainReductionDb.load(std::memory_order_relaxed); }
+
+    // Audio thread: compress in place
+    void process(float* left, float* right, int numSamples);
+
+private:
+    std::atomic<float> thresholdDb { -18.0f };
+    std::atomic<float> ratio { 4.0f };
+    std::atomic<float> attackMs { 10.0f };
+    std::atomic<float> releaseMs { 100.0f };
+    std::atomic<float> makeupDb { 0.0f };
+    std::atomic<float> gainReductionDb { 0.0f };
+
+    double sampleRate = 48000.0;
+    float envelopeDb = 0.0f;  // Smoothed gain reduction (audio thread)
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompressorProcessor)
+};
+
+} // namespace Kousaten
@@ -1,8 +1,410 @@
 /*
     Kousaten Mixer - Delay Processor
-    Implementation file (header-only class)
+    Implementation
 */
 
 #include "DelayProcessor.h"
+#include <JuceHeader.h>
 
-// DelayProcessor is implemented entirely in the header
+namespace Kousaten {
+
+void DelayProcessor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    minDelay = std::max(static_cast<float>(MIN_LOOKBACK + 1), MIN_DELAY_SECONDS * static_cast<float>(sampleRate));
+    maxDelay = MAX_DELAY_SECONDS * static_cast<float>(sampleRate);
+    lfoIncrement = static_cast<float>(modulationRate / sampleRate);
+
+    // The oldest tap a four-tap read takes is two samples past the longest delay
+    bufferSize = juce::nextPowerOfTwo(static_cast<int>(std::ceil(maxDelay)) + 4);
+    bufferMask = bufferSize - 1;
+    left.buffer.assign(static_cast<size_t>(bufferSize), 0.0f);
+    right.buffer.assign(static_cast<size_t>(bufferSize), 0.0f);
+
+    reset();
+}
+
+void DelayProcessor::reset()
+{
+    for (auto* line : { &left, &right })
+    {
+        std::fill(line->buffer.begin(), line->buffer.end(), 0.0f);
+        line->delay = line->target;
+        line->rampStep = 0.0;
+        line->rampRemaining = 0;
+        line->allpassState = 0.0f;
+    }
+
+    writeIndex = 0;
+    lfoPhase = 0.0f;
+    jumpToTarget = true;
+}
+
+void DelayProcessor::setParameters(float timeLeft, float timeRight, float feedback, float chaosAmount)
+{
+    setTarget(left, timeLeft);
+    setTarget(right, timeRight);
+    jumpToTarget = false;
+
+    this->feedback = std::clamp(feedback, 0.0f, 0.95f);
+    this->chaosAmount = std::clamp(chaosAmount, 0.0f, 1.0f);
+}
+
+void DelayProcessor::setTarget(Line& line, float seconds)
+{
+    const double target = std::clamp(static_cast<double>(seconds) * sampleRate,
+                                     static_cast<double>(minDelay), static_cast<double>(maxDelay));
+
+    if (jumpToTarget)
+    {
+        line.delay = target;
+        line.target = target;
+        line.rampRemaining = 0;
+        return;
+    }
+
+    // A ramp in progress keeps its pace unless the target moves
+    if (target == line.target)
+        return;
+
+    line.target = target;
+    line.rampRemaining = std::max(1, static_cast<int>(TIME_RAMP_SECONDS * sampleRate));
+    line.rampStep = (target - line.delay) / line.rampRemaining;
+}
+
+void DelayProcessor::setModulation(float depthMs, float rateHz)
+{
+    modulationDepthMs = std::clamp(depthMs, 0.0f, MAX_MODULATION_MS);
+    modulationRate = rateHz;
+    lfoIncrement = static_cast<float>(modulationRate / sampleRate);
+}
+
+float DelayProcessor::getSyncedTime(NoteDivision division, double bpm)
+{
+    if (division == NoteDivision::Free || bpm <= 0.0)
+        return 0.0f;
+
+    double beats = 1.0;
+    switch (division)
+    {
+        case NoteDivision::Whole:          beats = 4.0; break;
+        case NoteDivision::Half:           beats = 2.0; break;
+        case NoteDivision::Quarter:        beats = 1.0; break;
+        case NoteDivision::Eighth:         beats = 0.5; break;
+        case NoteDivision::Sixteenth:      beats = 0.25; break;
+        case NoteDivision::DottedQuarter:  beats = 1.5; break;
+        case NoteDivision::DottedEighth:   beats = 0.75; break;
+        case NoteDivision::QuarterTriplet: beats = 2.0 / 3.0; break;
+        case NoteDivision::EighthTriplet:  beats = 1.0 / 3.0; break;
+        case NoteDivision::Free:           break;
+    }
+
+    return std::clamp(static_cast<float>(beats * 60.0 / bpm), MIN_DELAY_SECONDS, MAX_DELAY_SECONDS);
+}
+
+void DelayProcessor::processBlock(const float* const* inputs, float* const* outputs, int numSamples,
+                                  const float* chaos)
+{
+    const float chaosDepth = chaos != nullptr
+        ? chaosAmount * CHAOS_DEPTH_MS * 0.001f * static_cast<float>(sampleRate)
+        : 0.0f;
+
+    if (chaosDepth == 0.0f)
+        chaos = nullptr;
+
+    // Lines that hold still skip the per-sample tap positions
+    const bool modulated = chaos != nullptr || modulationDepthMs > 0.0f;
+
+    auto process = [&](Line& line, int channel, float lineChaosDepth, float lfoOffset) {
+        if (modulated || line.rampRemaining > 0)
+            processLine(line, inputs[channel], outputs[channel], numSamples, chaos, lineChaosDepth, lfoOffset);
+        else
+            processSteadyLine(line, inputs[channel], outputs[channel], numSamples);
+    };
+
+    process(left, 0, chaosDepth, 0.0f);
+    process(right, 1, -chaosDepth, 0.25f);
+
+    writeIndex = (writeIndex + numSamples) & bufferMask;
+
+    lfoPhase += static_cast<float>(numSamples) * lfoIncrement;
+    lfoPhase -= std::floor(lfoPhase);
+}
+
+void DelayProcessor::processLine(Line& line, const float* input, float* output, int numSamples,
+                                 const float* chaos, float chaosDepth, float lfoOffset)
+{
+    float* buffer = line.buffer.data();
+    const float lfoDepth = modulationDepthMs * 0.001f * static_cast<float>(sampleRate);
+    const double sweep = lfoDepth + std::abs(chaosDepth);
+    int write = writeIndex;
+
+    for (int done = 0; done < numSamples;)
+    {
+        // No sample the chunk reads may be one it writes: every delay in it must stay
+        // clear of the chunk's length
+        const double lowest = std::max(static_cast<double>(minDelay), std::min(line.delay, line.target) - sweep);
+        const int length = std::min({ numSamples - done, CHUNK_SIZE, static_cast<int>(lowest) - MIN_LOOKBACK });
+
+        // Delays relative to a whole base, which keeps the fractions exact in float
+        const double base = std::floor(line.delay);
+        const float start = static_cast<float>(line.delay - base);
+        const float step = static_cast<float>(line.rampStep);
+        const int ramp = line.rampRemaining;
+        const float lowestOffset = static_cast<float>(minDelay - base);
+        const float highestOffset = static_cast<float>(maxDelay - base);
+        float* d = delays.data();
+
+        for (int i = 0; i < length; ++i)
+            d[i] = start + step * static_cast<float>(std::min(i + 1, ramp));
+
+        if (lfoDepth > 0.0f)
+        {
+            // Triangle from the phase; the quarter-cycle shift starts it at zero
+            const float phase = lfoPhase + lfoOffset + 0.25f + static_cast<float>(done) * lfoIncrement;
+            for (int i = 0; i < length; ++i)
+            {
+                float p = phase + static_cast<float>(i) * lfoIncrement;
+                p -= static_cast<float>(static_cast<int>(p));
+                d[i] += lfoDepth * (4.0f * std::abs(p - 0.5f) - 1.0f);
+            }
+        }
+
+        if (chaos != nullptr)
+        {
+            for (int i = 0; i < length; ++i)
+                d[i] += chaosDepth * chaos[done + i];
+        }
+
+        for (int i = 0; i < length; ++i)
+            d[i] = std::clamp(d[i], lowestOffset, highestOffset);
+
+        // Sample i reads at (write + i) - (base + d[i]): the whole part picks the taps,
+        // the rest is the fraction from tap0 towards tap1
+        const int origin = write - static_cast<int>(base) - 1;
+        int* indices = tapIndices.data();
+        float* fraction = fractions.data();
+
+        for (int i = 0; i < length; ++i)
+        {
+            const float position = static_cast<float>(i) - d[i];
+            int whole = static_cast<int>(position);
+            whole -= position < static_cast<float>(whole) ? 1 : 0;
+            fraction[i] = position - static_cast<float>(whole);
+            indices[i] = origin + whole;  // tapBefore, before masking
+        }
+
+        const bool fourTaps = interpolation != Interpolation::Linear;
+        const int mask = bufferMask;
+
+        for (int i = 0; i < length; ++i)
+        {
+            const int index = indices[i];
+            tap0[i] = buffer[(index + 1) & mask];
+            tap1[i] = buffer[(index + 2) & mask];
+
+            if (fourTaps)
+            {
+                tapBefore[i] = buffer[index & mask];
+                tapAfter[i] = buffer[(index + 3) & mask];
+            }
+        }
+
+        const float* x0 = tap0.data();
+        const float* x1 = tap1.data();
+        const float* xm1 = tapBefore.data();
+        const float* x2 = tapAfter.data();
+        float* y = delayed.data();
+
+        switch (interpolation)
+        {
+            case Interpolation::Linear:
+            {
+                for (int i = 0; i < length; ++i)
+                    y[i] = x0[i] + fraction[i] * (x1[i] - x0[i]);
+                break;
+            }
+
+            case Interpolation::Allpass:
+            {
+                // The allpass delays a newer tap by 0.5 to 1.5 samples, which keeps its pole
+                // well inside the unit circle so a moving delay's transients die out. It
+                // depends on its last output, so this one runs sample by sample.
+                float state = line.allpassState;
+                for (int i = 0; i < length; ++i)
+                {
+                    const float t = fraction[i];
+                    const bool late = t > 0.5f;
+                    const float eta = late ? (t - 1.0f) / (3.0f - t) : t / (2.0f - t);
+                    const float older = late ? x1[i] : x0[i];
+                    const float newer = late ? x2[i] : x1[i];
+                    state = older + eta * (newer - state);
+                    y[i] = state;
+                }
+                line.allpassState = state;
+                break;
+            }
+
+            case Interpolation::Hermite:
+            {
+                for (int i = 0; i < length; ++i)
+                {
+                    const float t = fraction[i];
+                    const float c1 = 0.5f * (x1[i] - xm1[i]);
+                    const float c2 = xm1[i] - 2.5f * x0[i] + 2.0f * x1[i] - 0.5f * x2[i];
+                    const float c3 = 0.5f * (x2[i] - xm1[i]) + 1.5f * (x0[i] - x1[i]);
+                    y[i] = ((c3 * t + c2) * t + c1) * t + x0[i];
+                }
+                break;
+            }
+
+            case Interpolation::Lagrange:
+            {
+                for (int i = 0; i < length; ++i)
+                {
+                    const float t = fraction[i];
+                    const float tm1 = t - 1.0f;
+                    const float tm2 = t - 2.0f;
+                    const float tp1 = t + 1.0f;
+                    y[i] = xm1[i] * (-t * tm1 * tm2 * (1.0f / 6.0f))
+                         + x0[i] * (tp1 * tm1 * tm2 * 0.5f)
+                         + x1[i] * (-tp1 * t * tm2 * 0.5f)
+                         + x2[i] * (tp1 * t * tm1 * (1.0f / 6.0f));
+                }
+                break;
+            }
+        }
+
+        if (interpolation != Interpolation::Allpass)
+            line.allpassState = y[length - 1];
+
+        // Feedback, split where the write position wraps
+        const float* in = input + done;
+        float* out = output + done;
+
+        auto feed = [&](float* dest, int from, int count) {
+            for (int i = from; i < from + count; ++i)
+            {
+                const float value = y[i];
+                dest[i - from] = in[i] + value * feedback;
+                out[i] = value;
+            }
+        };
+
+        const int first = std::min(length, bufferSize - write);
+        feed(buffer + write, 0, first);
+        feed(buffer, first, length - first);
+
+        if (line.rampRemaining > 0)
+        {
+            const int steps = std::min(length, line.rampRemaining);
+            line.rampRemaining -= steps;
+            line.delay = line.rampRemaining > 0 ? line.delay + line.rampStep * steps : line.target;
+        }
+
+        write = (write + length) & bufferMask;
+        done += length;
+    }
+}
+
+void DelayProcessor::processSteadyLine(Line& line, const float* input, float* output, int numSamples)
+{
+    float* buffer = line.buffer.data();
+
+    // tap0 is lag samples behind the write, and the read position t of the way from it
+    // towards tap1
+    const double whole = std::floor(line.delay);
+    const double rest = line.delay - whole;
+    const int lag = static_cast<int>(whole) + (rest > 0.0 ? 1 : 0);
+    const auto t = rest > 0.0 ? static_cast<float>(1.0 - rest) : 0.0f;
+
+    // Tap weights for tapBefore, tap0, tap1 and tapAfter
+    float weights[4] = { 0.0f, 1.0f, 0.0f, 0.0f };
+    switch (interpolation)
+    {
+        case Interpolation::Linear:
+        case Interpolation::Allpass:
+            weights[1] = 1.0f - t;
+            weights[2] = t;
+            break;
+
+        case Interpolation::Hermite:
+            weights[0] = ((-0.5f * t + 1.0f) * t - 0.5f) * t;
+            weights[1] = (1.5f * t - 2.5f) * t * t + 1.0f;
+            weights[2] = ((-1.5f * t + 2.0f) * t + 0.5f) * t;
+            weights[3] = (0.5f * t - 0.5f) * t * t;
+            break;
+
+        case Interpolation::Lagrange:
+            weights[0] = -t * (t - 1.0f) * (t - 2.0f) * (1.0f / 6.0f);
+            weights[1] = (t + 1.0f) * (t - 1.0f) * (t - 2.0f) * 0.5f;
+            weights[2] = -(t + 1.0f) * t * (t - 2.0f) * 0.5f;
+            weights[3] = (t + 1.0f) * t * (t - 1.0f) * (1.0f / 6.0f);
+            break;
+    }
+
+    const bool fourTaps = interpolation == Interpolation::Hermite || interpolation == Interpolation::Lagrange;
+
+    // As in processLine(), the allpass reads from the tap 0.5 to 1.5 samples newer
+    const bool late = t > 0.5f;
+    const float eta = late ? (t - 1.0f) / (3.0f - t) : t / (2.0f - t);
+
+    int write = writeIndex;
+    int taps[4];
+    for (int k = 0; k < 4; ++k)
+        taps[k] = (write - lag - 1 + k) & bufferMask;
+
+    // Split the block into runs where no index wraps and no sample read was written
+    // within the run, so each run is a plain vectorizable loop
+    for (int done = 0; done < numSamples;)
+    {
+        int run = std::min({ numSamples - done, lag - 2, bufferSize - write });
+        for (int k = 0; k < 4; ++k)
+            run = std::min(run, bufferSize - taps[k]);
+
+        const float* in = input + done;
+        float* out = output + done;
+        float* dest = buffer + write;
+        const float* xm1 = buffer + taps[0];
+        const float* x0 = buffer + taps[1];
+        const float* x1 = buffer + taps[2];
+        const float* x2 = buffer + taps[3];
+
+        auto feed = [&](auto&& read) {
+            for (int i = 0; i < run; ++i)
+            {
+                const float value = read(i);
+                dest[i] = in[i] + value * feedback;
+                out[i] = value;
+            }
+        };
+
+        if (interpolation == Interpolation::Allpass && t > 0.0f)
+        {
+            float state = line.allpassState;
+            const float* older = late ? x1 : x0;
+            const float* newer = late ? x2 : x1;
+            feed([&](int i) { return state = older[i] + eta * (newer[i] - state); });
+            line.allpassState = state;
+        }
+        else
+        {
+            // Whole-sample delays read the signal itself
+            if (t == 0.0f)
+                feed([&](int i) { return x0[i]; });
+            else if (!fourTaps)
+                feed([&](int i) { return x0[i] * weights[1] + x1[i] * weights[2]; });
+            else
+                feed([&](int i) { return xm1[i] * weights[0] + x0[i] * weights[1] + x1[i] * weights[2] + x2[i] * weights[3]; });
+
+            line.allpassState = out[run - 1];
+        }
+
+        done += run;
+        write = (write + run) & bufferMask;
+        for (int k = 0; k < 4; ++k)
+            taps[k] = (taps[k] + run) & bufferMask;
+    }
+}
+
+} // namespace Kousaten
@@ -9,71 +9,136 @@
 #include <cmath>
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <vector>
 
 namespace Kousaten {
 
+// Each channel reads its line at a fractional delay that ramps to a new time instead of
+// jumping, plus an optional LFO and chaos sweep, through the selected interpolator
 class DelayProcessor
 {
 public:
-    static constexpr int BUFFER_SIZE = 96000;  // 2 seconds at 48kHz
+    static constexpr float MIN_DELAY_SECONDS = 0.001f;
+    static constexpr float MAX_DELAY_SECONDS = 2.0f;
+    static constexpr float MAX_MODULATION_MS = 10.0f;
+    static constexpr float CHAOS_DEPTH_MS = 5.0f;  // Sweep at full chaos amount
 
-    DelayProcessor()
-    {
-        reset();
-    }
+    // Time a change of delay time takes; the read tap glides over it like a tape head
+    static constexpr double TIME_RAMP_SECONDS = 0.1;
 
-    void reset()
+    enum class Interpolation
     {
-        leftBuffer.fill(0.0f);
-        rightBuffer.fill(0.0f);
-        writeIndex = 0;
-    }
+        Linear,   // Two taps; cheapest, dulls the highs at half-sample delays
+        Allpass,  // First order; flat response but rings when the delay moves
+        Hermite,  // Four-tap cubic spline
+        Lagrange  // Four-tap third-order polynomial
+    };
 
-    void setParameters(float timeLeft, float timeRight, float feedback, float sampleRate)
-    {
-        delaySamplesLeft = static_cast<int>(std::clamp(timeLeft, 0.001f, 2.0f) * sampleRate);
-        delaySamplesRight = static_cast<int>(std::clamp(timeRight, 0.001f, 2.0f) * sampleRate);
-        delaySamplesLeft = std::clamp(delaySamplesLeft, 1, BUFFER_SIZE - 1);
-        delaySamplesRight = std::clamp(delaySamplesRight, 1, BUFFER_SIZE - 1);
-        this->feedback = std::clamp(feedback, 0.0f, 0.95f);
-    }
-
-    void process(float inputLeft, float inputRight, float& outputLeft, float& outputRight)
+    enum class NoteDivision
     {
-        // Read from delay buffer
-        int readIndexLeft = (writeIndex - delaySamplesLeft + BUFFER_SIZE) % BUFFER_SIZE;
-        int readIndexRight = (writeIndex - delaySamplesRight + BUFFER_SIZE) % BUFFER_SIZE;
+        Free,  // Delay time in seconds, no sync
+        Whole,
+        Half,
+        Quarter,
+        Eighth,
+        Sixteenth,
+        DottedQuarter,
+        DottedEighth,
+        QuarterTriplet,
+        EighthTriplet
+    };
 
-        outputLeft = leftBuffer[readIndexLeft];
-        outputRight = rightBuffer[readIndexRight];
+    DelayProcessor() { prepare(48000.0); }
 
-        // Write to delay buffer with feedback
-        leftBuffer[writeIndex] = inputLeft + outputLeft * feedback;
-        rightBuffer[writeIndex] = inputRight + outputRight * feedback;
+    // Sizes the lines for MAX_DELAY_SECONDS at the rate and clears them (not on the audio
+    // thread)
+    void prepare(double sampleRate);
+    void reset();
 
-        // Advance write index
-        writeIndex = (writeIndex + 1) % BUFFER_SIZE;
-    }
+    // Memory held by both lines at the prepared rate
+    size_t getBufferBytes() const { return (left.buffer.size() + right.buffer.size()) * sizeof(float); }
 
-    // Process with wet/dry mix
-    void processWithMix(float inputLeft, float inputRight,
-                        float& outputLeft, float& outputRight,
-                        float wetDry)
-    {
-        float delayedLeft, delayedRight;
-        process(inputLeft, inputRight, delayedLeft, delayedRight);
+    // Per-block settings for processBlock(). A new time is reached over TIME_RAMP_SECONDS.
+    void setParameters(float timeLeft, float timeRight, float feedback, float chaosAmount);
+
+    void setInterpolation(Interpolation newInterpolation) { interpolation = newInterpolation; }
+    Interpolation getInterpolation() const { return interpolation; }
+
+    // Triangle sweep of both taps over +-depthMs (0 = fixed), the right a quarter cycle
+    // ahead of the left
+    void setModulation(float depthMs, float rateHz);
 
-        outputLeft = inputLeft * (1.0f - wetDry) + delayedLeft * wetDry;
-        outputRight = inputRight * (1.0f - wetDry) + delayedRight * wetDry;
-    }
+    // Delay time of the division at the tempo, clamped to the line; 0 for Free
+    static float getSyncedTime(NoteDivision division, double bpm);
+
+    // Processes two channels with the parameters from the last setParameters(); an output
+    // may be the same buffer as its input. chaos, if given, holds one modulation value per
+    // sample; the right tap moves against the left.
+    void processBlock(const float* const* inputs, float* const* outputs, int numSamples,
+                      const float* chaos = nullptr);
 
 private:
-    std::array<float, BUFFER_SIZE> leftBuffer{};
-    std::array<float, BUFFER_SIZE> rightBuffer{};
+    // Samples per pass over a line: the delays of a chunk are computed, its taps gathered
+    // and interpolated, then its feedback written, each as a separate loop
+    static constexpr int CHUNK_SIZE = 64;
+
+    // Four-tap interpolators read up to two samples past the read position, so every delay
+    // in a chunk must exceed this many samples beyond the chunk's length
+    static constexpr int MIN_LOOKBACK = 3;
+
+    struct Line
+    {
+        std::vector<float> buffer;
+
+        // Delay in samples, gliding towards target
+        double delay = 12000.0;
+        double target = 12000.0;
+        double rampStep = 0.0;
+        int rampRemaining = 0;
+
+        float allpassState = 0.0f;
+    };
+
+    void setTarget(Line& line, float seconds);
+    void processLine(Line& line, const float* input, float* output, int numSamples,
+                     const float* chaos, float chaosDepth, float lfoOffset);
+
+    // A line whose delay holds still: the taps are contiguous runs read with fixed weights
+    void processSteadyLine(Line& line, const float* input, float* output, int numSamples);
+
+    // Both lines share the power-of-two size, wrapped with the mask
+    Line left;
+    Line right;
+    int bufferSize = 0;
+    int bufferMask = 0;
     int writeIndex = 0;
-    int delaySamplesLeft = 12000;
-    int delaySamplesRight = 12000;
+
+    double sampleRate = 48000.0;
+    float minDelay = 48.0f;
+    float maxDelay = 96000.0f;
+    bool jumpToTarget = true;  // The first time after a reset isn't glided to
+
+    Interpolation interpolation = Interpolation::Hermite;
+
+    float modulationDepthMs = 0.0f;
+    float modulationRate = 0.5f;
+    float lfoIncrement = 0.5f / 48000.0f;
+    float lfoPhase = 0.0f;
+
+    // Latched by setParameters()
     float feedback = 0.3f;
+    float chaosAmount = 0.0f;
+
+    // Per-chunk scratch: delay offsets, then the taps around each read position
+    alignas(16) std::array<float, CHUNK_SIZE> delays {};
+    alignas(16) std::array<int, CHUNK_SIZE> tapIndices {};
+    alignas(16) std::array<float, CHUNK_SIZE> fractions {};
+    alignas(16) std::array<float, CHUNK_SIZE> tapBefore {};
+    alignas(16) std::array<float, CHUNK_SIZE> tap0 {};
+    alignas(16) std::array<float, CHUNK_SIZE> tap1 {};
+    alignas(16) std::array<float, CHUNK_SIZE> tapAfter {};
+    alignas(16) std::array<float, CHUNK_SIZE> delayed {};
 };
 
 } // namespace Kousaten
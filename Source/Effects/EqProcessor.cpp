@@ -0,0 +1,270 @@
+/*
+    Kousaten Mixer - EQ Processor
+    Implementation
+*/
+
+#include "EqProcessor.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+ #define KOUSATEN_EQ_SSE2 1
+ #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #define KOUSATEN_EQ_NEON 1
+ #include <arm_neon.h>
+#endif
+
+namespace Kousaten {
+
+EqProcessor::EqProcessor()
+{
+    bands[0].type = static_cast<int>(BandType::LowShelf);
+    bands[0].frequency = 100.0f;
+    bands[1].frequency = 400.0f;
+    bands[2].frequency = 2500.0f;
+    bands[3].type = static_cast<int>(BandType::HighShelf);
+    bands[3].frequency = 8000.0f;
+}
+
+void EqProcessor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    parametersChanged.store(true, std::memory_order_release);
+    reset();
+}
+
+void EqProcessor::reset()
+{
+    for (auto& state : states)
+        state = State();
+}
+
+void EqProcessor::setBand(int band, BandType type, float frequency, float gainDb, float q)
+{
+    jassert(band >= 0 && band < MAX_BANDS);
+    auto& parameters = bands[static_cast<size_t>(band)];
+
+    parameters.type.store(static_cast<int>(type), std::memory_order_relaxed);
+    parameters.frequency.store(juce::jlimit(10.0f, 24000.0f, frequency), std::memory_order_relaxed);
+    parameters.gainDb.store(juce::jlimit(-24.0f, 24.0f, gainDb), std::memory_order_relaxed);
+    parameters.q.store(juce::jlimit(0.1f, 18.0f, q), std::memory_order_relaxed);
+    parametersChanged.store(true, std::memory_order_release);
+}
+
+void EqProcessor::setBandEnabled(int band, bool enabled)
+{
+    jassert(band >= 0 && band < MAX_BANDS);
+    bands[static_cast<size_t>(band)].enabled.store(enabled, std::memory_order_relaxed);
+    parametersChanged.store(true, std::memory_order_release);
+}
+
+void EqProcessor::updateCoefficients()
+{
+    numActiveBands = 0;
+
+    for (int band = 0; band < MAX_BANDS; ++band)
+    {
+        const auto& parameters = bands[static_cast<size_t>(band)];
+        const bool enabled = parameters.enabled.load(std::memory_order_relaxed);
+
+        // A band switched on starts from silence rather than from where it stopped
+        if (enabled && !bandRunning[static_cast<size_t>(band)])
+            states[static_cast<size_t>(band)] = State();
+
+        bandRunning[static_cast<size_t>(band)] = enabled;
+        if (!enabled)
+            continue;
+
+        coefficients[static_cast<size_t>(band)] = makeCoefficients(static_cast<BandType>(parameters.type.load(std::memory_order_relaxed)),
+                                                                   parameters.frequency.load(std::memory_order_relaxed),
+                                                                   parameters.gainDb.load(std::memory_order_relaxed),
+                                                                   parameters.q.load(std::memory_order_relaxed),
+                                                                   sampleRate);
+        activeBands[static_cast<size_t>(numActiveBands++)] = band;
+    }
+}
+
+// RBJ Audio EQ Cookbook filters
+EqProcessor::Coefficients EqProcessor::makeCoefficients(BandType type, float frequency, float gainDb, float q,
+                                                        double sampleRate)
+{
+    const double w0 = juce::MathConstants<double>::twoPi * std::min(static_cast<double>(frequency), 0.45 * sampleRate) / sampleRate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double a = std::pow(10.0, gainDb / 40.0);
+    const double shelfAlpha = 2.0 * std::sqrt(a) * alpha;
+
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+
+    switch (type)
+    {
+        case BandType::Peak:
+            b0 = 1.0 + alpha * a;
+            b1 = -2.0 * cosW0;
+            b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0 * cosW0;
+            a2 = 1.0 - alpha / a;
+            break;
+
+        case BandType::LowShelf:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cosW0 + shelfAlpha);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW0);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cosW0 - shelfAlpha);
+            a0 = (a + 1.0) + (a - 1.0) * cosW0 + shelfAlpha;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW0);
+            a2 = (a + 1.0) + (a - 1.0) * cosW0 - shelfAlpha;
+            break;
+
+        case BandType::HighShelf:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cosW0 + shelfAlpha);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW0);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cosW0 - shelfAlpha);
+            a0 = (a + 1.0) - (a - 1.0) * cosW0 + shelfAlpha;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW0);
+            a2 = (a + 1.0) - (a - 1.0) * cosW0 - shelfAlpha;
+            break;
+
+        case BandType::HighPass:
+            b0 = (1.0 + cosW0) / 2.0;
+            b1 = -(1.0 + cosW0);
+            b2 = b0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cosW0;
+            a2 = 1.0 - alpha;
+            break;
+
+        case BandType::LowPass:
+            b0 = (1.0 - cosW0) / 2.0;
+            b1 = 1.0 - cosW0;
+            b2 = b0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cosW0;
+            a2 = 1.0 - alpha;
+            break;
+    }
+
+    return { static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+             static_cast<float>(a1 / a0), static_cast<float>(a2 / a0) };
+}
+
+void EqProcessor::process(float* left, float* right, int numSamples)
+{
+    if (parametersChanged.exchange(false, std::memory_order_acquire))
+        updateCoefficients();
+
+    if (numActiveBands == 0)
+        return;
+
+    const int numBands = numActiveBands;
+
+    // Each sample runs through the cascade as one (left, right) vector; coefficients and
+    // state stay in registers for the block
+   #if KOUSATEN_EQ_SSE2
+    __m128 b0[MAX_BANDS], b1[MAX_BANDS], b2[MAX_BANDS], a1[MAX_BANDS], a2[MAX_BANDS];
+    __m128 s1[MAX_BANDS], s2[MAX_BANDS];
+
+    for (int k = 0; k < numBands; ++k)
+    {
+        const auto band = static_cast<size_t>(activeBands[static_cast<size_t>(k)]);
+        const auto& c = coefficients[band];
+        b0[k] = _mm_set1_ps(c.b0);
+        b1[k] = _mm_set1_ps(c.b1);
+        b2[k] = _mm_set1_ps(c.b2);
+        a1[k] = _mm_set1_ps(c.a1);
+        a2[k] = _mm_set1_ps(c.a2);
+        s1[k] = _mm_load_ps(states[band].s1);
+        s2[k] = _mm_load_ps(states[band].s2);
+    }
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        __m128 x = _mm_unpacklo_ps(_mm_load_ss(left + i), _mm_load_ss(right + i));
+
+        for (int k = 0; k < numBands; ++k)
+        {
+            const __m128 y = _mm_add_ps(_mm_mul_ps(b0[k], x), s1[k]);
+            s1[k] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[k], x), _mm_mul_ps(a1[k], y)), s2[k]);
+            s2[k] = _mm_sub_ps(_mm_mul_ps(b2[k], x), _mm_mul_ps(a2[k], y));
+            x = y;
+        }
+
+        _mm_store_ss(left + i, x);
+        _mm_store_ss(right + i, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1)));
+    }
+
+    for (int k = 0; k < numBands; ++k)
+    {
+        const auto band = static_cast<size_t>(activeBands[static_cast<size_t>(k)]);
+        _mm_store_ps(states[band].s1, s1[k]);
+        _mm_store_ps(states[band].s2, s2[k]);
+    }
+   #elif KOUSATEN_EQ_NEON
+    float32x2_t b0[MAX_BANDS], b1[MAX_BANDS], b2[MAX_BANDS], a1[MAX_BANDS], a2[MAX_BANDS];
+    float32x2_t s1[MAX_BANDS], s2[MAX_BANDS];
+
+    for (int k = 0; k < numBands; ++k)
+    {
+        const auto band = static_cast<size_t>(activeBands[static_cast<size_t>(k)]);
+        const auto& c = coefficients[band];
+        b0[k] = vdup_n_f32(c.b0);
+        b1[k] = vdup_n_f32(c.b1);
+        b2[k] = vdup_n_f32(c.b2);
+        a1[k] = vdup_n_f32(c.a1);
+        a2[k] = vdup_n_f32(c.a2);
+        s1[k] = vld1_f32(states[band].s1);
+        s2[k] = vld1_f32(states[band].s2);
+    }
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float32x2_t x = vset_lane_f32(right[i], vdup_n_f32(left[i]), 1);
+
+        for (int k = 0; k < numBands; ++k)
+        {
+            const float32x2_t y = vadd_f32(vmul_f32(b0[k], x), s1[k]);
+            s1[k] = vadd_f32(vsub_f32(vmul_f32(b1[k], x), vmul_f32(a1[k], y)), s2[k]);
+            s2[k] = vsub_f32(vmul_f32(b2[k], x), vmul_f32(a2[k], y));
+            x = y;
+        }
+
+        vst1_lane_f32(left + i, x, 0);
+        vst1_lane_f32(right + i, x, 1);
+    }
+
+    for (int k = 0; k < numBands; ++k)
+    {
+        const auto band = static_cast<size_t>(activeBands[static_cast<size_t>(k)]);
+        vst1_f32(states[band].s1, s1[k]);
+        vst1_f32(states[band].s2, s2[k]);
+    }
+   #else
+    for (int k = 0; k < numBands; ++k)
+    {
+        const auto band = static_cast<size_t>(activeBands[static_cast<size_t>(k)]);
+        const auto& c = coefficients[band];
+        auto& state = states[band];
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            float* data = ch == 0 ? left : right;
+            float z1 = state.s1[ch];
+            float z2 = state.s2[ch];
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float x = data[i];
+                const float y = c.b0 * x + z1;
+                z1 = c.b1 * x - c.a1 * y + z2;
+                z2 = c.b2 * x - c.a2 * y;
+                data[i] = y;
+            }
+
+            state.s1[ch] = z1;
+            state.s2[ch] = z2;
+        }
+    }
+   #endif
+}
+
+} // namespace Kousaten
@@ -0,0 +1,88 @@
+/*
+    Kousaten Mixer - EQ Processor
+    Stereo parametric EQ: a cascade of up to four biquad bands, left and right filtered
+    together in one SIMD register
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+namespace Kousaten {
+
+class EqProcessor
+{
+public:
+    static constexpr int MAX_BANDS = 4;
+
+    enum class BandType
+    {
+        Peak,
+        LowShelf,
+        HighShelf,
+        HighPass,
+        LowPass
+    };
+
+    EqProcessor();
+
+    void prepare(double sampleRate);
+    void reset();
+
+    // Message thread: band settings (frequency in Hz, gain in dB; gain is ignored by the
+    // pass filters). Bands start disabled.
+    void setBand(int band, BandType type, float frequency, float gainDb, float q);
+    void setBandEnabled(int band, bool enabled);
+
+    BandType getBandType(int band) const { return static_cast<BandType>(bands[static_cast<size_t>(band)].type.load()); }
+    float getBandFrequency(int band) const { return bands[static_cast<size_t>(band)].frequency.load(); }
+    float getBandGain(int band) const { return bands[static_cast<size_t>(band)].gainDb.load(); }
+    float getBandQ(int band) const { return bands[static_cast<size_t>(band)].q.load(); }
+    bool isBandEnabled(int band) const { return bands[static_cast<size_t>(band)].enabled.load(); }
+
+    // Audio thread: filter in place through the enabled bands
+    void process(float* left, float* right, int numSamples);
+
+private:
+    struct BandParameters
+    {
+        std::atomic<int> type { static_cast<int>(BandType::Peak) };
+        std::atomic<float> frequency { 1000.0f };
+        std::atomic<float> gainDb { 0.0f };
+        std::atomic<float> q { 0.707f };
+        std::atomic<bool> enabled { false };
+    };
+
+    // Normalised transposed direct form II coefficients
+    struct Coefficients
+    {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    };
+
+    // Filter state, one lane per channel (lanes 2 and 3 are padding for SSE)
+    struct State
+    {
+        alignas(16) float s1[4] {};
+        alignas(16) float s2[4] {};
+    };
+
+    std::array<BandParameters, MAX_BANDS> bands;
+    std::atomic<bool> parametersChanged { true };
+
+    // Audio thread: what process() runs, rebuilt when the parameters change
+    double sampleRate = 48000.0;
+    std::array<Coefficients, MAX_BANDS> coefficients;
+    std::array<State, MAX_BANDS> states;
+    std::array<int, MAX_BANDS> activeBands {};
+    std::array<bool, MAX_BANDS> bandRunning {};
+    int numActiveBands = 0;
+
+    void updateCoefficients();
+    static Coefficients makeCoefficients(BandType type, float frequency, float gainDb, float q, double sampleRate);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EqProcessor)
+};
+
+} // namespace Kousaten
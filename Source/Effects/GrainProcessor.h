@@ -22,6 +22,7 @@ class GrainProcessor
 public:
     static constexpr int BUFFER_SIZE = 8192;
     static constexpr int MAX_GRAINS = 16;
+    static constexpr int BUFFER_MASK = BUFFER_SIZE - 1;
 
     GrainProcessor()
     {
@@ -40,16 +41,51 @@ public:
         phase = 0.0f;
     }
 
+    // Per-block settings for processBlock()
+    void setParameters(float grainSize, float density, float position,
+                       float chaosAmount, float sampleRate)
+    {
+        float grainSizeMs = grainSize * 99.0f + 1.0f;
+        grainSamples = (grainSizeMs / 1000.0f) * sampleRate;
+        this->density = density;
+        this->position = position;
+        this->chaosAmount = chaosAmount;
+        this->sampleRate = sampleRate;
+    }
+
     float process(float input, float grainSize, float density, float position,
                   float chaosAmount, float chaosOutput, float sampleRate)
+    {
+        setParameters(grainSize, density, position, chaosAmount, sampleRate);
+        return processSample(input, chaosOutput);
+    }
+
+    // Processes one channel, inputs[0] to outputs[0], with the parameters from the last
+    // setParameters(). chaos, if given, holds one modulation value per sample.
+    void processBlock(const float* const* inputs, float* const* outputs, int numSamples,
+                      const float* chaos = nullptr)
+    {
+        const float* input = inputs[0];
+        float* output = outputs[0];
+
+        if (chaos != nullptr)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                output[i] = processSample(input[i], chaos[i]);
+        }
+        else
+        {
+            for (int i = 0; i < numSamples; ++i)
+                output[i] = processSample(input[i], 0.0f);
+        }
+    }
+
+private:
+    float processSample(float input, float chaosOutput)
     {
         // Write input to circular buffer
         grainBuffer[writeIndex] = input;
-        writeIndex = (writeIndex + 1) % BUFFER_SIZE;
-
-        // Calculate grain parameters
-        float grainSizeMs = grainSize * 99.0f + 1.0f;
-        float grainSamples = (grainSizeMs / 1000.0f) * sampleRate;
+        writeIndex = (writeIndex + 1) & BUFFER_MASK;
 
         // Scale chaos by amount
         float scaledChaos = chaosOutput * chaosAmount;
@@ -90,8 +126,8 @@ public:
                 // Hann window envelope
                 float env = 0.5f * (1.0f - std::cos(envPhase * 2.0f * M_PI));
 
-                int readPos = static_cast<int>(grain.position);
-                readPos = ((readPos % BUFFER_SIZE) + BUFFER_SIZE) % BUFFER_SIZE;
+                // Positions are never negative, so a mask wraps them
+                int readPos = static_cast<int>(grain.position) & BUFFER_MASK;
 
                 float sample = grainBuffer[readPos];
                 output += sample * env;
@@ -118,7 +154,6 @@ public:
         return output;
     }
 
-private:
     struct Grain
     {
         bool active = false;
@@ -180,6 +215,13 @@ private:
     std::array<Grain, MAX_GRAINS> grains{};
     int writeIndex = 0;
     float phase = 0.0f;
+
+    // Latched by setParameters()
+    float grainSamples = 0.0f;
+    float density = 0.4f;
+    float position = 0.5f;
+    float chaosAmount = 0.0f;
+    float sampleRate = 48000.0f;
 };
 
 } // namespace Kousaten
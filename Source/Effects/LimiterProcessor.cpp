@@ -0,0 +1,120 @@
+/*
+    Kousaten Mixer - Limiter Processor
+    Implementation
+*/
+
+#include "LimiterProcessor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Kousaten {
+
+void LimiterProcessor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    latencySamples = getLatencySamples(sampleRate);
+    windowSize = latencySamples + 1;
+
+    delayLeft.assign(static_cast<size_t>(latencySamples), 0.0f);
+    delayRight.assign(static_cast<size_t>(latencySamples), 0.0f);
+    minValues.assign(static_cast<size_t>(windowSize), 1.0f);
+    minTimes.assign(static_cast<size_t>(windowSize), 0);
+    averageBuffer.assign(static_cast<size_t>(windowSize), 1.0f);
+
+    reset();
+}
+
+void LimiterProcessor::reset()
+{
+    std::fill(delayLeft.begin(), delayLeft.end(), 0.0f);
+    std::fill(delayRight.begin(), delayRight.end(), 0.0f);
+    delayIndex = 0;
+
+    minFront = 0;
+    minCount = 0;
+    time = 0;
+
+    envelope = 1.0f;
+    std::fill(averageBuffer.begin(), averageBuffer.end(), 1.0f);
+    averageIndex = 0;
+    averageSum = static_cast<double>(windowSize);
+
+    gainReductionDb.store(0.0f, std::memory_order_relaxed);
+}
+
+void LimiterProcessor::setCeiling(float newCeilingDb)
+{
+    ceilingDb.store(juce::jlimit(-12.0f, 0.0f, newCeilingDb), std::memory_order_relaxed);
+}
+
+void LimiterProcessor::setRelease(float newReleaseMs)
+{
+    releaseMs.store(juce::jlimit(1.0f, 1000.0f, newReleaseMs), std::memory_order_relaxed);
+}
+
+void LimiterProcessor::process(float* left, float* right, int numSamples)
+{
+    jassert(!delayLeft.empty());
+
+    const float ceiling = juce::Decibels::decibelsToGain(ceilingDb.load(std::memory_order_relaxed));
+    const auto release = static_cast<float>(std::exp(-1000.0 / (releaseMs.load(std::memory_order_relaxed) * sampleRate)));
+    const auto window = static_cast<juce::uint32>(windowSize);
+    const double windowScale = 1.0 / windowSize;
+
+    float minGain = 1.0f;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float peak = std::max(std::abs(left[i]), std::abs(right[i]));
+        const float required = peak > ceiling ? ceiling / peak : 1.0f;
+
+        // Sliding minimum: drop the gain that has left the window and queued gains no
+        // smaller than this one
+        if (minCount > 0 && time - minTimes[static_cast<size_t>(minFront)] >= window)
+        {
+            minFront = minFront + 1 < windowSize ? minFront + 1 : 0;
+            --minCount;
+        }
+
+        auto slot = [this](int offset) {
+            const int index = minFront + offset;
+            return static_cast<size_t>(index < windowSize ? index : index - windowSize);
+        };
+
+        while (minCount > 0 && minValues[slot(minCount - 1)] >= required)
+            --minCount;
+
+        const auto back = slot(minCount);
+        minValues[back] = required;
+        minTimes[back] = time;
+        ++minCount;
+
+        const float held = minValues[static_cast<size_t>(minFront)];
+        ++time;
+
+        // Instant attack on the held gain, exponential release; never above held, so the
+        // window average can't be above any gain a delayed sample needs
+        envelope = held < envelope ? held : held + release * (envelope - held);
+
+        averageSum += envelope - averageBuffer[static_cast<size_t>(averageIndex)];
+        averageBuffer[static_cast<size_t>(averageIndex)] = envelope;
+        averageIndex = averageIndex + 1 < windowSize ? averageIndex + 1 : 0;
+
+        const auto gain = static_cast<float>(averageSum * windowScale);
+        minGain = std::min(minGain, gain);
+
+        // The clamp only catches rounding in the running average
+        const float delayedLeft = delayLeft[static_cast<size_t>(delayIndex)];
+        const float delayedRight = delayRight[static_cast<size_t>(delayIndex)];
+        delayLeft[static_cast<size_t>(delayIndex)] = left[i];
+        delayRight[static_cast<size_t>(delayIndex)] = right[i];
+        delayIndex = delayIndex + 1 < latencySamples ? delayIndex + 1 : 0;
+
+        left[i] = juce::jlimit(-ceiling, ceiling, delayedLeft * gain);
+        right[i] = juce::jlimit(-ceiling, ceiling, delayedRight * gain);
+    }
+
+    gainReductionDb.store(-juce::Decibels::gainToDecibels(minGain), std::memory_order_relaxed);
+}
+
+} // namespace Kousaten
@@ -0,0 +1,74 @@
+/*
+    Kousaten Mixer - Limiter Processor
+    Stereo brickwall limiter: the signal is delayed by a short lookahead so the gain is
+    already down when a peak arrives, and no sample leaves above the ceiling
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace Kousaten {
+
+class LimiterProcessor
+{
+public:
+    static constexpr double LOOKAHEAD_MS = 1.5;
+
+    LimiterProcessor() = default;
+
+    // Allocates the lookahead buffers (not while process() can run)
+    void prepare(double sampleRate);
+    void reset();
+
+    // Message thread
+    void setCeiling(float ceilingDb);    // -12 to 0 dB
+    void setRelease(float releaseMs);    // 1 to 1000 ms
+
+    float getCeiling() const { return ceilingDb.load(); }
+    float getRelease() const { return releaseMs.load(); }
+
+    // The lookahead delay in samples
+    int getLatencySamples() const { return latencySamples; }
+    static int getLatencySamples(double sampleRate) { return std::max(1, juce::roundToInt(LOOKAHEAD_MS * sampleRate / 1000.0)); }
+
+    // Largest gain reduction of the last block, in dB (for metering)
+    float getGainReduction() const { return gainReductionDb.load(std::memory_order_relaxed); }
+
+    // Audio thread: limit in place
+    void process(float* left, float* right, int numSamples);
+
+private:
+    std::atomic<float> ceilingDb { -1.0f };
+    std::atomic<float> releaseMs { 50.0f };
+    std::atomic<float> gainReductionDb { 0.0f };
+
+    double sampleRate = 48000.0;
+    int latencySamples = 0;
+    int windowSize = 1;  // latencySamples + 1: every gain that can touch a delayed peak
+
+    // The delayed signal
+    std::vector<float> delayLeft, delayRight;
+    int delayIndex = 0;
+
+    // Sliding minimum of the gain each sample needs, over the window (a monotonic queue
+    // in a ring: values increase from front to back)
+    std::vector<float> minValues;
+    std::vector<juce::uint32> minTimes;
+    int minFront = 0;
+    int minCount = 0;
+    juce::uint32 time = 0;
+
+    // Released gain, then averaged over the window so it ramps down ahead of a peak
+    float envelope = 1.0f;
+    std::vector<float> averageBuffer;
+    int averageIndex = 0;
+    double averageSum = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LimiterProcessor)
+};
+
+} // namespace Kousaten
@@ -1,8 +1,457 @@
 /*
     Kousaten Mixer - Reverb Processor
-    Implementation file (header-only class)
+    Implementation
 */
 
 #include "ReverbProcessor.h"
+#include <JuceHeader.h>
+#include <cstddef>
+#include <cstdint>
 
-// ReverbProcessor is implemented entirely in the header
+#if defined(__x86_64__) || defined(_M_X64)
+ #define KOUSATEN_REVERB_SSE2 1
+ #include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+ #define KOUSATEN_REVERB_NEON 1
+ #include <arm_neon.h>
+#endif
+
+namespace Kousaten {
+
+void ReverbProcessor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    const double ratio = sampleRate / REFERENCE_SAMPLE_RATE;
+
+    auto scaled = [ratio](int length) {
+        return std::max(1, static_cast<int>(std::lround(length * ratio)));
+    };
+
+    for (size_t lane = 0; lane < combLengths.size(); ++lane)
+        combLengths[lane] = scaled(referenceCombLengths[lane]);
+
+    for (size_t stage = 0; stage < allpassLengths.size(); ++stage)
+        allpassLengths[stage] = scaled(referenceAllpassLengths[stage]);
+
+    maxModulationSamples = static_cast<float>(MAX_MODULATION_MS * 0.001 * sampleRate);
+
+    // Room for the longest comb swept to its deepest, plus the interpolation's second tap
+    const int longestComb = *std::max_element(combLengths.begin(), combLengths.end());
+    const int longestAllpass = *std::max_element(allpassLengths.begin(), allpassLengths.end());
+    const int combFrames = juce::nextPowerOfTwo(longestComb + static_cast<int>(std::ceil(2.0f * maxModulationSamples)) + 2);
+    const int allpassFrames = juce::nextPowerOfTwo(longestAllpass + 1);
+    jassert(allpassFrames <= combFrames);
+
+    combRingMask = combFrames - 1;
+    allpassRingMask = allpassFrames - 1;
+
+    // One block for both rings, so the lines sit together rather than wherever the
+    // allocator put eight separate buffers
+    constexpr size_t cacheLine = 64;
+    const auto combFloats = static_cast<size_t>(combFrames) * NUM_COMBS;
+    const auto allpassFloats = static_cast<size_t>(allpassFrames) * ALLPASS_FRAME;
+    arena.assign(combFloats + allpassFloats + cacheLine / sizeof(float), 0.0f);
+
+    const auto address = reinterpret_cast<std::uintptr_t>(arena.data());
+    combRing = arena.data() + (cacheLine - address % cacheLine) % cacheLine / sizeof(float);
+    allpassRing = combRing + combFloats;
+
+    dampingExponent = static_cast<float>(REFERENCE_SAMPLE_RATE / sampleRate);
+    hpCutoff = std::clamp(100.0f / (static_cast<float>(sampleRate) * 0.5f), 0.001f, 0.1f);
+
+    updateModulation();
+    reset();
+}
+
+void ReverbProcessor::reset()
+{
+    std::fill(arena.begin(), arena.end(), 0.0f);
+    writeIndex = 0;
+
+    combLp.fill(0.0f);
+    hpState.fill(0.0f);
+
+    for (size_t lane = 0; lane < lfoCos.size(); ++lane)
+    {
+        const double phase = juce::MathConstants<double>::twoPi * static_cast<double>(lane) / NUM_COMBS;
+        lfoCos[lane] = static_cast<float>(std::cos(phase));
+        lfoSin[lane] = static_cast<float>(std::sin(phase));
+    }
+}
+
+ReverbProcessor::Footprint ReverbProcessor::getFootprint() const
+{
+    Footprint footprint;
+    footprint.combBytes = static_cast<size_t>(combRingMask + 1) * NUM_COMBS * sizeof(float);
+    footprint.allpassBytes = static_cast<size_t>(allpassRingMask + 1) * ALLPASS_FRAME * sizeof(float);
+    footprint.arenaBytes = arena.size() * sizeof(float);
+    return footprint;
+}
+
+void ReverbProcessor::setModulation(float depthMs, float rateHz)
+{
+    depthMs = std::clamp(depthMs, 0.0f, MAX_MODULATION_MS);
+    if (depthMs == modulationDepthMs && rateHz == modulationRate)
+        return;
+
+    modulationDepthMs = depthMs;
+    modulationRate = rateHz;
+    updateModulation();
+}
+
+void ReverbProcessor::updateModulation()
+{
+    modulationSamples = std::min(modulationDepthMs * 0.001f * static_cast<float>(sampleRate), maxModulationSamples);
+
+    const double step = juce::MathConstants<double>::twoPi * modulationRate / sampleRate;
+    lfoStepCos = static_cast<float>(std::cos(step));
+    lfoStepSin = static_cast<float>(std::sin(step));
+}
+
+void ReverbProcessor::readModulatedTaps(int position, float* taps)
+{
+    // Swept delays and phasor turns first, in a loop plain enough to vectorise
+    alignas(16) int whole[NUM_COMBS];
+    alignas(16) float fraction[NUM_COMBS];
+
+    for (size_t lane = 0; lane < static_cast<size_t>(NUM_COMBS); ++lane)
+    {
+        const float delay = static_cast<float>(combLengths[lane]) + modulationSamples * (1.0f + lfoSin[lane]);
+        whole[lane] = static_cast<int>(delay);
+        fraction[lane] = delay - static_cast<float>(whole[lane]);
+
+        const float c = lfoCos[lane];
+        const float s = lfoSin[lane];
+        lfoCos[lane] = c * lfoStepCos - s * lfoStepSin;
+        lfoSin[lane] = c * lfoStepSin + s * lfoStepCos;
+    }
+
+    // Linear interpolation between the taps either side of each swept delay
+    for (int lane = 0; lane < NUM_COMBS; ++lane)
+    {
+        const float nearer = combRing[((position - whole[lane]) & combRingMask) * NUM_COMBS + lane];
+        const float further = combRing[((position - whole[lane] - 1) & combRingMask) * NUM_COMBS + lane];
+        taps[lane] = nearer + (further - nearer) * fraction[lane];
+    }
+}
+
+int ReverbProcessor::getRun(int position, int maxLength, std::ptrdiff_t* combOffsets,
+                            std::ptrdiff_t* allpassOffsets) const
+{
+    const int combFrames = combRingMask + 1;
+    const int allpassFrames = allpassRingMask + 1;
+    const int combWrite = position & combRingMask;
+    const int allpassWrite = position & allpassRingMask;
+
+    int length = std::min({ maxLength, combFrames - combWrite, allpassFrames - allpassWrite });
+
+    for (int lane = 0; lane < NUM_COMBS; ++lane)
+    {
+        const int read = (position - combLengths[static_cast<size_t>(lane)]) & combRingMask;
+        length = std::min(length, combFrames - read);
+        combOffsets[lane] = static_cast<std::ptrdiff_t>(read - combWrite) * NUM_COMBS + lane;
+    }
+
+    for (int stage = 0; stage < NUM_ALLPASSES; ++stage)
+    {
+        const int read = (position - allpassLengths[static_cast<size_t>(stage)]) & allpassRingMask;
+        length = std::min(length, allpassFrames - read);
+        allpassOffsets[stage] = static_cast<std::ptrdiff_t>(read - allpassWrite) * ALLPASS_FRAME + stage * 2;
+    }
+
+    return length;
+}
+
+void ReverbProcessor::processBlock(const float* const* inputs, float* const* outputs, int numSamples,
+                                   const float* chaos)
+{
+   #if KOUSATEN_REVERB_SSE2 || KOUSATEN_REVERB_NEON
+    const float* inputLeft = inputs[0];
+    const float* inputRight = inputs[1];
+    float* outputLeft = outputs[0];
+    float* outputRight = outputs[1];
+
+    // Settings in locals: the ring stores could otherwise alias them
+    const bool chaosFeedback = chaos != nullptr && chaosAmount > 0.0f;
+    const float fixedFeedback = baseFeedback;
+    const float chaosDepth = chaosAmount * 0.5f;
+    auto feedbackAt = [=](int i) {
+        return std::clamp(fixedFeedback + chaos[i] * chaosDepth, 0.0f, 0.995f);
+    };
+
+    const bool modulatedTaps = modulationSamples > 0.0f;
+    int w = writeIndex;
+
+    // The block runs in stretches where no ring position wraps, so every tap is a fixed
+    // offset from the frame being written. Per sample: all eight combs as two vectors, then
+    // both channels' allpass chains and highpass as one (left, right) pair. The arithmetic
+    // per lane is processBlockScalar()'s, in the same order, so the output matches it
+    // bit for bit.
+    std::ptrdiff_t combOffsets[NUM_COMBS];
+    std::ptrdiff_t allpassOffsets[NUM_ALLPASSES];
+
+   #if KOUSATEN_REVERB_SSE2
+    const __m128 damping = _mm_set1_ps(dampingCoeff);
+    const __m128 scale = _mm_set1_ps(roomScale);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 allpassGain = _mm_set1_ps(0.5f);
+    const __m128 cutoff = _mm_set1_ps(hpCutoff);
+    const __m128 fixedFeedbacks = _mm_set1_ps(fixedFeedback);
+
+    __m128 lpLow = _mm_load_ps(combLp.data());
+    __m128 lpHigh = _mm_load_ps(combLp.data() + 4);
+    __m128 hp = _mm_load_ps(hpState.data());
+
+    for (int start = 0; start < numSamples;)
+    {
+        const int end = start + getRun(w, numSamples - start, combOffsets, allpassOffsets);
+        float* combFrame = combRing + (w & combRingMask) * NUM_COMBS;
+        float* allpassFrame = allpassRing + (w & allpassRingMask) * ALLPASS_FRAME;
+
+        for (int i = start; i < end; ++i)
+        {
+            const __m128 feedback = chaosFeedback ? _mm_set1_ps(feedbackAt(i)) : fixedFeedbacks;
+            const __m128 input = _mm_unpacklo_ps(_mm_load_ss(inputLeft + i), _mm_load_ss(inputRight + i));
+            const __m128 roomInput = _mm_mul_ps(_mm_movelh_ps(input, input), scale);
+
+            __m128 combLow, combHigh;
+            if (modulatedTaps)
+            {
+                alignas(16) float taps[NUM_COMBS];
+                readModulatedTaps(w + i - start, taps);
+                combLow = _mm_load_ps(taps);
+                combHigh = _mm_load_ps(taps + 4);
+            }
+            else
+            {
+                combLow = _mm_setr_ps(combFrame[combOffsets[0]], combFrame[combOffsets[1]],
+                                      combFrame[combOffsets[2]], combFrame[combOffsets[3]]);
+                combHigh = _mm_setr_ps(combFrame[combOffsets[4]], combFrame[combOffsets[5]],
+                                       combFrame[combOffsets[6]], combFrame[combOffsets[7]]);
+            }
+
+            lpLow = _mm_add_ps(lpLow, _mm_mul_ps(_mm_sub_ps(combLow, lpLow), damping));
+            lpHigh = _mm_add_ps(lpHigh, _mm_mul_ps(_mm_sub_ps(combHigh, lpHigh), damping));
+
+            _mm_store_ps(combFrame, _mm_add_ps(roomInput, _mm_mul_ps(lpLow, feedback)));
+            _mm_store_ps(combFrame + 4, _mm_add_ps(roomInput, _mm_mul_ps(lpHigh, feedback)));
+
+            // ((comb 1 + comb 2) + comb 3) + comb 4 on the left, 5-8 likewise on the right
+            __m128 x = _mm_add_ps(combLow, _mm_movehl_ps(combLow, combLow));
+            x = _mm_add_ps(x, combHigh);
+            x = _mm_add_ps(x, _mm_movehl_ps(combHigh, combHigh));
+            x = _mm_mul_ps(x, quarter);
+
+            // Series allpass diffusion
+            auto allpass = [&](__m128 in, int stage) {
+                const auto* tap = reinterpret_cast<const double*>(allpassFrame + allpassOffsets[stage]);
+                const __m128 delayed = _mm_castpd_ps(_mm_load_sd(tap));
+                _mm_store_sd(reinterpret_cast<double*>(allpassFrame + stage * 2),
+                             _mm_castps_pd(_mm_add_ps(in, _mm_mul_ps(delayed, allpassGain))));
+                return _mm_sub_ps(delayed, _mm_mul_ps(in, allpassGain));
+            };
+
+            x = allpass(allpass(allpass(allpass(x, 0), 1), 2), 3);
+
+            hp = _mm_add_ps(hp, _mm_mul_ps(_mm_sub_ps(x, hp), cutoff));
+            const __m128 out = _mm_sub_ps(x, hp);
+
+            _mm_store_ss(outputLeft + i, out);
+            _mm_store_ss(outputRight + i, _mm_shuffle_ps(out, out, _MM_SHUFFLE(1, 1, 1, 1)));
+
+            combFrame += NUM_COMBS;
+            allpassFrame += ALLPASS_FRAME;
+        }
+
+        w = (w + end - start) & combRingMask;
+        start = end;
+    }
+
+    _mm_store_ps(combLp.data(), lpLow);
+    _mm_store_ps(combLp.data() + 4, lpHigh);
+    _mm_store_ps(hpState.data(), hp);
+   #elif KOUSATEN_REVERB_NEON
+    const float32x4_t damping = vdupq_n_f32(dampingCoeff);
+    const float32x4_t scale = vdupq_n_f32(roomScale);
+    const float32x2_t quarter = vdup_n_f32(0.25f);
+    const float32x2_t allpassGain = vdup_n_f32(0.5f);
+    const float32x2_t cutoff = vdup_n_f32(hpCutoff);
+    const float32x4_t fixedFeedbacks = vdupq_n_f32(fixedFeedback);
+
+    float32x4_t lpLow = vld1q_f32(combLp.data());
+    float32x4_t lpHigh = vld1q_f32(combLp.data() + 4);
+    float32x2_t hp = vld1_f32(hpState.data());
+
+    for (int start = 0; start < numSamples;)
+    {
+        const int end = start + getRun(w, numSamples - start, combOffsets, allpassOffsets);
+        float* combFrame = combRing + (w & combRingMask) * NUM_COMBS;
+        float* allpassFrame = allpassRing + (w & allpassRingMask) * ALLPASS_FRAME;
+
+        for (int i = start; i < end; ++i)
+        {
+            const float32x4_t feedback = chaosFeedback ? vdupq_n_f32(feedbackAt(i)) : fixedFeedbacks;
+            const float32x2_t input = vset_lane_f32(inputRight[i], vdup_n_f32(inputLeft[i]), 1);
+            const float32x4_t roomInput = vmulq_f32(vcombine_f32(input, input), scale);
+
+            alignas(16) float taps[NUM_COMBS];
+            if (modulatedTaps)
+            {
+                readModulatedTaps(w + i - start, taps);
+            }
+            else
+            {
+                for (int lane = 0; lane < NUM_COMBS; ++lane)
+                    taps[lane] = combFrame[combOffsets[lane]];
+            }
+
+            const float32x4_t combLow = vld1q_f32(taps);
+            const float32x4_t combHigh = vld1q_f32(taps + 4);
+
+            lpLow = vaddq_f32(lpLow, vmulq_f32(vsubq_f32(combLow, lpLow), damping));
+            lpHigh = vaddq_f32(lpHigh, vmulq_f32(vsubq_f32(combHigh, lpHigh), damping));
+
+            vst1q_f32(combFrame, vaddq_f32(roomInput, vmulq_f32(lpLow, feedback)));
+            vst1q_f32(combFrame + 4, vaddq_f32(roomInput, vmulq_f32(lpHigh, feedback)));
+
+            // ((comb 1 + comb 2) + comb 3) + comb 4 on the left, 5-8 likewise on the right
+            float32x2_t x = vadd_f32(vget_low_f32(combLow), vget_high_f32(combLow));
+            x = vadd_f32(x, vget_low_f32(combHigh));
+            x = vadd_f32(x, vget_high_f32(combHigh));
+            x = vmul_f32(x, quarter);
+
+            // Series allpass diffusion
+            auto allpass = [&](float32x2_t in, int stage) {
+                const float32x2_t delayed = vld1_f32(allpassFrame + allpassOffsets[stage]);
+                vst1_f32(allpassFrame + stage * 2, vadd_f32(in, vmul_f32(delayed, allpassGain)));
+                return vsub_f32(delayed, vmul_f32(in, allpassGain));
+            };
+
+            x = allpass(allpass(allpass(allpass(x, 0), 1), 2), 3);
+
+            hp = vadd_f32(hp, vmul_f32(vsub_f32(x, hp), cutoff));
+            const float32x2_t out = vsub_f32(x, hp);
+
+            outputLeft[i] = vget_lane_f32(out, 0);
+            outputRight[i] = vget_lane_f32(out, 1);
+
+            combFrame += NUM_COMBS;
+            allpassFrame += ALLPASS_FRAME;
+        }
+
+        w = (w + end - start) & combRingMask;
+        start = end;
+    }
+
+    vst1q_f32(combLp.data(), lpLow);
+    vst1q_f32(combLp.data() + 4, lpHigh);
+    vst1_f32(hpState.data(), hp);
+   #endif
+
+    writeIndex = w;
+    renormalizeModulation();
+   #else
+    processBlockScalar(inputs, outputs, numSamples, chaos);
+   #endif
+}
+
+void ReverbProcessor::processBlockScalar(const float* const* inputs, float* const* outputs, int numSamples,
+                                         const float* chaos)
+{
+    const float* inputLeft = inputs[0];
+    const float* inputRight = inputs[1];
+    float* outputLeft = outputs[0];
+    float* outputRight = outputs[1];
+
+    // Settings in locals: the ring stores could otherwise alias them
+    const bool chaosFeedback = chaos != nullptr && chaosAmount > 0.0f;
+    const float fixedFeedback = baseFeedback;
+    const float chaosDepth = chaosAmount * 0.5f;
+    auto feedbackAt = [=](int i) {
+        return std::clamp(fixedFeedback + chaos[i] * chaosDepth, 0.0f, 0.995f);
+    };
+
+    const bool modulatedTaps = modulationSamples > 0.0f;
+    int w = writeIndex;
+
+    // Stretches as in processBlock(); per sample each comb lane in turn, then each channel's
+    // allpass chain and highpass
+    std::ptrdiff_t combOffsets[NUM_COMBS];
+    std::ptrdiff_t allpassOffsets[NUM_ALLPASSES];
+
+    const float damping = dampingCoeff;
+    const float scale = roomScale;
+    const float cutoff = hpCutoff;
+
+    for (int start = 0; start < numSamples;)
+    {
+        const int end = start + getRun(w, numSamples - start, combOffsets, allpassOffsets);
+        float* combFrame = combRing + (w & combRingMask) * NUM_COMBS;
+        float* allpassFrame = allpassRing + (w & allpassRingMask) * ALLPASS_FRAME;
+
+        for (int i = start; i < end; ++i)
+        {
+            const float feedback = chaosFeedback ? feedbackAt(i) : fixedFeedback;
+            const float roomInput[2] = { inputLeft[i] * scale, inputRight[i] * scale };
+
+            float taps[NUM_COMBS];
+            if (modulatedTaps)
+                readModulatedTaps(w + i - start, taps);
+
+            float x[2] = {};
+
+            for (int lane = 0; lane < NUM_COMBS; ++lane)
+            {
+                const float output = modulatedTaps ? taps[lane] : combFrame[combOffsets[lane]];
+                auto& lp = combLp[static_cast<size_t>(lane)];
+                lp = lp + (output - lp) * damping;
+                combFrame[lane] = roomInput[lane & 1] + lp * feedback;
+                x[lane & 1] += output;
+            }
+
+            float* outs[2] = { outputLeft, outputRight };
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                float diffused = x[ch] * 0.25f;
+
+                // Series allpass diffusion
+                for (int stage = 0; stage < NUM_ALLPASSES; ++stage)
+                {
+                    const float delayed = allpassFrame[allpassOffsets[stage] + ch];
+                    allpassFrame[stage * 2 + ch] = diffused + delayed * 0.5f;
+                    diffused = delayed - diffused * 0.5f;
+                }
+
+                auto& state = hpState[static_cast<size_t>(ch)];
+                state += (diffused - state) * cutoff;
+                outs[ch][i] = diffused - state;
+            }
+
+            combFrame += NUM_COMBS;
+            allpassFrame += ALLPASS_FRAME;
+        }
+
+        w = (w + end - start) & combRingMask;
+        start = end;
+    }
+
+    writeIndex = w;
+    renormalizeModulation();
+}
+
+void ReverbProcessor::renormalizeModulation()
+{
+    // Pull the phasors back onto the unit circle against rounding drift
+    if (modulationSamples > 0.0f)
+    {
+        for (size_t lane = 0; lane < lfoCos.size(); ++lane)
+        {
+            const float correction = 1.5f - 0.5f * (lfoCos[lane] * lfoCos[lane] + lfoSin[lane] * lfoSin[lane]);
+            lfoCos[lane] *= correction;
+            lfoSin[lane] *= correction;
+        }
+    }
+}
+
+} // namespace Kousaten
@@ -6,12 +6,16 @@
 
 #pragma once
 
-#include <cmath>
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
 
 namespace Kousaten {
 
+// Stereo: the left channel runs combs 1-4 and the right combs 5-8, each channel with its
+// own allpass chain and highpass. All eight combs run side by side as SIMD lanes.
 class ReverbProcessor
 {
 public:
@@ -31,135 +35,124 @@ public:
     static constexpr int ALLPASS_3_SIZE = 341;
     static constexpr int ALLPASS_4_SIZE = 225;
 
-    ReverbProcessor() { reset(); }
+    static constexpr int NUM_COMBS = 8;
+    static constexpr int NUM_ALLPASSES = 4;
 
-    void reset()
-    {
-        combBuffer1.fill(0.0f);
-        combBuffer2.fill(0.0f);
-        combBuffer3.fill(0.0f);
-        combBuffer4.fill(0.0f);
-        combBuffer5.fill(0.0f);
-        combBuffer6.fill(0.0f);
-        combBuffer7.fill(0.0f);
-        combBuffer8.fill(0.0f);
-
-        allpassBuffer1.fill(0.0f);
-        allpassBuffer2.fill(0.0f);
-        allpassBuffer3.fill(0.0f);
-        allpassBuffer4.fill(0.0f);
-
-        combIndex1 = combIndex2 = combIndex3 = combIndex4 = 0;
-        combIndex5 = combIndex6 = combIndex7 = combIndex8 = 0;
-        allpassIndex1 = allpassIndex2 = allpassIndex3 = allpassIndex4 = 0;
-
-        combLp1 = combLp2 = combLp3 = combLp4 = 0.0f;
-        combLp5 = combLp6 = combLp7 = combLp8 = 0.0f;
-        hpState = 0.0f;
-    }
+    // The sizes above are in samples at this rate; prepare() scales them to the stream's
+    // rate so the room and its decay stay the same at 96 or 192 kHz
+    static constexpr double REFERENCE_SAMPLE_RATE = 48000.0;
 
-    float process(float inputL, float inputR, float grainDensity,
-                  float roomSize, float damping, float decay,
-                  bool isLeftChannel, float chaosAmount, float chaosOutput,
-                  float sampleRate)
-    {
-        float input = isLeftChannel ? inputL : inputR;
-
-        // Calculate feedback based on decay
-        float feedback = 0.5f + decay * 0.485f;
-        if (chaosAmount > 0.0f)
-        {
-            feedback += chaosOutput * chaosAmount * 0.5f;
-            feedback = std::clamp(feedback, 0.0f, 0.995f);
-        }
-
-        // Damping coefficient
-        float dampingCoeff = 0.05f + damping * 0.9f;
-
-        // Room size scaling
-        float roomScale = 0.3f + roomSize * 1.4f;
-        float roomInput = input * roomScale;
-
-        float combOut = 0.0f;
-
-        if (isLeftChannel)
-        {
-            combOut += processComb(roomInput, combBuffer1.data(), COMB_1_SIZE, combIndex1, feedback, combLp1, dampingCoeff);
-            combOut += processComb(roomInput, combBuffer2.data(), COMB_2_SIZE, combIndex2, feedback, combLp2, dampingCoeff);
-            combOut += processComb(roomInput, combBuffer3.data(), COMB_3_SIZE, combIndex3, feedback, combLp3, dampingCoeff);
-            combOut += processComb(roomInput, combBuffer4.data(), COMB_4_SIZE, combIndex4, feedback, combLp4, dampingCoeff);
-        }
-        else
-        {
-            combOut += processComb(roomInput, combBuffer5.data(), COMB_5_SIZE, combIndex5, feedback, combLp5, dampingCoeff);
-            combOut += processComb(roomInput, combBuffer6.data(), COMB_6_SIZE, combIndex6, feedback, combLp6, dampingCoeff);
-            combOut += processComb(roomInput, combBuffer7.data(), COMB_7_SIZE, combIndex7, feedback, combLp7, dampingCoeff);
-            combOut += processComb(roomInput, combBuffer8.data(), COMB_8_SIZE, combIndex8, feedback, combLp8, dampingCoeff);
-        }
-
-        combOut *= 0.25f;
-
-        // Series allpass diffusion
-        float diffused = combOut;
-        diffused = processAllpass(diffused, allpassBuffer1.data(), ALLPASS_1_SIZE, allpassIndex1, 0.5f);
-        diffused = processAllpass(diffused, allpassBuffer2.data(), ALLPASS_2_SIZE, allpassIndex2, 0.5f);
-        diffused = processAllpass(diffused, allpassBuffer3.data(), ALLPASS_3_SIZE, allpassIndex3, 0.5f);
-        diffused = processAllpass(diffused, allpassBuffer4.data(), ALLPASS_4_SIZE, allpassIndex4, 0.5f);
-
-        // Highpass filter to remove sub-100Hz
-        float hpCutoff = 100.0f / (sampleRate * 0.5f);
-        hpCutoff = std::clamp(hpCutoff, 0.001f, 0.1f);
-        hpState += (diffused - hpState) * hpCutoff;
-        float hpOutput = diffused - hpState;
-
-        return hpOutput;
-    }
+    // Deepest comb tap modulation, which prepare() leaves room for
+    static constexpr float MAX_MODULATION_MS = 2.0f;
 
-private:
-    float processComb(float input, float* buffer, int size, int& index,
-                      float feedback, float& lp, float damping)
+    // Memory held by the lines at the prepared rate
+    struct Footprint
     {
-        float output = buffer[index];
-        lp = lp + (output - lp) * damping;
-        buffer[index] = input + lp * feedback;
-        index = (index + 1) % size;
-        return output;
-    }
+        size_t combBytes = 0;
+        size_t allpassBytes = 0;
+        size_t arenaBytes = 0;  // Both rings plus alignment
+    };
 
-    float processAllpass(float input, float* buffer, int size, int& index, float gain)
+    ReverbProcessor() { prepare(REFERENCE_SAMPLE_RATE); }
+
+    // Allocates the lines for the rate from one arena and clears them (not on the audio
+    // thread)
+    void prepare(double sampleRate);
+    void reset();
+
+    Footprint getFootprint() const;
+
+    // Per-block settings for processBlock()
+    void setParameters(float roomSize, float damping, float decay, float chaosAmount)
     {
-        float delayed = buffer[index];
-        float output = -input * gain + delayed;
-        buffer[index] = input + delayed * gain;
-        index = (index + 1) % size;
-        return output;
-    }
+        // Feedback based on decay, before chaos
+        baseFeedback = 0.5f + decay * 0.485f;
 
-    // Comb filter buffers
-    std::array<float, COMB_1_SIZE> combBuffer1{};
-    std::array<float, COMB_2_SIZE> combBuffer2{};
-    std::array<float, COMB_3_SIZE> combBuffer3{};
-    std::array<float, COMB_4_SIZE> combBuffer4{};
-    std::array<float, COMB_5_SIZE> combBuffer5{};
-    std::array<float, COMB_6_SIZE> combBuffer6{};
-    std::array<float, COMB_7_SIZE> combBuffer7{};
-    std::array<float, COMB_8_SIZE> combBuffer8{};
+        // The damping lowpass is tuned per sample at the reference rate; other rates get
+        // the coefficient with the same cutoff
+        dampingCoeff = 0.05f + damping * 0.9f;
+        if (dampingExponent != 1.0f)
+            dampingCoeff = 1.0f - std::pow(1.0f - dampingCoeff, dampingExponent);
 
-    int combIndex1 = 0, combIndex2 = 0, combIndex3 = 0, combIndex4 = 0;
-    int combIndex5 = 0, combIndex6 = 0, combIndex7 = 0, combIndex8 = 0;
+        roomScale = 0.3f + roomSize * 1.4f;
 
-    float combLp1 = 0.0f, combLp2 = 0.0f, combLp3 = 0.0f, combLp4 = 0.0f;
-    float combLp5 = 0.0f, combLp6 = 0.0f, combLp7 = 0.0f, combLp8 = 0.0f;
+        this->chaosAmount = chaosAmount;
+    }
+
+    // Slow sweep of each comb's tap over depthMs (0 = fixed taps), the combs spread in
+    // phase. Breaks up metallic ringing on sustained input.
+    void setModulation(float depthMs, float rateHz);
 
-    // Allpass filter buffers
-    std::array<float, ALLPASS_1_SIZE> allpassBuffer1{};
-    std::array<float, ALLPASS_2_SIZE> allpassBuffer2{};
-    std::array<float, ALLPASS_3_SIZE> allpassBuffer3{};
-    std::array<float, ALLPASS_4_SIZE> allpassBuffer4{};
+    // Processes two channels with the parameters from the last setParameters(); an output
+    // may be the same buffer as its input. chaos, if given, holds one feedback modulation
+    // value per sample.
+    void processBlock(const float* const* inputs, float* const* outputs, int numSamples,
+                      const float* chaos = nullptr);
 
-    int allpassIndex1 = 0, allpassIndex2 = 0, allpassIndex3 = 0, allpassIndex4 = 0;
+    // The same with plain per-lane arithmetic, as run where there is no SSE2 or NEON: the
+    // reference the SIMD path must match exactly
+    void processBlockScalar(const float* const* inputs, float* const* outputs, int numSamples,
+                            const float* chaos = nullptr);
 
-    float hpState = 0.0f;
+private:
+    // Comb lanes pair the channels, (1, 5), (2, 6), (3, 7), (4, 8), so each channel's sum
+    // adds its combs in order with two-lane vector adds
+    static constexpr std::array<int, NUM_COMBS> referenceCombLengths {
+        COMB_1_SIZE, COMB_5_SIZE, COMB_2_SIZE, COMB_6_SIZE,
+        COMB_3_SIZE, COMB_7_SIZE, COMB_4_SIZE, COMB_8_SIZE
+    };
+    static constexpr std::array<int, NUM_ALLPASSES> referenceAllpassLengths {
+        ALLPASS_1_SIZE, ALLPASS_2_SIZE, ALLPASS_3_SIZE, ALLPASS_4_SIZE
+    };
+
+    // Every line is a tap at a fixed distance behind one shared write position, in rings of
+    // interleaved frames: NUM_COMBS floats per comb frame, a left/right pair per allpass in
+    // an allpass frame. Power-of-two sizes wrap with a mask; the allpass ring is the smaller
+    // so one write index masked by the comb ring serves both.
+    static constexpr int ALLPASS_FRAME = NUM_ALLPASSES * 2;
+
+    void updateModulation();
+    void renormalizeModulation();
+    void readModulatedTaps(int position, float* taps);
+
+    // Samples from position, up to maxLength, before any ring position wraps, and each
+    // tap's offset from the frame being written over that stretch
+    int getRun(int position, int maxLength, std::ptrdiff_t* combOffsets, std::ptrdiff_t* allpassOffsets) const;
+
+    // Line lengths at the prepared rate, in lane order
+    std::array<int, NUM_COMBS> combLengths {};
+    std::array<int, NUM_ALLPASSES> allpassLengths {};
+    int combRingMask = 0;
+    int allpassRingMask = 0;
+
+    // Comb ring then allpass ring, each starting on a cache line
+    std::vector<float> arena;
+    float* combRing = nullptr;
+    float* allpassRing = nullptr;
+    int writeIndex = 0;
+
+    alignas(16) std::array<float, NUM_COMBS> combLp{};
+    alignas(16) std::array<float, 4> hpState{};  // Left, right, padded to one vector
+
+    // Tap modulation: a unit phasor per comb, turned by one step per sample
+    float modulationDepthMs = 0.0f;
+    float modulationRate = 0.5f;
+    float modulationSamples = 0.0f;
+    float maxModulationSamples = 0.0f;
+    std::array<float, NUM_COMBS> lfoCos {};
+    std::array<float, NUM_COMBS> lfoSin {};
+    float lfoStepCos = 1.0f;
+    float lfoStepSin = 0.0f;
+
+    double sampleRate = REFERENCE_SAMPLE_RATE;
+    float dampingExponent = 1.0f;
+    float hpCutoff = 100.0f / 24000.0f;
+
+    // Latched by setParameters()
+    float baseFeedback = 0.791f;
+    float dampingCoeff = 0.41f;
+    float roomScale = 1.0f;
+    float chaosAmount = 0.0f;
 };
 
 } // namespace Kousaten
@@ -8,8 +8,10 @@
 
 MainComponent::MainComponent()
 {
-    // Initialize device handler
+    // Initialize device handlers: both list their devices from the cache and scan in the
+    // background, so startup doesn't wait for every interface to be probed
     deviceHandler.initialize();
+    audioEngine.getRtAudioManager()->initialize();
 
     // Setup audio device manager - request many channels to support multi-channel interfaces
     auto result = audioDeviceManager.initialiseWithDefaultDevices(32, 32);
@@ -215,6 +217,9 @@ MainComponent::MainComponent()
     chaosShapeButton.setColour(juce::ToggleButton::tickDisabledColourId, backgroundLight);
     addAndMakeVisible(chaosShapeButton);
 
+    // Per-stage DSP load, shown in the header and logged when a block misses its deadline
+    audioEngine.getProfiler().setEnabled(true);
+
     // Start UI refresh timer
     startTimerHz(30);
 
@@ -238,82 +243,36 @@ void MainComponent::audioDeviceIOCallbackWithContext(const float* const* inputCh
                                                       const juce::AudioIODeviceCallbackContext& context)
 {
     juce::ignoreUnused(context);
-
-    // Copy input to pre-allocated buffer (no allocation in callback!)
-    int inputChans = std::min(numInputChannels, inputBuffer.getNumChannels());
-    int samplesToProcess = std::min(numSamples, inputBuffer.getNumSamples());
-
-    // Clear all channels first
-    inputBuffer.clear(0, samplesToProcess);
-
-    // Copy all available input channels
-    for (int ch = 0; ch < inputChans; ++ch)
-    {
-        if (inputChannelData[ch] != nullptr)
-        {
-            juce::FloatVectorOperations::copy(inputBuffer.getWritePointer(ch),
-                                               inputChannelData[ch],
-                                               samplesToProcess);
-        }
-    }
+    Kousaten::RealtimeGuard::ScopedRealtimeSection realtimeSection;
 
     // Debug: check input level
     if (numInputChannels > 0 && inputChannelData[0] != nullptr)
     {
         float maxLevel = 0.0f;
-        for (int i = 0; i < samplesToProcess; ++i)
+        for (int i = 0; i < numSamples; ++i)
         {
             maxLevel = std::max(maxLevel, std::abs(inputChannelData[0][i]));
         }
         inputLevel = maxLevel;
     }
 
-    // Clear output buffer
-    outputBuffer.clear(0, samplesToProcess);
-
-    // Set input buffer for engine and process
-    audioEngine.setInputBuffer(&inputBuffer);
-
-    // Create AudioSourceChannelInfo for the engine
-    juce::AudioSourceChannelInfo info(&outputBuffer, 0, samplesToProcess);
-    audioEngine.getNextAudioBlock(info);
-
-    // Copy output buffer to device output
-    int outputChans = std::min(numOutputChannels, outputBuffer.getNumChannels());
-    for (int ch = 0; ch < outputChans; ++ch)
-    {
-        if (outputChannelData[ch] != nullptr)
-        {
-            juce::FloatVectorOperations::copy(outputChannelData[ch],
-                                               outputBuffer.getReadPointer(ch),
-                                               samplesToProcess);
-        }
-    }
-
-    // Clear any extra output channels
-    for (int ch = outputChans; ch < numOutputChannels; ++ch)
-    {
-        if (outputChannelData[ch] != nullptr)
-        {
-            juce::FloatVectorOperations::clear(outputChannelData[ch], numSamples);
-        }
-    }
+    // The engine reads the device inputs in place and renders straight into the
+    // device outputs (clearing every output channel it is given)
+    audioEngine.processBlock(inputChannelData, numInputChannels,
+                             outputChannelData, numOutputChannels,
+                             numSamples);
 }
 
 void MainComponent::audioDeviceAboutToStart(juce::AudioIODevice* device)
 {
     if (device != nullptr)
     {
-        // Get total available channels (not just active)
-        int numInputChannels = device->getInputChannelNames().size();
-        int numOutputChannels = device->getOutputChannelNames().size();
         int blockSize = device->getCurrentBufferSizeSamples();
         double sampleRate = device->getCurrentSampleRate();
 
-        // Allocate enough channels for multi-channel interfaces
-        inputBuffer.setSize(std::max(16, numInputChannels), blockSize);
-        outputBuffer.setSize(std::max(16, numOutputChannels), blockSize);
-
+        // Aux outputs on other devices are aligned against what the mains take to play out
+        audioEngine.setMainOutputFormat(device->getActiveOutputChannels().countNumberOfSetBits(),
+                                        device->getOutputLatencyInSamples() + blockSize);
         audioEngine.prepareToPlay(blockSize, sampleRate);
     }
 }
@@ -321,8 +280,6 @@ void MainComponent::audioDeviceAboutToStart(juce::AudioIODevice* device)
 void MainComponent::audioDeviceStopped()
 {
     audioEngine.releaseResources();
-    inputBuffer.setSize(0, 0);
-    outputBuffer.setSize(0, 0);
 }
 
 void MainComponent::paint(juce::Graphics& g)
@@ -350,6 +307,28 @@ void MainComponent::paint(juce::Graphics& g)
     g.drawText("Input: " + juce::String(inputLevel.load(), 3),
                150, 52, 100, 20, juce::Justification::left);
 
+    // DSP load against the buffer deadline (avg / p99 / max over the last blocks)
+    auto load = audioEngine.getProfiler().getLoadStats();
+    g.setColour(load.maximum > 100.0f ? accent : textDim);
+    g.drawText("DSP: " + juce::String(load.average, 1) + "% / p99 " + juce::String(load.p99, 1)
+                   + "% / max " + juce::String(load.maximum, 1) + "%",
+               410, 52, 320, 20, juce::Justification::left);
+
+    // Latency compensation table: main output delay and each aux device's latency
+    const auto& compensator = audioEngine.getLatencyCompensator();
+    if (!compensator.getTable().empty())
+    {
+        juce::String alignment = "Aux align: mains +" + juce::String(compensator.getDelayMs(), 1) + " ms";
+        for (const auto& device : compensator.getTable())
+        {
+            alignment += "  |  " + device.deviceName + " "
+                         + juce::String(compensator.framesToMs(device.totalFrames), 1) + " ms";
+        }
+
+        g.setColour(textDim);
+        g.drawText(alignment, 410, 30, 600, 20, juce::Justification::left);
+    }
+
     // Draw master section
     drawMasterSection(g);
 }
@@ -557,6 +536,22 @@ void MainComponent::resized()
 
 void MainComponent::timerCallback()
 {
+    // Free channels/aux buses the audio thread has finished with
+    audioEngine.reclaimRetiredTopology();
+
+    // Re-measure the aux devices and retarget the main output delay
+    audioEngine.updateLatencyCompensation();
+
+    // Drain the audio thread's timing records; log a stage breakdown after any overrun
+    auto& profiler = audioEngine.getProfiler();
+    profiler.collect();
+
+    if (profiler.getNumOverruns() > loggedOverruns)
+    {
+        loggedOverruns = profiler.getNumOverruns();
+        juce::Logger::writeToLog(profiler.createReport());
+    }
+
     repaint();
 }
 
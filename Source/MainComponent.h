@@ -90,10 +90,10 @@ private:
     void updateMasterChannelOptions();
     void updateChaosAmount();
 
-    // Audio buffers
-    juce::AudioBuffer<float> inputBuffer;
-    juce::AudioBuffer<float> outputBuffer;
     std::atomic<float> inputLevel { 0.0f };  // Debug: input level
 
+    // DSP load: overruns already written to the log
+    int loggedOverruns = 0;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
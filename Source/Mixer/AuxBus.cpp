@@ -4,7 +4,6 @@
 */
 
 #include "AuxBus.h"
-#include "../Core/RtAudioManager.h"
 
 namespace Kousaten {
 
@@ -18,6 +17,17 @@ AuxBus::AuxBus(int busId)
     processedBuffer.clear();
 }
 
+AuxBus::~AuxBus()
+{
+    // Queued switches refer to deviceStream. Retired buses are no longer rendered, so the
+    // device can be left without a fade.
+    if (rtAudioManager != nullptr)
+    {
+        rtAudioManager->cancelDeviceOperations(this);
+        rtAudioManager->detachFromDevice(deviceStream, false);
+    }
+}
+
 void AuxBus::setOutputDevice(const juce::String& deviceName)
 {
     if (outputDeviceName != deviceName)
@@ -51,6 +61,8 @@ void AuxBus::prepareToPlay(int samplesPerBlock, double sampleRate)
     buffer.clear();
     processedBuffer.setSize(2, samplesPerBlock);
     processedBuffer.clear();
+    inserts.prepare(sampleRate, samplesPerBlock);
+    mainAlignment.prepare(2, InsertChain::getMaxLatencySamples(sampleRate), samplesPerBlock);
 
     // Update RtAudio stream with new parameters
     if (rtAudioManager != nullptr)
@@ -82,6 +94,8 @@ void AuxBus::addToBuffer(const float* leftChannel, const float* rightChannel, in
 
 void AuxBus::process(float* outputLeft, float* outputRight, int numSamples)
 {
+    inserts.process(buffer.getWritePointer(0), buffer.getWritePointer(1), numSamples);
+
     auto* bufferL = buffer.getReadPointer(0);
     auto* bufferR = buffer.getReadPointer(1);
 
@@ -106,53 +120,84 @@ void AuxBus::process(float* outputLeft, float* outputRight, int numSamples)
     outputLevel = maxLevel;
 }
 
+void AuxBus::alignToMainOutputs(float* outputLeft, float* outputRight, int numSamples, int mainInsertLatency)
+{
+    float* const outputs[] = { outputLeft, outputRight };
+    mainAlignment.process(outputs, 2, numSamples, mainInsertLatency - inserts.getLatencySamples());
+}
+
 void AuxBus::sendToDevice(int numSamples)
 {
-    // Send to RtAudio device if stream is active
-    if (rtAudioManager != nullptr && rtStreamId >= 0)
-    {
-        rtAudioManager->writeToStream(rtStreamId,
-                                      processedBuffer.getReadPointer(0),
-                                      processedBuffer.getReadPointer(1),
-                                      numSamples);
-    }
+    // No lock or lookup: the handle points straight at the device's shared stream (or
+    // nowhere); the bus mixes into its own channels of the device's next block
+    deviceStream.write(processedBuffer.getReadPointer(0),
+                       processedBuffer.getReadPointer(1),
+                       numSamples,
+                       outputChannelStart,
+                       stereoMode ? 2 : 1);
+}
+
+int AuxBus::getDeviceOverruns() const
+{
+    return deviceStream.getStreamStats().overruns;
+}
+
+int AuxBus::getDeviceUnderruns() const
+{
+    return deviceStream.getStreamStats().underruns;
+}
+
+double AuxBus::getDeviceDriftPpm() const
+{
+    return deviceStream.getStreamStats().driftPpm;
+}
+
+int AuxBus::getDeviceLatencyFrames() const
+{
+    const int streamLatency = deviceStream.getStreamStats().latencyFrames;
+    return streamLatency > 0 ? streamLatency + inserts.getLatencySamples() : 0;
 }
 
 void AuxBus::updateRtStream()
 {
     if (rtAudioManager == nullptr) return;
 
-    // Capture current state for async operation
+    // Capture current state for the control thread; the bus itself is only touched again
+    // on the message thread, once the switch has completed
     juce::String deviceName = outputDeviceName;
-    int channelStart = outputChannelStart;
-    bool stereo = stereoMode;
     int busId = id;
-
-    // Use async switching to prevent UI thread blocking
-    rtAudioManager->switchDeviceAsync([this, deviceName, channelStart, stereo, busId]() {
-        // Destroy existing stream
-        if (rtStreamId >= 0)
-        {
-            rtAudioManager->destroyOutputStream(rtStreamId);
-            rtStreamId = -1;
-        }
-
-        // Create new stream if device is valid
-        if (deviceName.isNotEmpty() && deviceName != "None")
-        {
-            rtStreamId = rtAudioManager->createOutputStream(
-                deviceName,
-                static_cast<unsigned int>(std::max(0, channelStart)),
-                stereo ? 2 : 1
-            );
-
-            if (rtStreamId >= 0)
-            {
-                DBG("AuxBus " + juce::String(busId) + ": Created RtAudio stream " +
-                    juce::String(rtStreamId) + " for device: " + deviceName);
-            }
-        }
-    });
+    auto* manager = rtAudioManager;
+    auto* handle = &deviceStream;
+    const bool wantsDevice = deviceName.isNotEmpty() && deviceName != "None";
+
+    deviceSwitchPending = true;
+
+    juce::WeakReference<AuxBus> weakThis(this);
+
+    // The manager opens the device's stream on first use and shares it with every other
+    // bus on the same device; the bus crossfades from its previous device to the new one
+    rtAudioManager->switchDeviceAsync(this,
+        [manager, handle, deviceName, wantsDevice]() {
+            if (wantsDevice)
+                return manager->attachToDevice(*handle, deviceName);
+
+            manager->detachFromDevice(*handle);
+            return true;
+        },
+        [weakThis, deviceName, wantsDevice, busId](bool succeeded) {
+            auto* bus = weakThis.get();
+            if (bus == nullptr)
+                return;
+
+            bus->deviceSwitchPending = false;
+            bus->deviceOpenFailed = !succeeded;
+            bus->rtDeviceName = wantsDevice && succeeded ? deviceName : juce::String();
+
+            if (!succeeded)
+                DBG("AuxBus " + juce::String(busId) + ": Failed to open device: " + deviceName);
+            else if (wantsDevice)
+                DBG("AuxBus " + juce::String(busId) + ": Routed to device: " + deviceName);
+        });
 }
 
 } // namespace Kousaten
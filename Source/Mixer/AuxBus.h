@@ -6,16 +6,21 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "../Core/RtAudioManager.h"
+#include "../Core/LatencyCompensator.h"
+#include "InsertChain.h"
 
 namespace Kousaten {
 
-// Forward declaration
-class RtAudioManager;
-
 class AuxBus
 {
 public:
+    // Aux IDs are reused (lowest free first) and stay below this, so they can index
+    // dense per-aux tables directly
+    static constexpr int MAX_AUX_BUSES = 32;
+
     AuxBus(int busId);
+    ~AuxBus();
 
     int getId() const { return id; }
 
@@ -34,6 +39,10 @@ public:
     int getOutputChannelStart() const { return outputChannelStart; }
     bool isStereo() const { return stereoMode; }
 
+    // Device switches run on the RtAudio manager's control thread (message thread getters)
+    bool isDeviceSwitchPending() const { return deviceSwitchPending; }
+    bool didDeviceOpenFail() const { return deviceOpenFailed; }
+
     // Return level (master fader for this aux)
     void setReturnLevel(float level);
     float getReturnLevel() const { return returnLevel; }
@@ -41,22 +50,48 @@ public:
     // Metering
     float getOutputLevel() const { return outputLevel; }
 
+    // Inserts, before the return level (slot settings from the message thread)
+    InsertChain& getInserts() { return inserts; }
+
     // Audio processing
     void prepareToPlay(int samplesPerBlock, double sampleRate);
     void clearBuffer();
     void addToBuffer(const float* leftChannel, const float* rightChannel, int numSamples, float sendLevel);
     void process(float* outputLeft, float* outputRight, int numSamples);
 
-    // Send processed audio to RtAudio device
+    // Audio thread, after process(): delay the block written to the main outputs from
+    // this bus's inserts' latency to mainInsertLatency, the most any bus on the main
+    // device has (the device send is compensated separately)
+    void alignToMainOutputs(float* outputLeft, float* outputRight, int numSamples, int mainInsertLatency);
+
+    // Send processed audio to RtAudio device (wait-free)
     void sendToDevice(int numSamples);
 
+    // Blocks that never reached the RtAudio device because its stream was being switched
+    int getNumDroppedDeviceBlocks() const { return deviceStream.getNumDroppedBlocks(); }
+
+    // Ring xruns of the device's shared RtAudio stream, as of the bus's last block (any
+    // thread, lock-free; 0 without a stream)
+    int getDeviceOverruns() const;
+    int getDeviceUnderruns() const;
+
+    // Measured clock drift of the RtAudio device against the engine, in ppm (any thread)
+    double getDeviceDriftPpm() const;
+
+    // Engine-to-output latency of the RtAudio device in frames, including the inserts'
+    // lookahead (any thread; 0 while unknown)
+    int getDeviceLatencyFrames() const;
+
 private:
     int id;
     juce::String name;
 
     // RtAudio manager
     RtAudioManager* rtAudioManager = nullptr;
-    int rtStreamId = -1;  // -1 = no stream
+    juce::String rtDeviceName;    // Device deviceStream is attached to, if any (message thread)
+    RtStreamHandle deviceStream;  // What the audio thread writes to
+    bool deviceSwitchPending = false;
+    bool deviceOpenFailed = false;
 
     // Output routing
     juce::String outputDeviceName = "None";
@@ -67,6 +102,9 @@ private:
     float returnLevel = 1.0f;
     float outputLevel = 0.0f;
 
+    InsertChain inserts;
+    CompensationDelay mainAlignment;
+
     // Audio buffer
     juce::AudioBuffer<float> buffer;
     juce::AudioBuffer<float> processedBuffer;  // For sending to RtAudio
@@ -75,6 +113,7 @@ private:
 
     void updateRtStream();
 
+    JUCE_DECLARE_WEAK_REFERENCEABLE(AuxBus)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AuxBus)
 };
 
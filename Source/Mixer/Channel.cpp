@@ -15,6 +15,34 @@ Channel::Channel(int channelId)
     smoothedPan.setCurrentAndTargetValue(pan);
 }
 
+namespace {
+
+// Constant power pan gains for pan in -1.0 (L) to 1.0 (R)
+inline void getPanGains(float pan, float& leftGain, float& rightGain)
+{
+    float angle = (pan + 1.0f) * 0.25f * juce::MathConstants<float>::pi;
+    leftGain = std::cos(angle);
+    rightGain = std::sin(angle);
+}
+
+inline float getPeak(const float* data, int numSamples)
+{
+    auto range = juce::FloatVectorOperations::findMinAndMax(data, numSamples);
+    return std::max(-range.getStart(), range.getEnd());
+}
+
+} // namespace
+
+void Channel::prepare(double sampleRate, int maxBlockSize)
+{
+    currentSampleRate = sampleRate;
+
+    smoothedVolume.reset(sampleRate, 0.02);  // 20ms smoothing
+    smoothedPan.reset(sampleRate, 0.02);
+
+    gainRampBuffer.setSize(2, maxBlockSize);
+}
+
 void Channel::setVolume(float newVolume)
 {
     volume = juce::jlimit(0.0f, 1.0f, newVolume);
@@ -54,51 +82,41 @@ void Channel::setReverbSend(float amount)
 
 void Channel::setAuxSend(int auxId, float amount)
 {
-    auxSends[auxId] = juce::jlimit(0.0f, 1.0f, amount);
+    if (juce::isPositiveAndBelow(auxId, AuxBus::MAX_AUX_BUSES))
+        auxSendLevels[static_cast<size_t>(auxId)] = juce::jlimit(0.0f, 1.0f, amount);
 }
 
 float Channel::getAuxSend(int auxId) const
 {
-    auto it = auxSends.find(auxId);
-    if (it != auxSends.end())
-        return it->second;
+    if (juce::isPositiveAndBelow(auxId, AuxBus::MAX_AUX_BUSES))
+        return auxSendLevels[static_cast<size_t>(auxId)];
     return 0.0f;
 }
 
 void Channel::removeAuxSend(int auxId)
 {
-    auxSends.erase(auxId);
+    if (juce::isPositiveAndBelow(auxId, AuxBus::MAX_AUX_BUSES))
+        auxSendLevels[static_cast<size_t>(auxId)] = 0.0f;
     sendPanner.removeAuxPosition(auxId);
 }
 
-std::map<int, float> Channel::getPannedAuxSendLevels() const
+void Channel::updatePannedAuxSendGains()
 {
-    std::map<int, float> result;
-
     if (!sendPanner.isEnabled())
     {
-        // Return static aux send levels when panner is disabled
-        return auxSends;
+        // Static aux send levels when panner is disabled
+        pannedAuxSendGains = auxSendLevels;
+        return;
     }
 
-    // Get panner distribution weights
-    auto pannerLevels = sendPanner.calculateSendLevels();
+    // Panner distribution weights (aux buses without a position keep full level)
+    std::array<float, AuxBus::MAX_AUX_BUSES> pannerWeights;
+    pannerWeights.fill(1.0f);
+    sendPanner.calculateSendGains(pannerWeights.data());
 
-    // Combine static levels with panner modulation
-    for (const auto& [auxId, staticLevel] : auxSends)
-    {
-        float pannerWeight = 1.0f;
-        auto it = pannerLevels.find(auxId);
-        if (it != pannerLevels.end())
-        {
-            pannerWeight = it->second;
-        }
-
-        // Multiply static level by panner weight
-        result[auxId] = staticLevel * pannerWeight;
-    }
-
-    return result;
+    // Multiply static level by panner weight
+    for (size_t i = 0; i < pannedAuxSendGains.size(); ++i)
+        pannedAuxSendGains[i] = auxSendLevels[i] * pannerWeights[i];
 }
 
 void Channel::setInputDevice(const juce::String& deviceName)
@@ -117,75 +135,107 @@ void Channel::setStereo(bool stereo)
     stereoMode = stereo;
 }
 
-void Channel::process(const float* inputLeft, const float* inputRight,
-                      float* outputLeft, float* outputRight,
-                      float* delaySendLeft, float* delaySendRight,
-                      float* grainSendLeft, float* grainSendRight,
-                      float* reverbSendLeft, float* reverbSendRight,
-                      int numSamples)
+void Channel::processAndAccumulate(const float* inputLeft, const float* inputRight,
+                                   float* outputLeft, float* outputRight,
+                                   float* delayBusLeft, float* delayBusRight,
+                                   float* grainBusLeft, float* grainBusRight,
+                                   float* reverbBusLeft, float* reverbBusRight,
+                                   int numSamples)
 {
     // Update input level
-    float maxInput = 0.0f;
-    for (int i = 0; i < numSamples; ++i)
-    {
-        maxInput = std::max(maxInput, std::abs(inputLeft[i]));
-        maxInput = std::max(maxInput, std::abs(inputRight[i]));
-    }
-    inputLevel = maxInput;
+    inputLevel = std::max(getPeak(inputLeft, numSamples), getPeak(inputRight, numSamples));
 
-    // If muted, output silence
+    // If muted, output silence and leave the send buses untouched
     if (muted)
     {
-        std::fill(outputLeft, outputLeft + numSamples, 0.0f);
-        std::fill(outputRight, outputRight + numSamples, 0.0f);
-        std::fill(delaySendLeft, delaySendLeft + numSamples, 0.0f);
-        std::fill(delaySendRight, delaySendRight + numSamples, 0.0f);
-        std::fill(grainSendLeft, grainSendLeft + numSamples, 0.0f);
-        std::fill(grainSendRight, grainSendRight + numSamples, 0.0f);
-        std::fill(reverbSendLeft, reverbSendLeft + numSamples, 0.0f);
-        std::fill(reverbSendRight, reverbSendRight + numSamples, 0.0f);
+        juce::FloatVectorOperations::clear(outputLeft, numSamples);
+        juce::FloatVectorOperations::clear(outputRight, numSamples);
+        pannedAuxSendGains.fill(0.0f);
         outputLevel = 0.0f;
         return;
     }
 
-    float maxOutput = 0.0f;
+    // Without scratch space (prepare() not called) jump straight to the targets
+    if (gainRampBuffer.getNumSamples() == 0)
+    {
+        smoothedVolume.setCurrentAndTargetValue(smoothedVolume.getTargetValue());
+        smoothedPan.setCurrentAndTargetValue(smoothedPan.getTargetValue());
+    }
 
-    for (int i = 0; i < numSamples; ++i)
+    if (smoothedVolume.isSmoothing() || smoothedPan.isSmoothing())
     {
-        float vol = smoothedVolume.getNextValue();
-        float p = smoothedPan.getNextValue();
-
-        // Apply volume
-        float left = inputLeft[i] * vol;
-        float right = inputRight[i] * vol;
-
-        // Apply pan (constant power panning)
-        float leftGain = std::cos((p + 1.0f) * 0.25f * juce::MathConstants<float>::pi);
-        float rightGain = std::sin((p + 1.0f) * 0.25f * juce::MathConstants<float>::pi);
-
-        left *= leftGain;
-        right *= rightGain;
-
-        // Direct output
-        outputLeft[i] = left;
-        outputRight[i] = right;
-
-        // Send outputs (post-fader, post-pan)
-        delaySendLeft[i] = left * delaySend;
-        delaySendRight[i] = right * delaySend;
-        grainSendLeft[i] = left * grainSend;
-        grainSendRight[i] = right * grainSend;
-        reverbSendLeft[i] = left * reverbSend;
-        reverbSendRight[i] = right * reverbSend;
-
-        maxOutput = std::max(maxOutput, std::abs(left));
-        maxOutput = std::max(maxOutput, std::abs(right));
+        applyGainRamp(inputLeft, inputRight, outputLeft, outputRight, numSamples);
+    }
+    else
+    {
+        // Fast path: parameters are steady, apply one gain per side
+        float leftGain, rightGain;
+        getPanGains(smoothedPan.getTargetValue(), leftGain, rightGain);
+
+        float vol = smoothedVolume.getTargetValue();
+        juce::FloatVectorOperations::copyWithMultiply(outputLeft, inputLeft, vol * leftGain, numSamples);
+        juce::FloatVectorOperations::copyWithMultiply(outputRight, inputRight, vol * rightGain, numSamples);
     }
 
-    outputLevel = maxOutput;
+    // Send outputs (post-fader, post-pan), multiply-added into the bus sums
+    auto accumulateSend = [&](float level, float* busLeft, float* busRight) {
+        if (level <= 0.0f)
+            return;
+
+        juce::FloatVectorOperations::addWithMultiply(busLeft, outputLeft, level, numSamples);
+        juce::FloatVectorOperations::addWithMultiply(busRight, outputRight, level, numSamples);
+    };
+
+    accumulateSend(delaySend, delayBusLeft, delayBusRight);
+    accumulateSend(grainSend, grainBusLeft, grainBusRight);
+    accumulateSend(reverbSend, reverbBusLeft, reverbBusRight);
+
+    outputLevel = std::max(getPeak(outputLeft, numSamples), getPeak(outputRight, numSamples));
+
+    // Update send panner automation (for non-XYPad modes), then this block's aux gains
+    sendPanner.process(numSamples, currentSampleRate);
+    updatePannedAuxSendGains();
+}
 
-    // Update send panner automation (for non-XYPad modes)
-    sendPanner.process(numSamples, 48000.0);  // TODO: pass actual sample rate
+void Channel::applyGainRamp(const float* inputLeft, const float* inputRight,
+                            float* outputLeft, float* outputRight, int numSamples)
+{
+    float* leftGains = gainRampBuffer.getWritePointer(0);
+    float* rightGains = gainRampBuffer.getWritePointer(1);
+    const int capacity = gainRampBuffer.getNumSamples();
+
+    for (int offset = 0; offset < numSamples; offset += capacity)
+    {
+        int count = std::min(capacity, numSamples - offset);
+
+        if (smoothedPan.isSmoothing())
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                float vol = smoothedVolume.getNextValue();
+                float leftGain, rightGain;
+                getPanGains(smoothedPan.getNextValue(), leftGain, rightGain);
+                leftGains[i] = vol * leftGain;
+                rightGains[i] = vol * rightGain;
+            }
+        }
+        else
+        {
+            // Only the volume is ramping, pan gains are constant for the block
+            float leftGain, rightGain;
+            getPanGains(smoothedPan.getTargetValue(), leftGain, rightGain);
+
+            for (int i = 0; i < count; ++i)
+            {
+                float vol = smoothedVolume.getNextValue();
+                leftGains[i] = vol * leftGain;
+                rightGains[i] = vol * rightGain;
+            }
+        }
+
+        juce::FloatVectorOperations::multiply(outputLeft + offset, inputLeft + offset, leftGains, count);
+        juce::FloatVectorOperations::multiply(outputRight + offset, inputRight + offset, rightGains, count);
+    }
 }
 
 } // namespace Kousaten
@@ -7,7 +7,7 @@
 
 #include <JuceHeader.h>
 #include "SendPanner.h"
-#include <map>
+#include <array>
 #include <memory>
 
 namespace Kousaten {
@@ -17,6 +17,9 @@ class Channel
 public:
     Channel(int channelId = 0);
 
+    // Prepare smoothing and scratch buffers (call before processing)
+    void prepare(double sampleRate, int maxBlockSize);
+
     void setVolume(float volume);
     void setPan(float pan);  // -1.0 (L) to 1.0 (R)
     void setMute(bool mute);
@@ -35,18 +38,19 @@ public:
     float getGrainSend() const { return grainSend; }
     float getReverbSend() const { return reverbSend; }
 
-    // Dynamic aux sends
+    // Dynamic aux sends (auxId < AuxBus::MAX_AUX_BUSES)
     void setAuxSend(int auxId, float amount);
     float getAuxSend(int auxId) const;
     void removeAuxSend(int auxId);
-    const std::map<int, float>& getAllAuxSends() const { return auxSends; }
 
     // Send Panner for dynamic aux send distribution
     SendPanner* getSendPanner() { return &sendPanner; }
     const SendPanner* getSendPanner() const { return &sendPanner; }
 
-    // Get panned aux send levels (combines static levels with panner modulation)
-    std::map<int, float> getPannedAuxSendLevels() const;
+    // Panned aux send gains indexed by aux ID (static level x panner weight, 0 = no send).
+    // This channel's row of the channel x aux send matrix; refreshed in place every block
+    // by processAndAccumulate.
+    const float* getPannedAuxSendGains() const { return pannedAuxSendGains.data(); }
 
     float getInputLevel() const { return inputLevel; }
     float getOutputLevel() const { return outputLevel; }
@@ -64,14 +68,14 @@ public:
     int getInputChannelStart() const { return inputChannelStart; }
     bool isStereo() const { return stereoMode; }
 
-    // Process audio and return outputs
-    // Returns: direct output, delay send, grain send, reverb send
-    void process(const float* inputLeft, const float* inputRight,
-                 float* outputLeft, float* outputRight,
-                 float* delaySendLeft, float* delaySendRight,
-                 float* grainSendLeft, float* grainSendRight,
-                 float* reverbSendLeft, float* reverbSendRight,
-                 int numSamples);
+    // Process audio into the direct output and add the post-fader sends
+    // straight into the send bus sums (sends at zero level are skipped)
+    void processAndAccumulate(const float* inputLeft, const float* inputRight,
+                              float* outputLeft, float* outputRight,
+                              float* delayBusLeft, float* delayBusRight,
+                              float* grainBusLeft, float* grainBusRight,
+                              float* reverbBusLeft, float* reverbBusRight,
+                              int numSamples);
 
 private:
     int id;
@@ -86,8 +90,9 @@ private:
     float grainSend = 0.0f;
     float reverbSend = 0.0f;
 
-    // Dynamic aux sends (auxId -> level)
-    std::map<int, float> auxSends;
+    // Dense aux send rows indexed by aux ID (cache-line aligned, never reallocated)
+    alignas(64) std::array<float, AuxBus::MAX_AUX_BUSES> auxSendLevels {};
+    alignas(64) std::array<float, AuxBus::MAX_AUX_BUSES> pannedAuxSendGains {};
 
     // Send Panner for dynamic distribution
     SendPanner sendPanner;
@@ -103,6 +108,17 @@ private:
     // Smoothed parameters to avoid clicks
     juce::SmoothedValue<float> smoothedVolume;
     juce::SmoothedValue<float> smoothedPan;
+
+    double currentSampleRate = 48000.0;
+
+    // Per-sample L/R gains, only filled while volume or pan is ramping
+    juce::AudioBuffer<float> gainRampBuffer;
+
+    void applyGainRamp(const float* inputLeft, const float* inputRight,
+                       float* outputLeft, float* outputRight, int numSamples);
+
+    // Recompute pannedAuxSendGains from the static levels and the panner position
+    void updatePannedAuxSendGains();
 };
 
 } // namespace Kousaten
@@ -0,0 +1,147 @@
+/*
+    Kousaten Mixer - Insert Chain
+    Implementation
+*/
+
+#include "InsertChain.h"
+
+namespace Kousaten {
+
+void InsertChain::prepare(double sampleRate, int maxBlockSize)
+{
+    eq.prepare(sampleRate);
+    compressor.prepare(sampleRate);
+    limiter.prepare(sampleRate);
+
+    dryBuffer.setSize(2, maxBlockSize);
+    dryBuffer.clear();
+
+    // Running slots start over from the new state
+    for (int slot = 0; slot < NUM_SLOTS; ++slot)
+        slotRunning[static_cast<size_t>(slot)] = slotEnabled[static_cast<size_t>(slot)].load(std::memory_order_relaxed);
+}
+
+void InsertChain::reset()
+{
+    for (int slot = 0; slot < NUM_SLOTS; ++slot)
+        resetSlot(slot);
+}
+
+void InsertChain::setSlotEnabled(Slot slot, bool enabled)
+{
+    slotEnabled[static_cast<size_t>(slot)].store(enabled, std::memory_order_relaxed);
+}
+
+int InsertChain::getLatencySamples() const
+{
+    return isSlotEnabled(LimiterSlot) ? limiter.getLatencySamples() : 0;
+}
+
+void InsertChain::process(float* left, float* right, int numSamples)
+{
+    jassert(numSamples <= dryBuffer.getNumSamples());
+
+    juce::ScopedNoDenormals noDenormals;
+
+    for (int slot = 0; slot < NUM_SLOTS; ++slot)
+    {
+        const bool enabled = slotEnabled[static_cast<size_t>(slot)].load(std::memory_order_relaxed);
+        const bool running = slotRunning[static_cast<size_t>(slot)];
+
+        if (!enabled && !running)
+            continue;
+
+        if (enabled == running)
+        {
+            processSlot(slot, left, right, numSamples);
+            continue;
+        }
+
+        // Switched: crossfade between the slot's input and output over this block. A slot
+        // coming in starts from a clean state rather than whatever it held when it went out.
+        if (enabled)
+            resetSlot(slot);
+
+        if (slot == LimiterSlot)
+        {
+            switchLimiter(left, right, numSamples, enabled);
+            slotRunning[LimiterSlot] = enabled;
+            continue;
+        }
+
+        dryBuffer.copyFrom(0, 0, left, numSamples);
+        dryBuffer.copyFrom(1, 0, right, numSamples);
+        processSlot(slot, left, right, numSamples);
+
+        const auto* dryLeft = dryBuffer.getReadPointer(0);
+        const auto* dryRight = dryBuffer.getReadPointer(1);
+        const float step = 1.0f / static_cast<float>(numSamples);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float ramp = step * static_cast<float>(i + 1);
+            const float wet = enabled ? ramp : 1.0f - ramp;
+            left[i] = dryLeft[i] + wet * (left[i] - dryLeft[i]);
+            right[i] = dryRight[i] + wet * (right[i] - dryRight[i]);
+        }
+
+        slotRunning[static_cast<size_t>(slot)] = enabled;
+    }
+}
+
+void InsertChain::switchLimiter(float* left, float* right, int numSamples, bool enabled)
+{
+    // The limited signal is a lookahead behind the dry one, so mixing the two would comb.
+    // The old path fades out over the first half of the block and the new one in over the
+    // second; the dry half is held to the ceiling, so no sample of the block exceeds it.
+    dryBuffer.copyFrom(0, 0, left, numSamples);
+    dryBuffer.copyFrom(1, 0, right, numSamples);
+    limiter.process(left, right, numSamples);
+
+    const auto* dryLeft = dryBuffer.getReadPointer(0);
+    const auto* dryRight = dryBuffer.getReadPointer(1);
+    const float ceiling = juce::Decibels::decibelsToGain(limiter.getCeiling());
+    const int half = numSamples / 2;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const bool fadingOut = i < half;
+        const float gain = fadingOut ? 1.0f - static_cast<float>(i + 1) / static_cast<float>(half)
+                                     : static_cast<float>(i - half + 1) / static_cast<float>(numSamples - half);
+
+        if (fadingOut == enabled)
+        {
+            left[i] = gain * juce::jlimit(-ceiling, ceiling, dryLeft[i]);
+            right[i] = gain * juce::jlimit(-ceiling, ceiling, dryRight[i]);
+        }
+        else
+        {
+            left[i] *= gain;
+            right[i] *= gain;
+        }
+    }
+}
+
+void InsertChain::processSlot(int slot, float* left, float* right, int numSamples)
+{
+    switch (slot)
+    {
+        case EqSlot:         eq.process(left, right, numSamples); break;
+        case CompressorSlot: compressor.process(left, right, numSamples); break;
+        case LimiterSlot:    limiter.process(left, right, numSamples); break;
+        default:             break;
+    }
+}
+
+void InsertChain::resetSlot(int slot)
+{
+    switch (slot)
+    {
+        case EqSlot:         eq.reset(); break;
+        case CompressorSlot: compressor.reset(); break;
+        case LimiterSlot:    limiter.reset(); break;
+        default:             break;
+    }
+}
+
+} // namespace Kousaten
@@ -0,0 +1,73 @@
+/*
+    Kousaten Mixer - Insert Chain
+    Fixed insert slots of an aux bus: EQ, compressor and limiter, in that order
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Effects/EqProcessor.h"
+#include "../Effects/CompressorProcessor.h"
+#include "../Effects/LimiterProcessor.h"
+#include <array>
+#include <atomic>
+
+namespace Kousaten {
+
+// Every slot is allocated by prepare(), so switching one on or off never allocates. A
+// slot that is off costs one flag check per block. Switching the EQ or compressor
+// crossfades over one block; switching the limiter dips the bus over one block instead,
+// since its output is a lookahead behind its input.
+class InsertChain
+{
+public:
+    enum Slot
+    {
+        EqSlot,
+        CompressorSlot,
+        LimiterSlot,
+        NUM_SLOTS
+    };
+
+    InsertChain() = default;
+
+    void prepare(double sampleRate, int maxBlockSize);
+    void reset();
+
+    // Message thread: slots start off
+    void setSlotEnabled(Slot slot, bool enabled);
+    bool isSlotEnabled(Slot slot) const { return slotEnabled[slot].load(std::memory_order_relaxed); }
+
+    // Delay the chain adds: the limiter's lookahead while it is on (any thread)
+    int getLatencySamples() const;
+
+    // The most getLatencySamples() can return at a sample rate
+    static int getMaxLatencySamples(double sampleRate) { return LimiterProcessor::getLatencySamples(sampleRate); }
+
+    // Message thread: settings of each slot
+    EqProcessor& getEq() { return eq; }
+    CompressorProcessor& getCompressor() { return compressor; }
+    LimiterProcessor& getLimiter() { return limiter; }
+
+    // Audio thread: run the enabled slots in place (up to maxBlockSize samples)
+    void process(float* left, float* right, int numSamples);
+
+private:
+    EqProcessor eq;
+    CompressorProcessor compressor;
+    LimiterProcessor limiter;
+
+    std::array<std::atomic<bool>, NUM_SLOTS> slotEnabled {};
+    std::array<bool, NUM_SLOTS> slotRunning {};  // Audio thread's view
+
+    // The slot's input while it crossfades in or out
+    juce::AudioBuffer<float> dryBuffer;
+
+    void processSlot(int slot, float* left, float* right, int numSamples);
+    void resetSlot(int slot);
+    void switchLimiter(float* left, float* right, int numSamples, bool enabled);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InsertChain)
+};
+
+} // namespace Kousaten
@@ -11,28 +11,59 @@ MixBus::MixBus(BusType busType)
     : type(busType)
 {
     smoothedReturnLevel.setCurrentAndTargetValue(returnLevel);
+
+    switch (type)
+    {
+        case BusType::Delay:
+            delayProcessor = std::make_unique<DelayProcessor>();
+            break;
+
+        case BusType::Grain:
+            grainProcessorLeft = std::make_unique<GrainProcessor>();
+            grainProcessorRight = std::make_unique<GrainProcessor>();
+            break;
+
+        case BusType::Reverb:
+            reverbProcessor = std::make_unique<ReverbProcessor>();
+            break;
+    }
 }
 
 void MixBus::prepare(double newSampleRate, int samplesPerBlock)
 {
     sampleRate = newSampleRate;
     smoothedReturnLevel.reset(sampleRate, 0.02);  // 20ms smoothing
+    chaosBuffer.setSize(2, samplesPerBlock);
+
+    if (delayProcessor != nullptr)
+        delayProcessor->prepare(sampleRate);
+
+    if (grainProcessorLeft != nullptr)
+    {
+        grainProcessorLeft->reset();
+        grainProcessorRight->reset();
+    }
+
+    if (reverbProcessor != nullptr)
+        reverbProcessor->prepare(sampleRate);
 
-    delayProcessor.reset();
-    grainProcessorLeft.reset();
-    grainProcessorRight.reset();
-    reverbProcessorLeft.reset();
-    reverbProcessorRight.reset();
     chaosGenerator.reset();
 }
 
 void MixBus::reset()
 {
-    delayProcessor.reset();
-    grainProcessorLeft.reset();
-    grainProcessorRight.reset();
-    reverbProcessorLeft.reset();
-    reverbProcessorRight.reset();
+    if (delayProcessor != nullptr)
+        delayProcessor->reset();
+
+    if (grainProcessorLeft != nullptr)
+    {
+        grainProcessorLeft->reset();
+        grainProcessorRight->reset();
+    }
+
+    if (reverbProcessor != nullptr)
+        reverbProcessor->reset();
+
     chaosGenerator.reset();
 }
 
@@ -53,6 +84,28 @@ void MixBus::setDelayFeedback(float feedback)
     delayFeedback = juce::jlimit(0.0f, 0.95f, feedback);
 }
 
+void MixBus::setDelayInterpolation(DelayProcessor::Interpolation interpolation)
+{
+    delayInterpolation = interpolation;
+}
+
+void MixBus::setDelayModulation(float depthMs, float rateHz)
+{
+    delayModulationDepth = juce::jlimit(0.0f, DelayProcessor::MAX_MODULATION_MS, depthMs);
+    delayModulationRate = juce::jlimit(0.05f, 10.0f, rateHz);
+}
+
+void MixBus::setDelaySync(DelayProcessor::NoteDivision left, DelayProcessor::NoteDivision right)
+{
+    delaySyncLeft = left;
+    delaySyncRight = right;
+}
+
+void MixBus::setDelayTempo(double bpm)
+{
+    delayTempo = juce::jlimit(20.0, 300.0, bpm);
+}
+
 void MixBus::setGrainSize(float size)
 {
     grainSize = juce::jlimit(0.0f, 1.0f, size);
@@ -83,6 +136,12 @@ void MixBus::setReverbDecay(float decay)
     reverbDecay = juce::jlimit(0.0f, 1.0f, decay);
 }
 
+void MixBus::setReverbModulation(float depthMs, float rateHz)
+{
+    reverbModulationDepth = juce::jlimit(0.0f, ReverbProcessor::MAX_MODULATION_MS, depthMs);
+    reverbModulationRate = juce::jlimit(0.05f, 5.0f, rateHz);
+}
+
 void MixBus::setChaosAmount(float amount)
 {
     chaosAmount = juce::jlimit(0.0f, 1.0f, amount);
@@ -97,66 +156,86 @@ void MixBus::process(const float* inputLeft, const float* inputRight,
                      float* outputLeft, float* outputRight,
                      int numSamples)
 {
-    float maxOutput = 0.0f;
+    jassert(numSamples <= chaosBuffer.getNumSamples());
+
+    const auto rate = static_cast<float>(sampleRate);
+    const float* const inputs[] = { inputLeft, inputRight };
+    float* const outputs[] = { outputLeft, outputRight };
 
-    for (int i = 0; i < numSamples; ++i)
+    // Chaos modulation for the block, one value per sample
+    const float* chaos = nullptr;
+    if (chaosAmount > 0.0f)
     {
-        float chaosOutput = 0.0f;
-        if (chaosAmount > 0.0f)
+        float* chaosData = chaosBuffer.getWritePointer(0);
+        for (int i = 0; i < numSamples; ++i)
+            chaosData[i] = chaosGenerator.process(chaosRate);
+        chaos = chaosData;
+    }
+
+    // Parameters are latched once per block
+    switch (type)
+    {
+        case BusType::Delay:
         {
-            chaosOutput = chaosGenerator.process(chaosRate);
+            using Division = DelayProcessor::NoteDivision;
+            const float timeLeft = delaySyncLeft != Division::Free
+                ? DelayProcessor::getSyncedTime(delaySyncLeft, delayTempo) : delayTimeLeft;
+            const float timeRight = delaySyncRight != Division::Free
+                ? DelayProcessor::getSyncedTime(delaySyncRight, delayTempo) : delayTimeRight;
+
+            delayProcessor->setParameters(timeLeft, timeRight, delayFeedback, chaosAmount);
+            delayProcessor->setInterpolation(delayInterpolation);
+            delayProcessor->setModulation(delayModulationDepth, delayModulationRate);
+            delayProcessor->processBlock(inputs, outputs, numSamples, chaos);
+            break;
         }
 
-        float left = inputLeft[i];
-        float right = inputRight[i];
-        float outLeft = 0.0f;
-        float outRight = 0.0f;
-
-        switch (type)
+        case BusType::Grain:
         {
-            case BusType::Delay:
+            // The right channel's grains move against the left's
+            const float* invertedChaos = nullptr;
+            if (chaos != nullptr)
             {
-                delayProcessor.setParameters(delayTimeLeft, delayTimeRight,
-                                             delayFeedback, static_cast<float>(sampleRate));
-                delayProcessor.process(left, right, outLeft, outRight);
-                break;
+                juce::FloatVectorOperations::negate(chaosBuffer.getWritePointer(1), chaos, numSamples);
+                invertedChaos = chaosBuffer.getReadPointer(1);
             }
 
-            case BusType::Grain:
-            {
-                outLeft = grainProcessorLeft.process(left, grainSize, grainDensity,
-                                                     grainPosition, chaosAmount,
-                                                     chaosOutput, static_cast<float>(sampleRate));
-                outRight = grainProcessorRight.process(right, grainSize, grainDensity,
-                                                       grainPosition, chaosAmount,
-                                                       -chaosOutput, static_cast<float>(sampleRate));
-                break;
-            }
-
-            case BusType::Reverb:
-            {
-                outLeft = reverbProcessorLeft.process(left, right, grainDensity,
-                                                      reverbRoomSize, reverbDamping,
-                                                      reverbDecay, true, chaosAmount,
-                                                      chaosOutput, static_cast<float>(sampleRate));
-                outRight = reverbProcessorRight.process(left, right, grainDensity,
-                                                        reverbRoomSize, reverbDamping,
-                                                        reverbDecay, false, chaosAmount,
-                                                        chaosOutput, static_cast<float>(sampleRate));
-                break;
-            }
+            grainProcessorLeft->setParameters(grainSize, grainDensity, grainPosition, chaosAmount, rate);
+            grainProcessorRight->setParameters(grainSize, grainDensity, grainPosition, chaosAmount, rate);
+            grainProcessorLeft->processBlock(inputs, outputs, numSamples, chaos);
+            grainProcessorRight->processBlock(inputs + 1, outputs + 1, numSamples, invertedChaos);
+            break;
         }
 
-        // Apply return level
-        float level = smoothedReturnLevel.getNextValue();
-        outputLeft[i] = outLeft * level;
-        outputRight[i] = outRight * level;
+        case BusType::Reverb:
+        {
+            reverbProcessor->setParameters(reverbRoomSize, reverbDamping, reverbDecay, chaosAmount);
+            reverbProcessor->setModulation(reverbModulationDepth, reverbModulationRate);
+            reverbProcessor->processBlock(inputs, outputs, numSamples, chaos);
+            break;
+        }
+    }
 
-        maxOutput = std::max(maxOutput, std::abs(outputLeft[i]));
-        maxOutput = std::max(maxOutput, std::abs(outputRight[i]));
+    // Apply return level
+    if (smoothedReturnLevel.isSmoothing())
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float level = smoothedReturnLevel.getNextValue();
+            outputLeft[i] *= level;
+            outputRight[i] *= level;
+        }
+    }
+    else
+    {
+        juce::FloatVectorOperations::multiply(outputLeft, smoothedReturnLevel.getTargetValue(), numSamples);
+        juce::FloatVectorOperations::multiply(outputRight, smoothedReturnLevel.getTargetValue(), numSamples);
     }
 
-    outputLevel = maxOutput;
+    const auto rangeLeft = juce::FloatVectorOperations::findMinAndMax(outputLeft, numSamples);
+    const auto rangeRight = juce::FloatVectorOperations::findMinAndMax(outputRight, numSamples);
+    outputLevel = std::max({ 0.0f, -rangeLeft.getStart(), rangeLeft.getEnd(),
+                             -rangeRight.getStart(), rangeRight.getEnd() });
 }
 
 } // namespace Kousaten
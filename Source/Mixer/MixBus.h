@@ -41,6 +41,12 @@ public:
     // Effect-specific parameters
     void setDelayTime(float timeLeft, float timeRight);
     void setDelayFeedback(float feedback);
+    void setDelayInterpolation(DelayProcessor::Interpolation interpolation);
+    void setDelayModulation(float depthMs, float rateHz);  // Tap sweep, 0 ms = off
+
+    // Synced channels take their time from the tempo instead of setDelayTime()
+    void setDelaySync(DelayProcessor::NoteDivision left, DelayProcessor::NoteDivision right);
+    void setDelayTempo(double bpm);
 
     void setGrainSize(float size);
     void setGrainDensity(float density);
@@ -49,6 +55,7 @@ public:
     void setReverbRoomSize(float size);
     void setReverbDamping(float damping);
     void setReverbDecay(float decay);
+    void setReverbModulation(float depthMs, float rateHz);  // Comb tap sweep, 0 ms = off
 
     void setChaosAmount(float amount);
     void setChaosRate(float rate);
@@ -62,18 +69,23 @@ private:
     float returnLevel = 1.0f;
     float outputLevel = 0.0f;
 
-    // Effect processors
-    DelayProcessor delayProcessor;
-    GrainProcessor grainProcessorLeft;
-    GrainProcessor grainProcessorRight;
-    ReverbProcessor reverbProcessorLeft;
-    ReverbProcessor reverbProcessorRight;
+    // Effect processors; only the bus type's own are created
+    std::unique_ptr<DelayProcessor> delayProcessor;
+    std::unique_ptr<GrainProcessor> grainProcessorLeft;
+    std::unique_ptr<GrainProcessor> grainProcessorRight;
+    std::unique_ptr<ReverbProcessor> reverbProcessor;
     ChaosGenerator chaosGenerator;
 
     // Effect parameters
     float delayTimeLeft = 0.25f;
     float delayTimeRight = 0.25f;
     float delayFeedback = 0.3f;
+    DelayProcessor::Interpolation delayInterpolation = DelayProcessor::Interpolation::Hermite;
+    float delayModulationDepth = 0.0f;
+    float delayModulationRate = 0.5f;
+    DelayProcessor::NoteDivision delaySyncLeft = DelayProcessor::NoteDivision::Free;
+    DelayProcessor::NoteDivision delaySyncRight = DelayProcessor::NoteDivision::Free;
+    double delayTempo = 120.0;
 
     float grainSize = 0.3f;
     float grainDensity = 0.4f;
@@ -82,11 +94,16 @@ private:
     float reverbRoomSize = 0.5f;
     float reverbDamping = 0.4f;
     float reverbDecay = 0.6f;
+    float reverbModulationDepth = 0.0f;
+    float reverbModulationRate = 0.5f;
 
     float chaosAmount = 0.0f;
     float chaosRate = 0.01f;
 
     juce::SmoothedValue<float> smoothedReturnLevel;
+
+    // Per-sample chaos for the block, and its inverse for the right grains
+    juce::AudioBuffer<float> chaosBuffer;
 };
 
 } // namespace Kousaten
@@ -104,13 +104,23 @@ void SendPanner::setHomePosition(float x, float y)
 
 void SendPanner::setAuxPosition(int auxId, float x, float y)
 {
+    if (!juce::isPositiveAndBelow(auxId, AuxBus::MAX_AUX_BUSES))
+        return;
+
     auxPositions[auxId] = { juce::jlimit(0.0f, 1.0f, x),
                             juce::jlimit(0.0f, 1.0f, y) };
+
+    auxPositionX[static_cast<size_t>(auxId)] = auxPositions[auxId].first;
+    auxPositionY[static_cast<size_t>(auxId)] = auxPositions[auxId].second;
+    auxPositionMask |= 1u << auxId;
 }
 
 void SendPanner::removeAuxPosition(int auxId)
 {
     auxPositions.erase(auxId);
+
+    if (juce::isPositiveAndBelow(auxId, AuxBus::MAX_AUX_BUSES))
+        auxPositionMask &= ~(1u << auxId);
 }
 
 std::pair<float, float> SendPanner::getAuxPosition(int auxId) const
@@ -216,6 +226,57 @@ std::map<int, float> SendPanner::calculateSendLevels() const
     return levels;
 }
 
+void SendPanner::calculateSendGains(float* gains) const
+{
+    const auto mask = auxPositionMask;
+    if (mask == 0)
+        return;
+
+    float uniformLevel = 1.0f / static_cast<float>(juce::countNumberOfBits(mask));
+
+    if (!pannerEnabled)
+    {
+        // Uniform distribution when disabled
+        for (int auxId = 0; auxId < AuxBus::MAX_AUX_BUSES; ++auxId)
+        {
+            if ((mask & (1u << auxId)) != 0)
+                gains[auxId] = uniformLevel;
+        }
+        return;
+    }
+
+    // Same weighting as calculateSendLevels, in ascending aux ID order
+    float manualInfluence = (mode == SendPannerMode::XYPad) ? 1.0f : 0.3f;
+    float autoInfluence = 1.0f - manualInfluence;
+
+    std::array<float, AuxBus::MAX_AUX_BUSES> weights;
+    float totalWeight = 0.0f;
+
+    for (int auxId = 0; auxId < AuxBus::MAX_AUX_BUSES; ++auxId)
+    {
+        if ((mask & (1u << auxId)) == 0)
+            continue;
+
+        auto x = auxPositionX[static_cast<size_t>(auxId)];
+        auto y = auxPositionY[static_cast<size_t>(auxId)];
+        float weight = calculateWeight(x, y) * autoInfluence + calculateManualWeight(x, y) * manualInfluence;
+        weights[static_cast<size_t>(auxId)] = weight;
+        totalWeight += weight;
+    }
+
+    if (totalWeight <= 0.0f)
+        return;
+
+    for (int auxId = 0; auxId < AuxBus::MAX_AUX_BUSES; ++auxId)
+    {
+        if ((mask & (1u << auxId)) == 0)
+            continue;
+
+        float pannedLevel = weights[static_cast<size_t>(auxId)] / totalWeight;
+        gains[auxId] = uniformLevel + (pannedLevel - uniformLevel) * amount;
+    }
+}
+
 void SendPanner::process(int numSamples, double sampleRate)
 {
     // Update sample rate if changed
@@ -238,21 +299,23 @@ void SendPanner::process(int numSamples, double sampleRate)
 
 void SendPanner::updateAutomation(int numSamples, double sampleRate)
 {
-    if (auxPositions.empty()) return;
+    const auto mask = auxPositionMask;
+    if (mask == 0) return;
 
     float phaseIncrement = (speed * static_cast<float>(numSamples)) / static_cast<float>(sampleRate);
     phase += phaseIncrement;
 
-    // Build sorted list of aux IDs for consistent ordering
-    std::vector<int> auxIds;
-    for (const auto& [auxId, pos] : auxPositions)
+    // Positioned aux IDs in ascending order (no allocation on the audio thread)
+    std::array<int, AuxBus::MAX_AUX_BUSES> auxIds;
+    int numAux = 0;
+    for (int auxId = 0; auxId < AuxBus::MAX_AUX_BUSES; ++auxId)
     {
-        auxIds.push_back(auxId);
+        if ((mask & (1u << auxId)) != 0)
+            auxIds[static_cast<size_t>(numAux++)] = auxId;
     }
-    std::sort(auxIds.begin(), auxIds.end());
 
-    int numAux = static_cast<int>(auxIds.size());
-    if (numAux == 0) return;
+    auto getX = [&](int index) { return auxPositionX[static_cast<size_t>(auxIds[static_cast<size_t>(index)])]; };
+    auto getY = [&](int index) { return auxPositionY[static_cast<size_t>(auxIds[static_cast<size_t>(index)])]; };
 
     float targetX = homeX;
     float targetY = homeY;
@@ -269,12 +332,9 @@ void SendPanner::updateAutomation(int numSamples, double sampleRate)
             int index2 = (index1 + 1) % numAux;
             float blend = floatIndex - std::floor(floatIndex);
 
-            auto& pos1 = auxPositions[auxIds[static_cast<size_t>(index1)]];
-            auto& pos2 = auxPositions[auxIds[static_cast<size_t>(index2)]];
-
             // Interpolate between aux positions, biased toward home
-            float auxX = pos1.first + (pos2.first - pos1.first) * blend;
-            float auxY = pos1.second + (pos2.second - pos1.second) * blend;
+            float auxX = getX(index1) + (getX(index2) - getX(index1)) * blend;
+            float auxY = getY(index1) + (getY(index2) - getY(index1)) * blend;
 
             // Blend with home position (70% aux movement, 30% home bias)
             targetX = auxX * 0.7f + homeX * 0.3f;
@@ -317,9 +377,9 @@ void SendPanner::updateAutomation(int numSamples, double sampleRate)
                     currentAuxIndex = (currentAuxIndex + 1) % numAux;
                 }
 
-                auto& pos = auxPositions[auxIds[static_cast<size_t>(currentAuxIndex)]];
-                targetX = pos.first * 0.7f + homeX * 0.3f;
-                targetY = pos.second * 0.7f + homeY * 0.3f;
+                currentAuxIndex %= numAux;  // Aux buses may have been removed
+                targetX = getX(currentAuxIndex) * 0.7f + homeX * 0.3f;
+                targetY = getY(currentAuxIndex) * 0.7f + homeY * 0.3f;
             }
             break;
         }
@@ -343,10 +403,10 @@ void SendPanner::updateAutomation(int numSamples, double sampleRate)
                 currentAuxIndex = newTarget;
             }
 
-            auto& pos = auxPositions[auxIds[static_cast<size_t>(currentAuxIndex)]];
             // Blend with home position
-            targetX = pos.first * 0.7f + homeX * 0.3f;
-            targetY = pos.second * 0.7f + homeY * 0.3f;
+            currentAuxIndex %= numAux;  // Aux buses may have been removed
+            targetX = getX(currentAuxIndex) * 0.7f + homeX * 0.3f;
+            targetY = getY(currentAuxIndex) * 0.7f + homeY * 0.3f;
             break;
         }
 
@@ -6,6 +6,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "AuxBus.h"
+#include <array>
 #include <map>
 #include <random>
 
@@ -74,6 +76,10 @@ public:
     // Returns map of auxId -> send level (0.0 to 1.0)
     std::map<int, float> calculateSendLevels() const;
 
+    // Allocation-free version for the audio thread: writes the level of every positioned
+    // aux into gains[auxId] (gains holds AuxBus::MAX_AUX_BUSES entries; others are untouched)
+    void calculateSendGains(float* gains) const;
+
     // Process automation (call once per audio block)
     void process(int numSamples, double sampleRate);
 
@@ -112,6 +118,11 @@ private:
     // Aux bus positions
     std::map<int, std::pair<float, float>> auxPositions;
 
+    // Dense mirror of auxPositions indexed by aux ID, read on the audio thread
+    std::array<float, AuxBus::MAX_AUX_BUSES> auxPositionX {};
+    std::array<float, AuxBus::MAX_AUX_BUSES> auxPositionY {};
+    juce::uint32 auxPositionMask = 0;  // Bit n set = aux n has a position
+
     // For sequencer/random modes
     int currentAuxIndex = 0;
     int targetAuxIndex = 0;
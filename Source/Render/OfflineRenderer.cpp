@@ -0,0 +1,132 @@
+/*
+    Kousaten Mixer - Offline Renderer
+    Implementation
+*/
+
+#include "OfflineRenderer.h"
+
+namespace Kousaten {
+
+OfflineRenderer::OfflineRenderer(double rate, int samplesPerBlock)
+    : sampleRate(rate)
+    , blockSize(samplesPerBlock)
+{
+    engine.prepareToPlay(blockSize, sampleRate);
+    outputBuffer.setSize(2, blockSize);
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+    engine.releaseResources();
+}
+
+int OfflineRenderer::addInput(const juce::AudioBuffer<float>& source)
+{
+    int channelId = engine.addChannel();
+    if (channelId < 0)
+        return -1;
+
+    bool stereo = source.getNumChannels() >= 2;
+    int busChannels = stereo ? 2 : 1;
+
+    Input input;
+    input.audio.setSize(busChannels, source.getNumSamples());
+    for (int ch = 0; ch < busChannels; ++ch)
+        input.audio.copyFrom(ch, 0, source, ch, 0, source.getNumSamples());
+    input.busChannelStart = numInputBusChannels;
+
+    if (auto* channel = engine.getChannel(channelId))
+    {
+        channel->setName("Input " + juce::String(static_cast<int>(inputs.size()) + 1));
+        channel->setInputChannelStart(input.busChannelStart);
+        channel->setStereo(stereo);
+    }
+
+    numInputBusChannels += busChannels;
+    inputLength = std::max(inputLength, static_cast<juce::int64>(source.getNumSamples()));
+    inputs.push_back(std::move(input));
+
+    inputBuffer.setSize(numInputBusChannels, blockSize);
+    return channelId;
+}
+
+int OfflineRenderer::addAuxOutput()
+{
+    int auxId = engine.addAuxBus();
+    if (auxId < 0)
+        return -1;
+
+    // Each aux bus gets a dedicated stem pair after the master
+    if (auto* auxBus = engine.getAuxBus(auxId))
+        auxBus->setOutputChannelStart(2 + 2 * static_cast<int>(auxIds.size()));
+
+    auxIds.push_back(auxId);
+    outputBuffer.setSize(getNumOutputChannels(), blockSize);
+    return auxId;
+}
+
+void OfflineRenderer::fillInputBlock(juce::int64 position, int numSamples)
+{
+    inputBuffer.clear();
+
+    for (const auto& input : inputs)
+    {
+        juce::int64 available = input.audio.getNumSamples() - position;
+        if (available <= 0)
+            continue;
+
+        int toCopy = static_cast<int>(std::min(available, static_cast<juce::int64>(numSamples)));
+        for (int ch = 0; ch < input.audio.getNumChannels(); ++ch)
+        {
+            inputBuffer.copyFrom(input.busChannelStart + ch, 0,
+                                 input.audio, ch, static_cast<int>(position), toCopy);
+        }
+    }
+}
+
+OfflineRenderer::Stats OfflineRenderer::render(juce::int64 numSamples, const BlockCallback& onBlock)
+{
+    Stats stats;
+
+    const auto ticksPerSecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    const auto renderStart = juce::Time::getHighResolutionTicks();
+    juce::int64 engineTicks = 0;
+
+    engine.setInputChannels(inputBuffer.getArrayOfReadPointers(), numInputBusChannels);
+
+    juce::int64 position = 0;
+    while (position < numSamples)
+    {
+        int samplesThisBlock = static_cast<int>(std::min(static_cast<juce::int64>(blockSize),
+                                                         numSamples - position));
+
+        if (numInputBusChannels > 0)
+            fillInputBlock(position, samplesThisBlock);
+
+        juce::AudioSourceChannelInfo info(&outputBuffer, 0, samplesThisBlock);
+
+        const auto blockStart = juce::Time::getHighResolutionTicks();
+        engine.getNextAudioBlock(info);
+        engineTicks += juce::Time::getHighResolutionTicks() - blockStart;
+
+        // Drain stage timings every block so none are dropped (no-op unless profiling)
+        if (engine.getProfiler().isEnabled())
+            engine.getProfiler().collect();
+
+        if (onBlock)
+            onBlock(outputBuffer, samplesThisBlock);
+
+        position += samplesThisBlock;
+        stats.blocksRendered++;
+    }
+
+    engine.setInputChannels(nullptr, 0);
+
+    stats.samplesRendered = position;
+    stats.engineSeconds = static_cast<double>(engineTicks) / ticksPerSecond;
+    stats.wallSeconds = static_cast<double>(juce::Time::getHighResolutionTicks() - renderStart) / ticksPerSecond;
+    stats.audioSeconds = static_cast<double>(position) / sampleRate;
+    return stats;
+}
+
+} // namespace Kousaten
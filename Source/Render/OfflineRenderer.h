@@ -0,0 +1,83 @@
+/*
+    Kousaten Mixer - Offline Renderer
+    Drives the AudioEngine without an audio device, as fast as the CPU allows
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Core/AudioEngine.h"
+#include <functional>
+#include <vector>
+
+namespace Kousaten {
+
+class OfflineRenderer
+{
+public:
+    // Called once per rendered block with the engine's full output buffer.
+    // Channels 0-1 are the master, channels 2+2n / 3+2n are aux bus n.
+    using BlockCallback = std::function<void(const juce::AudioBuffer<float>& output, int numSamples)>;
+
+    struct Stats
+    {
+        juce::int64 samplesRendered = 0;
+        int blocksRendered = 0;
+        double engineSeconds = 0.0;   // Time spent inside getNextAudioBlock
+        double wallSeconds = 0.0;     // Total render loop time (including callbacks)
+        double audioSeconds = 0.0;    // Duration of rendered audio
+
+        double getRealtimeFactor() const { return engineSeconds > 0.0 ? audioSeconds / engineSeconds : 0.0; }
+    };
+
+    OfflineRenderer(double sampleRate, int blockSize);
+    ~OfflineRenderer();
+
+    // Add a source as a new mixer channel. Mono sources feed a mono channel,
+    // anything with two or more channels feeds a stereo channel from its first pair.
+    // Returns the mixer channel id, or -1 if the engine is full.
+    int addInput(const juce::AudioBuffer<float>& source);
+
+    // Add an aux bus routed to its own stem pair in the output buffer.
+    // Returns the aux bus id, or -1 if the engine has no free aux bus.
+    int addAuxOutput();
+
+    AudioEngine& getEngine() { return engine; }
+
+    double getSampleRate() const { return sampleRate; }
+    int getBlockSize() const { return blockSize; }
+    int getNumAuxOutputs() const { return static_cast<int>(auxIds.size()); }
+    int getNumOutputChannels() const { return 2 + 2 * getNumAuxOutputs(); }
+
+    // Longest input length in samples
+    juce::int64 getInputLength() const { return inputLength; }
+
+    // Render numSamples through the engine, block by block
+    Stats render(juce::int64 numSamples, const BlockCallback& onBlock);
+
+private:
+    struct Input
+    {
+        juce::AudioBuffer<float> audio;
+        int busChannelStart = 0;
+    };
+
+    AudioEngine engine;
+
+    double sampleRate;
+    int blockSize;
+
+    std::vector<Input> inputs;
+    std::vector<int> auxIds;
+    int numInputBusChannels = 0;
+    juce::int64 inputLength = 0;
+
+    juce::AudioBuffer<float> inputBuffer;
+    juce::AudioBuffer<float> outputBuffer;
+
+    void fillInputBlock(juce::int64 position, int numSamples);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OfflineRenderer)
+};
+
+} // namespace Kousaten
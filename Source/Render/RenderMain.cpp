@@ -0,0 +1,322 @@
+/*
+    Kousaten Mixer - Offline Render Entry Point
+    Bounces input files through the mixer without an audio device
+*/
+
+#include <JuceHeader.h>
+#include "OfflineRenderer.h"
+#include <iostream>
+
+namespace {
+
+struct RenderOptions
+{
+    juce::StringArray inputFiles;
+    juce::File outputDirectory { juce::File::getCurrentWorkingDirectory() };
+    double sampleRate = 0.0;  // 0 = take from first WAV input, else 48000
+    int blockSize = 512;
+    int rawChannels = 2;
+    int numAux = 0;
+    float auxSend = 1.0f;
+    float delaySend = 0.0f;
+    float grainSend = 0.0f;
+    float reverbSend = 0.0f;
+    float volume = 0.8f;
+    double tailSeconds = 0.0;
+    int renderWorkers = 0;
+    bool writeFiles = true;
+    bool profile = false;
+};
+
+void printUsage()
+{
+    std::cout
+        << "Usage: KousatenRender --input <file> [--input <file> ...] [options]\n"
+        << "\n"
+        << "Each input becomes one mixer channel (stereo if the file has 2+ channels).\n"
+        << "WAV/AIFF/FLAC are decoded; .raw/.f32 files are read as interleaved float32.\n"
+        << "\n"
+        << "Options:\n"
+        << "  --output <dir>         Directory for master.wav and auxN.wav (default: cwd)\n"
+        << "  --rate <hz>            Sample rate (default: first WAV input, else 48000)\n"
+        << "  --block <samples>      Block size passed to the engine (default: 512)\n"
+        << "  --raw-channels <n>     Channel count of raw inputs (default: 2)\n"
+        << "  --aux <n>              Number of aux buses to render (default: 0)\n"
+        << "  --aux-send <0-1>       Send level from every channel to every aux (default: 1)\n"
+        << "  --delay-send <0-1>     Delay send level for every channel (default: 0)\n"
+        << "  --grain-send <0-1>     Grain send level for every channel (default: 0)\n"
+        << "  --reverb-send <0-1>    Reverb send level for every channel (default: 0)\n"
+        << "  --volume <0-1>         Channel fader level (default: 0.8)\n"
+        << "  --tail <seconds>       Extra time rendered after the inputs end (default: 0)\n"
+        << "  --workers <n>          Render helper threads for the channel strips (default: 0)\n"
+        << "  --no-write             Render without writing files (profiling)\n"
+        << "  --profile              Print per-stage DSP timings of the last 512 blocks\n";
+}
+
+bool parseArguments(int argc, char* argv[], RenderOptions& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        juce::String arg(argv[i]);
+
+        if (arg == "--help" || arg == "-h")
+            return false;
+
+        if (arg == "--no-write")
+        {
+            options.writeFiles = false;
+            continue;
+        }
+
+        if (arg == "--profile")
+        {
+            options.profile = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+
+        juce::String value(argv[++i]);
+
+        if (arg == "--input")               options.inputFiles.add(value);
+        else if (arg == "--output")         options.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        else if (arg == "--rate")           options.sampleRate = value.getDoubleValue();
+        else if (arg == "--block")          options.blockSize = value.getIntValue();
+        else if (arg == "--raw-channels")   options.rawChannels = value.getIntValue();
+        else if (arg == "--aux")            options.numAux = value.getIntValue();
+        else if (arg == "--aux-send")       options.auxSend = value.getFloatValue();
+        else if (arg == "--delay-send")     options.delaySend = value.getFloatValue();
+        else if (arg == "--grain-send")     options.grainSend = value.getFloatValue();
+        else if (arg == "--reverb-send")    options.reverbSend = value.getFloatValue();
+        else if (arg == "--volume")         options.volume = value.getFloatValue();
+        else if (arg == "--tail")           options.tailSeconds = value.getDoubleValue();
+        else if (arg == "--workers")        options.renderWorkers = value.getIntValue();
+        else
+        {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    if (options.blockSize <= 0 || options.rawChannels <= 0 || options.numAux < 0)
+    {
+        std::cerr << "Block size and raw channel count must be positive\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool isRawFile(const juce::File& file)
+{
+    return file.hasFileExtension(".raw;.f32");
+}
+
+bool loadRawFile(const juce::File& file, int numChannels, juce::AudioBuffer<float>& buffer)
+{
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data))
+        return false;
+
+    auto numFrames = static_cast<int>(data.getSize() / (sizeof(float) * static_cast<size_t>(numChannels)));
+    auto* interleaved = static_cast<const float*>(data.getData());
+
+    buffer.setSize(numChannels, numFrames);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* dest = buffer.getWritePointer(ch);
+        for (int i = 0; i < numFrames; ++i)
+            dest[i] = interleaved[i * numChannels + ch];
+    }
+    return true;
+}
+
+bool loadAudioFile(juce::AudioFormatManager& formatManager, const juce::File& file,
+                   juce::AudioBuffer<float>& buffer, double& fileSampleRate)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr)
+        return false;
+
+    buffer.setSize(static_cast<int>(reader->numChannels), static_cast<int>(reader->lengthInSamples));
+    reader->read(&buffer, 0, static_cast<int>(reader->lengthInSamples), 0, true, true);
+    fileSampleRate = reader->sampleRate;
+    return true;
+}
+
+std::unique_ptr<juce::AudioFormatWriter> createWavWriter(const juce::File& file, double sampleRate)
+{
+    file.deleteFile();
+
+    std::unique_ptr<juce::OutputStream> stream(file.createOutputStream());
+    if (stream == nullptr)
+        return nullptr;
+
+    juce::WavAudioFormat wavFormat;
+    std::unique_ptr<juce::AudioFormatWriter> writer(
+        wavFormat.createWriterFor(stream.get(), sampleRate, 2, 32, {}, 0));
+
+    // The writer owns the stream once it has been created
+    if (writer != nullptr)
+        stream.release();
+
+    return writer;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    RenderOptions options;
+    if (!parseArguments(argc, argv, options) || options.inputFiles.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    // Load all inputs before creating the engine so the sample rate is known
+    std::vector<juce::AudioBuffer<float>> sources;
+    for (const auto& path : options.inputFiles)
+    {
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+        juce::AudioBuffer<float> buffer;
+
+        if (isRawFile(file))
+        {
+            if (!loadRawFile(file, options.rawChannels, buffer))
+            {
+                std::cerr << "Cannot read raw input: " << path << "\n";
+                return 1;
+            }
+        }
+        else
+        {
+            double fileSampleRate = 0.0;
+            if (!loadAudioFile(formatManager, file, buffer, fileSampleRate))
+            {
+                std::cerr << "Cannot read audio input: " << path << "\n";
+                return 1;
+            }
+
+            if (options.sampleRate <= 0.0)
+                options.sampleRate = fileSampleRate;
+
+            if (std::abs(fileSampleRate - options.sampleRate) > 0.5)
+            {
+                std::cerr << path << " is " << fileSampleRate << " Hz, expected "
+                          << options.sampleRate << " Hz (resampling is not supported)\n";
+                return 1;
+            }
+        }
+
+        sources.push_back(std::move(buffer));
+    }
+
+    if (options.sampleRate <= 0.0)
+        options.sampleRate = 48000.0;
+
+    Kousaten::OfflineRenderer renderer(options.sampleRate, options.blockSize);
+    auto& engine = renderer.getEngine();
+    engine.setRenderWorkerCount(options.renderWorkers);
+    engine.getProfiler().setEnabled(options.profile);
+
+    std::vector<int> channelIds;
+    for (const auto& source : sources)
+    {
+        int channelId = renderer.addInput(source);
+        if (channelId < 0)
+        {
+            std::cerr << "Too many inputs (max " << Kousaten::AudioEngine::MAX_CHANNELS << ")\n";
+            return 1;
+        }
+        channelIds.push_back(channelId);
+    }
+
+    std::vector<int> auxIds;
+    for (int i = 0; i < options.numAux; ++i)
+    {
+        int auxId = renderer.addAuxOutput();
+        if (auxId < 0)
+        {
+            std::cerr << "Too many aux buses (max " << Kousaten::AuxBus::MAX_AUX_BUSES << ")\n";
+            return 1;
+        }
+        auxIds.push_back(auxId);
+    }
+
+    for (int channelId : channelIds)
+    {
+        auto* channel = engine.getChannel(channelId);
+        channel->setVolume(options.volume);
+        channel->setDelaySend(options.delaySend);
+        channel->setGrainSend(options.grainSend);
+        channel->setReverbSend(options.reverbSend);
+
+        for (int auxId : auxIds)
+            channel->setAuxSend(auxId, options.auxSend);
+    }
+
+    // One stereo writer for the master and one per aux bus
+    std::vector<std::unique_ptr<juce::AudioFormatWriter>> writers;
+    if (options.writeFiles)
+    {
+        options.outputDirectory.createDirectory();
+
+        writers.push_back(createWavWriter(options.outputDirectory.getChildFile("master.wav"), options.sampleRate));
+        for (int i = 0; i < options.numAux; ++i)
+        {
+            auto name = "aux" + juce::String(i + 1) + ".wav";
+            writers.push_back(createWavWriter(options.outputDirectory.getChildFile(name), options.sampleRate));
+        }
+
+        for (const auto& writer : writers)
+        {
+            if (writer == nullptr)
+            {
+                std::cerr << "Cannot create output files in " << options.outputDirectory.getFullPathName() << "\n";
+                return 1;
+            }
+        }
+    }
+
+    auto totalSamples = renderer.getInputLength()
+                      + static_cast<juce::int64>(options.tailSeconds * options.sampleRate);
+
+    auto stats = renderer.render(totalSamples, [&writers](const juce::AudioBuffer<float>& output, int numSamples) {
+        for (size_t i = 0; i < writers.size(); ++i)
+        {
+            const float* stem[] = { output.getReadPointer(static_cast<int>(i) * 2),
+                                    output.getReadPointer(static_cast<int>(i) * 2 + 1) };
+            writers[i]->writeFromFloatArrays(stem, 2, numSamples);
+        }
+    });
+
+    writers.clear();  // Flush and close files
+
+    std::cout << "Rendered " << stats.audioSeconds << " s of audio ("
+              << channelIds.size() << " channels, " << options.numAux << " aux, "
+              << options.blockSize << "-sample blocks @ " << options.sampleRate << " Hz)\n"
+              << "Engine time: " << stats.engineSeconds << " s, total: " << stats.wallSeconds << " s\n"
+              << "Speed: " << stats.getRealtimeFactor() << "x realtime\n";
+
+    if (options.profile)
+        std::cout << "\n" << engine.getProfiler().createReport();
+
+    // Guard builds: any allocation, lock or blocking call inside processBlock fails the run
+    if (Kousaten::RealtimeGuard::isEnabled())
+    {
+        int violations = Kousaten::RealtimeGuard::getViolationCount();
+        std::cout << "Real-time violations: " << violations << "\n";
+        if (violations > 0)
+            return 1;
+    }
+
+    return 0;
+}
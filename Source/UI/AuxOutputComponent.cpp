@@ -188,6 +188,33 @@ void AuxOutputComponent::paint(juce::Graphics& g)
     g.setFont(18.0f);
     g.drawText(juce::String(static_cast<int>(levelSlider.getValue())),
                getWidth() - 60, getHeight() / 2 - 10, 30, 20, juce::Justification::centred);
+
+    // Device latency and the clock drift the resampler is compensating, or how a device
+    // switch is going
+    if (deviceStatus.isNotEmpty())
+    {
+        g.setColour(deviceStatus == "failed" ? juce::Colour(0xffff4444) : juce::Colours::grey);
+        g.setFont(9.0f);
+        g.drawText(deviceStatus, getWidth() - 90, getHeight() / 2 + 10, 90, 12, juce::Justification::centred);
+    }
+    else if (deviceLatencyMs != 0 || deviceDriftPpm != 0)
+    {
+        g.setColour(juce::Colours::grey);
+        g.setFont(9.0f);
+        g.drawText(juce::String(deviceLatencyMs) + " ms  " + juce::String(deviceDriftPpm) + " ppm",
+                   getWidth() - 90, getHeight() / 2 + 10, 90, 12, juce::Justification::centred);
+    }
+
+    // Blocks lost on the way to the RtAudio device (stream switches and ring xruns)
+    int deviceProblems = droppedDeviceBlocks + deviceOverruns + deviceUnderruns;
+    if (deviceProblems > 0)
+    {
+        g.setColour(juce::Colour(0xffff4444));
+        g.setFont(11.0f);
+        g.drawText("-" + juce::String(deviceProblems),
+                   channelCombo.getRight() + 4, channelCombo.getY(), 40, channelCombo.getHeight(),
+                   juce::Justification::centredLeft);
+    }
 }
 
 void AuxOutputComponent::drawMeter(juce::Graphics& g, int x, int y, int width, int height, float level)
@@ -295,18 +322,66 @@ void AuxOutputComponent::timerCallback()
         currentLevel = newLevel;
         repaint();
     }
+
+    // Devices plugged in or removed since the list was built
+    if (rtAudioManager && rtAudioManager->getDeviceListVersion() != deviceListVersion)
+        updateDeviceList();
+
+    int newDropped = auxBus->getNumDroppedDeviceBlocks();
+    int newOverruns = auxBus->getDeviceOverruns();
+    int newUnderruns = auxBus->getDeviceUnderruns();
+
+    if (newDropped != droppedDeviceBlocks || newOverruns != deviceOverruns || newUnderruns != deviceUnderruns)
+    {
+        droppedDeviceBlocks = newDropped;
+        deviceOverruns = newOverruns;
+        deviceUnderruns = newUnderruns;
+
+        juce::Logger::writeToLog(auxBus->getName() + " (" + auxBus->getOutputDevice() + "): "
+                                 + juce::String(deviceOverruns) + " overruns, "
+                                 + juce::String(deviceUnderruns) + " underruns, "
+                                 + juce::String(droppedDeviceBlocks) + " blocks dropped while switching");
+        repaint();
+    }
+
+    juce::String newStatus = auxBus->isDeviceSwitchPending() ? "opening..."
+                             : auxBus->didDeviceOpenFail() ? "failed"
+                             : juce::String();
+    if (newStatus != deviceStatus)
+    {
+        deviceStatus = newStatus;
+        if (deviceStatus == "failed")
+            juce::Logger::writeToLog(auxBus->getName() + ": could not open " + auxBus->getOutputDevice());
+        repaint();
+    }
+
+    int newDriftPpm = juce::roundToInt(auxBus->getDeviceDriftPpm());
+    int newLatencyMs = rtAudioManager != nullptr
+                           ? juce::roundToInt(auxBus->getDeviceLatencyFrames() * 1000.0 / rtAudioManager->getSampleRate())
+                           : 0;
+    if (newDriftPpm != deviceDriftPpm || newLatencyMs != deviceLatencyMs)
+    {
+        deviceDriftPpm = newDriftPpm;
+        deviceLatencyMs = newLatencyMs;
+        repaint();
+    }
 }
 
 void AuxOutputComponent::updateDeviceList()
 {
-    deviceCombo.clear();
+    // Keep the current choice when the list is refreshed after a hot-plug
+    const auto selected = deviceCombo.getNumItems() > 0 ? deviceCombo.getText() : juce::String();
+
+    deviceCombo.clear(juce::dontSendNotification);
 
     // First option: None
     deviceCombo.addItem("None", 1);
 
+    juce::StringArray deviceNames;
     if (rtAudioManager)
     {
-        auto deviceNames = rtAudioManager->getOutputDeviceNames();
+        deviceListVersion = rtAudioManager->getDeviceListVersion();
+        deviceNames = rtAudioManager->getOutputDeviceNames();
         int itemId = 2;
         for (const auto& name : deviceNames)
         {
@@ -314,8 +389,22 @@ void AuxOutputComponent::updateDeviceList()
         }
     }
 
-    // Default to "None"
-    deviceCombo.setSelectedId(1);
+    if (selected.isEmpty())
+    {
+        // Default to "None"
+        deviceCombo.setSelectedId(1);
+        return;
+    }
+
+    // A device that was unplugged stays listed while the bus is routed to it
+    int index = deviceNames.indexOf(selected);
+    if (index < 0 && selected != "None")
+    {
+        deviceCombo.addItem(selected, deviceCombo.getNumItems() + 1);
+        index = deviceNames.size();
+    }
+
+    deviceCombo.setSelectedId(index + 2, juce::dontSendNotification);
 }
 
 void AuxOutputComponent::updateChannelOptions()
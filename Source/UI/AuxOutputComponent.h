@@ -100,6 +100,13 @@ private:
     juce::TextButton removeButton { "X" };
 
     float currentLevel = 0.0f;
+    int droppedDeviceBlocks = 0;  // Aux blocks lost to stream switches
+    int deviceOverruns = 0;       // RtAudio ring xruns of the device's (shared) stream
+    int deviceUnderruns = 0;
+    int deviceDriftPpm = 0;       // Compensated by the stream's resampler
+    int deviceLatencyMs = 0;      // Engine to device output, compensated on the mains
+    juce::String deviceStatus;    // "opening..." while a device switch runs, "failed" after one fails
+    int deviceListVersion = -1;   // Of the RtAudio device list shown in deviceCombo
 
     void updateDeviceList();
     void updateChannelOptions();
@@ -152,15 +152,34 @@ void ChannelStripComponent::updateDeviceLists()
 {
     if (!deviceHandler) return;
 
-    inputDeviceCombo.clear();
+    deviceListVersion = deviceHandler->getDeviceListVersion();
+
+    // Keep the channel's device selected when the list is refreshed after a hot-plug
+    const auto selected = channel->getInputDevice();
+
+    inputDeviceCombo.clear(juce::dontSendNotification);
     auto inputDevices = deviceHandler->getInputDeviceNames();
     int itemId = 1;
     for (const auto& name : inputDevices)
     {
         inputDeviceCombo.addItem(name, itemId++);
     }
-    inputDeviceCombo.setSelectedId(1);
-    updateInputChannelOptions();
+
+    // A device that was unplugged stays selected, greyed out, so the channel keeps its
+    // routing and picks the device up again when it returns
+    if (selected.isNotEmpty() && !inputDevices.contains(selected))
+    {
+        inputDeviceCombo.addItem(selected + " (disconnected)", itemId);
+        inputDeviceCombo.setItemEnabled(itemId, false);
+        inputDeviceCombo.setSelectedId(itemId, juce::dontSendNotification);
+        return;
+    }
+
+    inputDeviceCombo.setSelectedId(juce::jmax(0, inputDevices.indexOf(selected)) + 1, juce::dontSendNotification);
+
+    // The first build also fills in the channel choices
+    if (inputChannelCombo.getNumItems() == 0)
+        updateInputChannelOptions();
 }
 
 void ChannelStripComponent::updateInputChannelOptions()
@@ -604,6 +623,10 @@ void ChannelStripComponent::timerCallback()
         repaint();
     }
 
+    // Devices plugged in or removed since the lists were built
+    if (deviceHandler && deviceHandler->getDeviceListVersion() != deviceListVersion)
+        updateDeviceLists();
+
     // Sync aux send sliders with panner levels
     auto* panner = channel->getSendPanner();
     if (panner && panner->isEnabled())
@@ -174,6 +174,7 @@ private:
 
     // Level display
     float currentLevel = 0.0f;
+    int deviceListVersion = -1;  // Of the device handler's lists shown in the combos
 
     void setupSlider(juce::Slider& slider, double min, double max, double defaultValue);
     void setupComboBox(juce::ComboBox& combo);